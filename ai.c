@@ -1,167 +1,264 @@
+#define _POSIX_C_SOURCE 200809L // For clock_gettime()
 #include "ai.h"
+#include "notation.h"
+#include "profile.h"
+#include "book.h"
+#include "tablebase.h"
+#include "nnue.h"
+#include "pst.h"
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
-#include <SDL2/SDL_timer.h> // For SDL_GetTicks()
 
 // --- Piece Values ---
-#define PAWN_VALUE   100
-#define KNIGHT_VALUE 320
-#define BISHOP_VALUE 330
-#define ROOK_VALUE   500
-#define QUEEN_VALUE  900
+// Pawn to queen, with the piece-square tables, are in pst.h
 #define KING_VALUE   20000 // For checkmate evaluation
+#define TB_WIN_SCORE (KING_VALUE / 2) // Tablebase win, above any material balance, minus the distance to mate
+// Mates score KING_VALUE minus the plies from the root to the mate, so shorter mates score
+// higher; scores beyond MATE_THRESHOLD are mates. Mates and tablebase wins (beyond
+// TB_WIN_THRESHOLD) depend on the ply they were found at.
+#define MATE_THRESHOLD (KING_VALUE - 1000)
+#define TB_WIN_THRESHOLD (TB_WIN_SCORE - 1000)
 
-// --- Piece-Square Tables (PSTs) ---
-// These tables give a bonus or penalty for a piece being on a specific square.
-// They are defined from White's perspective; for Black, the row index is mirrored.
-const int pawn_pst_white[8][8] = {
-    {0,  0,  0,  0,  0,  0,  0,  0},
-    {50, 50, 50, 50, 50, 50, 50, 50},
-    {10, 10, 20, 30, 30, 20, 10, 10},
-    {5,  5, 10, 25, 25, 10,  5,  5},
-    {0,  0,  0, 20, 20,  0,  0,  0},
-    {5, -5,-10,  0,  0,-10, -5,  5},
-    {5, 10, 10,-20,-20, 10, 10,  5},
-    {0,  0,  0,  0,  0,  0,  0,  0}
-};
+// --- Move Ordering ---
+#define QUIET_ORDER_OFFSET 100000 // Puts quiet moves, scored by evaluation, below every capture
 
-const int knight_pst_white[8][8] = {
-    {-50,-40,-30,-30,-30,-30,-40,-50},
-    {-40,-20,  0,  0,  0,  0,-20,-40},
-    {-30,  0, 10, 15, 15, 10,  0,-30},
-    {-30,  5, 15, 20, 20, 15,  5,-30},
-    {-30,  0, 15, 20, 20, 15,  0,-30},
-    {-30,  5, 10, 15, 15, 10,  5,-30},
-    {-40,-20,  0,  5,  5,  0,-20,-40},
-    {-50,-40,-30,-30,-30,-30,-40,-50}
-};
+// --- Killer Moves ---
+#define MAX_SEARCH_PLY AI_MAX_DEPTH // Max search depth for storing killer moves (AIEngine.killer_moves)
 
-const int bishop_pst_white[8][8] = {
-    {-20,-10,-10,-10,-10,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5, 10, 10,  5,  0,-10},
-    {-10,  5,  5, 10, 10,  5,  5,-10},
-    {-10,  0, 10, 10, 10, 10,  0,-10},
-    {-10, 10, 10, 10, 10, 10, 10,-10},
-    {-10,  5,  0,  0,  0,  0,  5,-10},
-    {-20,-10,-10,-10,-10,-10,-10,-20}
-};
+// --- Extensions ---
+// A node in check is searched one ply deeper. So is the TT move of a node at least
+// SINGULAR_MIN_DEPTH deep when it is singular: every other move, searched to half the
+// depth, stays SINGULAR_MARGIN_PER_PLY * depth below the TT score.
+#define SINGULAR_MIN_DEPTH 6
+#define SINGULAR_TT_DEPTH_SLACK 3 // The TT entry may be this much shallower than the node
+#define SINGULAR_MARGIN_PER_PLY 10
 
-const int rook_pst_white[8][8] = {
-    {0,  0,  0,  0,  0,  0,  0,  0},
-    {5, 10, 10, 10, 10, 10, 10,  5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {0,  0,  0,  5,  5,  0,  0,  0}
-};
+// --- Pruning ---
+// Margins are in centipawns. Each can be overridden at build time to tune it in selfplay
+// matches, e.g. make EXTRA_CFLAGS=-DFUTILITY_MARGIN=150 (after a make clean).
+// Reverse futility: a node up to REVERSE_FUTILITY_DEPTH from the horizon whose static
+// evaluation beats beta by REVERSE_FUTILITY_MARGIN per ply is cut off without a search.
+#ifndef REVERSE_FUTILITY_DEPTH
+#define REVERSE_FUTILITY_DEPTH 3
+#endif
+#ifndef REVERSE_FUTILITY_MARGIN
+#define REVERSE_FUTILITY_MARGIN 120
+#endif
+// Futility: up to FUTILITY_DEPTH from the horizon, quiet moves are skipped when the static
+// evaluation plus FUTILITY_MARGIN per ply cannot reach alpha.
+#ifndef FUTILITY_DEPTH
+#define FUTILITY_DEPTH 2
+#endif
+#ifndef FUTILITY_MARGIN
+#define FUTILITY_MARGIN 175
+#endif
+// Delta: quiescence skips captures that cannot reach alpha even when winning the captured
+// piece (and promoting) with DELTA_MARGIN to spare.
+#ifndef DELTA_MARGIN
+#define DELTA_MARGIN 200
+#endif
 
-const int queen_pst_white[8][8] = {
-    {-20,-10,-10, -5, -5,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5,  5,  5,  5,  0,-10},
-    {-5,  0,  5,  5,  5,  5,  0, -5},
-    {0,  0,  5,  5,  5,  5,  0, -5},
-    {-10,  5,  5,  5,  5,  5,  0,-10},
-    {-10,  0,  5,  0,  0,  0,  0,-10},
-    {-20,-10,-10, -5, -5,-10,-10,-20}
+static const int piece_values[] = { // Indexed by PieceType; kings are never captured
+    [EMPTY] = 0, [PAWN] = PAWN_VALUE, [KNIGHT] = KNIGHT_VALUE, [BISHOP] = BISHOP_VALUE,
+    [ROOK] = ROOK_VALUE, [QUEEN] = QUEEN_VALUE, [KING] = 0
 };
 
-const int king_pst_white_midgame[8][8] = {
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-20,-30,-30,-40,-40,-30,-30,-20},
-    {-10,-20,-20,-20,-20,-20,-20,-10},
-    { 20, 20,  0,  0,  0,  0, 20, 20},
-    { 20, 30, 10,  0,  0, 10, 30, 20}
-};
+// --- Search Statistics ---
+// Plain counters bumped in the search (AIEngine.iteration_stats); everything derived is
+// computed once per iteration.
 
-// --- Killer Moves ---
-#define MAX_SEARCH_PLY 30 // Max search depth for storing killer moves
-AIMove killer_moves[MAX_SEARCH_PLY][2]; // [ply][killer_slot]
-int nodes_searched; // Global counter for performance tracking
+// --- Search Limits (AIEngine.limits, valid for the duration of one ai_search call) ---
+#define STOP_CHECK_INTERVAL 1024 // Nodes between clock reads inside the search
+
+unsigned int ai_get_ticks_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static long iteration_node_count(const AIEngine* engine) {
+    return engine->iteration_stats.nodes + engine->iteration_stats.qnodes;
+}
+
+// Nodes of the whole search so far: finished iterations are already in search_stats
+static long search_node_count(const AIEngine* engine) {
+    return engine->search_stats.nodes + engine->search_stats.qnodes + iteration_node_count(engine);
+}
+
+static bool search_limit_reached(const AIEngine* engine) {
+    if (engine->limits.node_limit > 0 && search_node_count(engine) >= engine->limits.node_limit) return true;
+    if (engine->hard_time_limit_ms > 0 && ai_get_ticks_ms() - engine->start_time > (unsigned int)engine->hard_time_limit_ms) return true;
+    return false;
+}
+
+// Polled at every node at any depth. The clock is only read every STOP_CHECK_INTERVAL
+// nodes; once a limit is hit the rest of the search unwinds without further work.
+static bool search_should_stop(AIEngine* engine) {
+    if (engine->stopped) return true;
+    if (!engine->can_stop) return false;
+    long nodes = search_node_count(engine);
+    if (engine->limits.node_limit > 0 && nodes >= engine->limits.node_limit) engine->stopped = true;
+    else if (nodes % STOP_CHECK_INTERVAL == 0 && search_limit_reached(engine)) engine->stopped = true;
+    return engine->stopped;
+}
 
 void ai_init_random() {
     srand(time(NULL));
+}
+
+void ai_engine_init(AIEngine* engine, size_t hash_mb) {
+    memset(engine, 0, sizeof(*engine));
+    tt_init(&engine->tt, hash_mb); // Searches without a table if this fails
+    engine->nnue_stack = aligned_alloc(_Alignof(NNUEAccumulator), (AI_MAX_PLY + 1) * sizeof(NNUEAccumulator)); // Without it, no NNUE
+    ai_reset_search_state(engine);
+}
+
+void ai_engine_free(AIEngine* engine) {
+    tt_free(&engine->tt);
+    free(engine->nnue_stack);
+    engine->nnue_stack = NULL;
+}
+
+bool ai_engine_set_hash(AIEngine* engine, size_t hash_mb) {
+    tt_free(&engine->tt); // First, so the old table's memory counts towards the new one's budget
+    return tt_init(&engine->tt, hash_mb) || hash_mb == 0;
+}
+
+void ai_reset_search_state(AIEngine* engine) {
     // Initialize killer move table
     for (int i = 0; i < MAX_SEARCH_PLY; ++i) {
-        killer_moves[i][0].from_r = -1; // Mark as invalid
-        killer_moves[i][1].from_r = -1;
+        engine->killer_moves[i][0].from_r = -1; // Mark as invalid
+        engine->killer_moves[i][1].from_r = -1;
     }
+    memset(&engine->iteration_stats, 0, sizeof(engine->iteration_stats));
+    memset(&engine->search_stats, 0, sizeof(engine->search_stats));
+    tt_clear(&engine->tt);
 }
 
-int ai_evaluate_board(const Piece board[8][8], PieceColor player_to_evaluate_for) {
-    int material_score = 0;
-    int positional_score = 0;
+const AISearchStats* ai_get_search_stats(const AIEngine* engine) {
+    return &engine->search_stats;
+}
+
+void ai_set_stats_output(AIEngine* engine, FILE* out) {
+    engine->stats_output = out;
+}
+
+static void write_depth_stats_json(FILE* out, const AIDepthStats* d, const AIPrincipalVariation* pv) {
+    char move[6], pv_text[MAX_PV_TEXT_LENGTH];
+    move_to_coordinate(&d->best_move, move);
+    pv_to_coordinates(pv, pv_text);
+    fprintf(out, "{\"type\":\"depth\",\"depth\":%d,\"nodes\":%ld,\"qnodes\":%ld,\"eval_calls\":%ld,"
+                 "\"beta_cutoffs\":%ld,\"first_move_cutoffs\":%ld,\"first_move_cutoff_rate\":%.4f,\"tb_hits\":%ld,"
+                 "\"tt_hits\":%ld,\"branching_factor\":%.3f,\"time_ms\":%u,\"score\":%d,\"best_move\":\"%s\",\"pv\":\"%s\"}\n",
+            d->depth, d->nodes, d->qnodes, d->eval_calls, d->beta_cutoffs, d->first_move_cutoffs,
+            d->beta_cutoffs ? (double)d->first_move_cutoffs / d->beta_cutoffs : 0.0, d->tb_hits,
+            d->tt_hits, d->branching_factor, d->time_ms, d->score, move, pv_text);
+}
+
+static void write_search_stats_json(FILE* out, const AISearchStats* st) {
+    fprintf(out, "{\"type\":\"search\",\"depth\":%d,\"nodes\":%ld,\"qnodes\":%ld,\"eval_calls\":%ld,"
+                 "\"beta_cutoffs\":%ld,\"first_move_cutoffs\":%ld,\"tb_hits\":%ld,\"tt_hits\":%ld,\"time_ms\":%u,\"nps\":%.0f}\n",
+            st->num_depths, st->nodes, st->qnodes, st->eval_calls, st->beta_cutoffs, st->first_move_cutoffs, st->tb_hits, st->tt_hits,
+            st->time_ms, st->time_ms ? (double)(st->nodes + st->qnodes) * 1000.0 / st->time_ms : 0.0);
+    fflush(out);
+}
+
+// Folds the counters of the iteration in progress into the search totals.
+static void add_iteration_to_totals(AIEngine* engine) {
+    AISearchStats* totals = &engine->search_stats;
+    const AIDepthStats* it = &engine->iteration_stats;
+    totals->nodes += it->nodes;
+    totals->qnodes += it->qnodes;
+    totals->eval_calls += it->eval_calls;
+    totals->beta_cutoffs += it->beta_cutoffs;
+    totals->first_move_cutoffs += it->first_move_cutoffs;
+    totals->tb_hits += it->tb_hits;
+    totals->tt_hits += it->tt_hits;
+}
+
+// Score of a tablebase result for the side to move; quicker mates score higher.
+static int tablebase_score(const TBResult* tb, int ply) {
+    if (tb->wdl == 0) return 0;
+    int score = TB_WIN_SCORE - ply - tb->dtm;
+    return (tb->wdl > 0) ? score : -score;
+}
+
+int ai_score_to_mate(int score) {
+    if (score >= MATE_THRESHOLD) return (KING_VALUE - score + 1) / 2;
+    if (score <= -MATE_THRESHOLD) return -(KING_VALUE + score + 1) / 2;
+    return 0;
+}
+
+// Scores that depend on the ply they were found at are stored relative to the node in the
+// transposition table, so an entry stays right when the position is reached at another ply.
+static int score_to_tt(int score, int ply) {
+    if (score >= TB_WIN_THRESHOLD) return score + ply;
+    if (score <= -TB_WIN_THRESHOLD) return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score >= TB_WIN_THRESHOLD) return score - ply;
+    if (score <= -TB_WIN_THRESHOLD) return score + ply;
+    return score;
+}
+
+int ai_evaluate_board(AIEngine* engine, const Position* pos, PieceColor player_to_evaluate_for) {
+    engine->iteration_stats.eval_calls++;
+    int final_score = pst_evaluate(pos, player_to_evaluate_for);
 
-    for (int r = 0; r < 8; ++r) {
-        for (int c = 0; c < 8; ++c) {
-            Piece p = board[r][c];
-            if (p.type != EMPTY) {
-                int piece_val = 0;
-                int pst_val_for_piece = 0;
-                int r_for_pst = (p.color == WHITE) ? r : (7 - r);
-
-                switch (p.type) {
-                    case PAWN:   piece_val = PAWN_VALUE;   pst_val_for_piece = pawn_pst_white[r_for_pst][c]; break;
-                    case KNIGHT: piece_val = KNIGHT_VALUE; pst_val_for_piece = knight_pst_white[r_for_pst][c]; break;
-                    case BISHOP: piece_val = BISHOP_VALUE; pst_val_for_piece = bishop_pst_white[r_for_pst][c]; break;
-                    case ROOK:   piece_val = ROOK_VALUE;   pst_val_for_piece = rook_pst_white[r_for_pst][c]; break;
-                    case QUEEN:  piece_val = QUEEN_VALUE;  pst_val_for_piece = queen_pst_white[r_for_pst][c]; break;
-                    case KING:   pst_val_for_piece = king_pst_white_midgame[r_for_pst][c]; break;
-                    default: break;
-                }
-                if (p.color == player_to_evaluate_for) {
-                    if (p.type != KING) material_score += piece_val;
-                    positional_score += pst_val_for_piece;
-                } else {
-                    if (p.type != KING) material_score -= piece_val;
-                    positional_score -= pst_val_for_piece;
-                }
-            }
-        }
-    }
-    int final_score = material_score + positional_score;
-    
     PieceColor opponent_color = (player_to_evaluate_for == WHITE) ? BLACK : WHITE;
-    bool player_has_moves = has_any_legal_moves(board, player_to_evaluate_for);
+    bool player_has_moves = has_any_legal_moves(pos, player_to_evaluate_for);
     if (!player_has_moves) {
-        return is_king_in_check(board, player_to_evaluate_for) ? -KING_VALUE : 0; // Checkmate or Stalemate
+        return is_king_in_check(pos->board, player_to_evaluate_for) ? -KING_VALUE : 0; // Checkmate or Stalemate
     }
-    bool opponent_has_moves = has_any_legal_moves(board, opponent_color);
-    if (!opponent_has_moves && is_king_in_check(board, opponent_color)) {
+    bool opponent_has_moves = has_any_legal_moves(pos, opponent_color);
+    if (!opponent_has_moves && is_king_in_check(pos->board, opponent_color)) {
         return KING_VALUE; // Opponent is checkmated
     }
     return final_score;
 }
 
-static int find_all_legal_ai_moves(const Piece board[8][8], PieceColor player_color, AIMove legal_moves[], int max_moves_capacity) {
+// ai_evaluate_board inside the search: a mate on the board is ply plies from the root.
+static int evaluate_at_ply(AIEngine* engine, const Position* pos, PieceColor player_to_evaluate_for, int ply) {
+    int score = ai_evaluate_board(engine, pos, player_to_evaluate_for);
+    if (score == KING_VALUE) return KING_VALUE - ply;
+    if (score == -KING_VALUE) return -KING_VALUE + ply;
+    return score;
+}
+
+// Pruning relies on null-move-like reasoning, which fails in pawn endgames (zugzwang)
+static bool has_non_pawn_material(const Position* pos, PieceColor color) {
+    for (int r = 0; r < 8; ++r)
+        for (int c = 0; c < 8; ++c) {
+            Piece p = pos->board[r][c];
+            if (p.color == color && p.type != EMPTY && p.type != PAWN && p.type != KING) return true;
+        }
+    return false;
+}
+
+static int find_all_legal_ai_moves(const Position* pos, PieceColor player_color, AIMove legal_moves[], int max_moves_capacity) {
+    PROFILE_SCOPE(PROF_MOVEGEN);
+    const Piece (*board)[8] = pos->board;
     int count = 0;
     for (int r_from = 0; r_from < 8; ++r_from) {
         for (int c_from = 0; c_from < 8; ++c_from) {
             if (board[r_from][c_from].type != EMPTY && board[r_from][c_from].color == player_color) {
                 for (int r_to = 0; r_to < 8; ++r_to) {
                     for (int c_to = 0; c_to < 8; ++c_to) {
-                        int original_ep_r = en_passant_target_r; int original_ep_c = en_passant_target_c;
-                        if (is_move_legal(board, r_from, c_from, r_to, c_to, player_color)) {
-                            if (count < max_moves_capacity) {
-                                legal_moves[count].from_r = r_from; legal_moves[count].from_c = c_from;
-                                legal_moves[count].to_r = r_to;     legal_moves[count].to_c = c_to;
-                                legal_moves[count].promotion_to = EMPTY; legal_moves[count].score = 0;
-                                if (board[r_from][c_from].type == PAWN && ((player_color == WHITE && r_to == 0) || (player_color == BLACK && r_to == 7))) {
-                                    legal_moves[count].promotion_to = QUEEN;
-                                }
-                                count++;
-                            } else { en_passant_target_r = original_ep_r; en_passant_target_c = original_ep_c; return count; }
+                        if (is_move_legal(pos, r_from, c_from, r_to, c_to, player_color)) {
+                            if (count == max_moves_capacity) return count;
+                            legal_moves[count].from_r = r_from; legal_moves[count].from_c = c_from;
+                            legal_moves[count].to_r = r_to;     legal_moves[count].to_c = c_to;
+                            legal_moves[count].promotion_to = EMPTY; legal_moves[count].score = 0;
+                            if (board[r_from][c_from].type == PAWN && ((player_color == WHITE && r_to == 0) || (player_color == BLACK && r_to == 7))) {
+                                legal_moves[count].promotion_to = QUEEN;
+                            }
+                            count++;
                         }
-                        en_passant_target_r = original_ep_r; en_passant_target_c = original_ep_c;
                     }
                 }
             }
@@ -170,70 +267,70 @@ static int find_all_legal_ai_moves(const Piece board[8][8], PieceColor player_co
     return count;
 }
 
-typedef struct {
-    Piece captured_piece;
-    Piece original_mover_piece;
-    int old_ep_r, old_ep_c;
-    bool castled_k, castled_q;
-    Piece actual_ep_captured_pawn;
-    int actual_ep_captured_pawn_r, actual_ep_captured_pawn_c;
-} TempMoveInfo;
-
-static TempMoveInfo make_temporary_move(Piece board_copy[8][8], const AIMove* move, PieceColor moving_player_color) {
-    TempMoveInfo info;
-    info.original_mover_piece = board_copy[move->from_r][move->from_c];
-    info.captured_piece = board_copy[move->to_r][move->to_c];
-    info.old_ep_r = en_passant_target_r; info.old_ep_c = en_passant_target_c;
-    info.castled_k = false; info.castled_q = false;
-    info.actual_ep_captured_pawn.type = EMPTY;
-
-    Piece piece_to_move_on_copy = board_copy[move->from_r][move->from_c];
-    board_copy[move->to_r][move->to_c] = piece_to_move_on_copy;
-    board_copy[move->to_r][move->to_c].has_moved = true;
-    board_copy[move->from_r][move->from_c].type = EMPTY;
-
-    if (move->promotion_to != EMPTY) board_copy[move->to_r][move->to_c].type = move->promotion_to;
-
-    if (piece_to_move_on_copy.type == PAWN && move->from_c != move->to_c && info.captured_piece.type == EMPTY && move->to_r == info.old_ep_r && move->to_c == info.old_ep_c) {
-        info.actual_ep_captured_pawn_r = (moving_player_color == WHITE) ? move->to_r + 1 : move->to_r - 1;
-        info.actual_ep_captured_pawn_c = move->to_c;
-        if (is_square_on_board(info.actual_ep_captured_pawn_r, info.actual_ep_captured_pawn_c) && board_copy[info.actual_ep_captured_pawn_r][info.actual_ep_captured_pawn_c].type == PAWN) {
-            info.actual_ep_captured_pawn = board_copy[info.actual_ep_captured_pawn_r][info.actual_ep_captured_pawn_c];
-            board_copy[info.actual_ep_captured_pawn_r][info.actual_ep_captured_pawn_c].type = EMPTY;
-        } else { info.actual_ep_captured_pawn.type = EMPTY; }
-    }
-    if (piece_to_move_on_copy.type == KING && abs(move->to_c - move->from_c) == 2) {
-        int rook_orig_c, rook_dest_c;
-        if (move->to_c > move->from_c) { rook_orig_c = 7; rook_dest_c = 5; info.castled_k = true; }
-        else { rook_orig_c = 0; rook_dest_c = 3; info.castled_q = true; }
-        board_copy[move->from_r][rook_dest_c] = board_copy[move->from_r][rook_orig_c];
-        board_copy[move->from_r][rook_dest_c].has_moved = true;
-        board_copy[move->from_r][rook_orig_c].type = EMPTY;
-    }
-    clear_en_passant_target();
-    if (piece_to_move_on_copy.type == PAWN && abs(move->to_r - move->from_r) == 2) {
-        set_en_passant_target((moving_player_color == WHITE) ? move->to_r + 1 : move->to_r - 1, move->to_c);
-    }
-    return info;
-}
-
-static void undo_temporary_move(Piece board_copy[8][8], const AIMove* move, TempMoveInfo info) {
-    board_copy[move->from_r][move->from_c] = info.original_mover_piece;
-    board_copy[move->to_r][move->to_c] = info.captured_piece;
-    if (info.actual_ep_captured_pawn.type != EMPTY) {
-        board_copy[info.actual_ep_captured_pawn_r][info.actual_ep_captured_pawn_c] = info.actual_ep_captured_pawn;
-        if (info.captured_piece.type == EMPTY) {
-             board_copy[move->to_r][move->to_c].type = EMPTY;
-        }
-    }
-    if (info.castled_k) {
-        board_copy[move->from_r][7] = board_copy[move->from_r][5]; board_copy[move->from_r][7].has_moved = false;
-        board_copy[move->from_r][5].type = EMPTY;
-    } else if (info.castled_q) {
-        board_copy[move->from_r][0] = board_copy[move->from_r][3]; board_copy[move->from_r][0].has_moved = false;
-        board_copy[move->from_r][3].type = EMPTY;
-    }
-    en_passant_target_r = info.old_ep_r; en_passant_target_c = info.old_ep_c;
+static void copy_position(Position* dest, const Position* src) {
+    PROFILE_SCOPE(PROF_BOARD_COPY);
+    *dest = *src;
+}
+
+// Plays move on pos, a copy owned by the caller: every ply searches its own position, so
+// there is nothing to take back afterwards.
+static void make_search_move(Position* pos, const AIMove* move) {
+    PROFILE_SCOPE(PROF_MAKE_UNMAKE);
+    Piece (*board)[8] = pos->board;
+    PieceColor moving_player_color = pos->turn;
+    Piece captured_piece = board[move->to_r][move->to_c];
+
+    Piece piece_to_move = board[move->from_r][move->from_c];
+    board[move->to_r][move->to_c] = piece_to_move;
+    board[move->from_r][move->from_c].type = EMPTY;
+
+    if (move->promotion_to != EMPTY) board[move->to_r][move->to_c].type = move->promotion_to;
+
+    if (piece_to_move.type == PAWN && move->from_c != move->to_c && captured_piece.type == EMPTY &&
+        move->to_r == pos->en_passant_r && move->to_c == pos->en_passant_c) {
+        int captured_pawn_r = (moving_player_color == WHITE) ? move->to_r + 1 : move->to_r - 1;
+        if (is_square_on_board(captured_pawn_r, move->to_c) && board[captured_pawn_r][move->to_c].type == PAWN) {
+            board[captured_pawn_r][move->to_c].type = EMPTY;
+        }
+    }
+    if (piece_to_move.type == KING && abs(move->to_c - move->from_c) == 2) {
+        int rook_orig_c = (move->to_c > move->from_c) ? 7 : 0;
+        int rook_dest_c = (move->to_c > move->from_c) ? 5 : 3;
+        board[move->from_r][rook_dest_c] = board[move->from_r][rook_orig_c];
+        board[move->from_r][rook_orig_c].type = EMPTY;
+    }
+    update_castling_rights(pos, move->from_r, move->from_c, move->to_r, move->to_c);
+    clear_en_passant_target(pos);
+    if (piece_to_move.type == PAWN && abs(move->to_r - move->from_r) == 2) {
+        set_en_passant_target(pos, (moving_player_color == WHITE) ? move->to_r + 1 : move->to_r - 1, move->to_c);
+    }
+    switch_player_turn(pos);
+}
+
+// Passed down instead of a child's evaluation when its parent did not compute one
+#define EVAL_UNKNOWN INT_MIN
+
+static bool nnue_active(const AIEngine* engine) {
+    return engine->nnue_stack != NULL && nnue_is_loaded();
+}
+
+// The position after move, to be searched at ply + 1, with its NNUE accumulator
+static void make_child(AIEngine* engine, Position* child, const Position* pos, const AIMove* move, int ply) {
+    copy_position(child, pos);
+    make_search_move(child, move);
+    if (nnue_active(engine) && ply < AI_MAX_PLY) nnue_update(&engine->nnue_stack[ply + 1], &engine->nnue_stack[ply], pos, child);
+}
+
+// Static evaluation inside the search (stand-pats and pruning): the network while one is
+// loaded, kept clear of the tablebase and mate scores; otherwise material and piece-square
+// score, which the parent's batch may already have computed (known_eval).
+static int search_evaluation(AIEngine* engine, const Position* pos, PieceColor player_to_evaluate_for, int ply, int known_eval) {
+    PROFILE_SCOPE(PROF_EVAL);
+    if (!nnue_active(engine)) return (known_eval != EVAL_UNKNOWN) ? known_eval : pst_evaluate(pos, player_to_evaluate_for);
+    int score = nnue_evaluate(&engine->nnue_stack[ply], pos->turn);
+    if (score > TB_WIN_THRESHOLD - 1) score = TB_WIN_THRESHOLD - 1;
+    if (score < -(TB_WIN_THRESHOLD - 1)) score = -(TB_WIN_THRESHOLD - 1);
+    return (pos->turn == player_to_evaluate_for) ? score : -score;
 }
 
 int score_move_for_ordering(const Piece board[8][8], const AIMove* move) {
@@ -245,20 +342,60 @@ int score_move_for_ordering(const Piece board[8][8], const AIMove* move) {
         score = 10 * victim.type - attacker.type;
     }
     if (move->promotion_to == QUEEN) score += QUEEN_VALUE;
-    
+
     return score;
 }
 
-void order_moves(const Piece board[8][8], AIMove legal_moves[], int num_legal_moves, int ply) {
+// Child evaluation the search hands to a child searched after move, for ai_color: the PST
+// score order_moves stored, from the point of view of the side that made the move
+static int known_child_eval(const AIEngine* engine, const AIMove* move, bool mover_is_ai) {
+    if (nnue_active(engine)) return EVAL_UNKNOWN;
+    return mover_is_ai ? move->score : -move->score;
+}
+
+// Material won by a capture or promotion, counting en passant
+static int capture_gain(const Piece board[8][8], const AIMove* move) {
+    const Piece* mover = &board[move->from_r][move->from_c];
+    int gain = piece_values[board[move->to_r][move->to_c].type];
+    if (mover->type == PAWN && move->from_c != move->to_c && board[move->to_r][move->to_c].type == EMPTY) gain = PAWN_VALUE;
+    if (move->promotion_to != EMPTY) gain += piece_values[move->promotion_to] - PAWN_VALUE;
+    return gain;
+}
+
+static bool same_squares(const AIMove* a, const AIMove* b) {
+    return a->from_r == b->from_r && a->to_r == b->to_r && a->from_c == b->from_c && a->to_c == b->to_c;
+}
+
+// Captures by MVV-LVA, then killers, then the other quiet moves by the evaluation of the
+// position they lead to. All children are scored in one batch, and each move's score is
+// left holding its child's PST evaluation for the side to move.
+void order_moves(const AIEngine* engine, const Position* pos, AIMove legal_moves[], int num_legal_moves, int ply) {
+    PSTBatch batch;
+    pst_batch_init(&batch, pos);
+    for (int i = 0; i < num_legal_moves; i++) {
+        const AIMove* m = &legal_moves[i];
+        pst_batch_add_move(&batch, pos, m->from_r, m->from_c, m->to_r, m->to_c, m->promotion_to);
+    }
+    {
+        PROFILE_SCOPE(PROF_EVAL); // The children's evaluations, later handed to search_evaluation
+        pst_batch_evaluate(&batch);
+    }
+
+    const Piece (*board)[8] = pos->board;
     int move_scores[256];
     for (int i = 0; i < num_legal_moves; i++) {
+        legal_moves[i].score = (pos->turn == WHITE) ? batch.scores[i] : -batch.scores[i];
         move_scores[i] = score_move_for_ordering(board, &legal_moves[i]);
+        bool is_killer1 = false, is_killer2 = false;
         if (ply < MAX_SEARCH_PLY) {
-            bool is_killer1 = (legal_moves[i].from_r == killer_moves[ply][0].from_r && legal_moves[i].to_r == killer_moves[ply][0].to_r && legal_moves[i].from_c == killer_moves[ply][0].from_c && legal_moves[i].to_c == killer_moves[ply][0].to_c);
-            bool is_killer2 = (legal_moves[i].from_r == killer_moves[ply][1].from_r && legal_moves[i].to_r == killer_moves[ply][1].to_r && legal_moves[i].from_c == killer_moves[ply][1].from_c && legal_moves[i].to_c == killer_moves[ply][1].to_c);
+            is_killer1 = same_squares(&legal_moves[i], &engine->killer_moves[ply][0]);
+            is_killer2 = same_squares(&legal_moves[i], &engine->killer_moves[ply][1]);
             if (is_killer1) move_scores[i] += 10000;
             else if (is_killer2) move_scores[i] += 5000;
         }
+        if (!is_killer1 && !is_killer2 && capture_gain(board, &legal_moves[i]) == 0) {
+            move_scores[i] = legal_moves[i].score - QUIET_ORDER_OFFSET;
+        }
     }
 
     for (int i = 0; i < num_legal_moves - 1; i++) {
@@ -276,158 +413,741 @@ void order_moves(const Piece board[8][8], AIMove legal_moves[], int num_legal_mo
     }
 }
 
-void store_killer_move(const AIMove* move, int ply) {
+// Makes move, followed by the line found below it, the best line at ply.
+static void update_pv(AIEngine* engine, int ply, const AIMove* move) {
+    int child_length = engine->pv_length[ply + 1];
+    engine->pv[ply][ply] = *move;
+    for (int i = ply + 1; i < child_length; ++i) engine->pv[ply][i] = engine->pv[ply + 1][i];
+    engine->pv_length[ply] = (child_length > ply + 1) ? child_length : ply + 1;
+}
+
+// Moves move to the front of the list, keeping the order of the others. Returns false if
+// it is not in the list.
+static bool move_to_front(AIMove moves[], int num_moves, const AIMove* move) {
+    for (int i = 0; i < num_moves; ++i) {
+        if (same_squares(&moves[i], move) && moves[i].promotion_to == move->promotion_to) {
+            AIMove found = moves[i];
+            memmove(&moves[1], &moves[0], sizeof(moves[0]) * i);
+            moves[0] = found;
+            return true;
+        }
+    }
+    return false;
+}
+
+// While the search is still walking down the previous iteration's best line, moves its
+// move for this ply to the front. Leaving the line at any ply ends it for the rest of
+// the iteration.
+static void order_pv_move_first(AIEngine* engine, AIMove legal_moves[], int num_legal_moves, int ply) {
+    engine->follow_pv = ply < engine->previous_pv.length &&
+                        move_to_front(legal_moves, num_legal_moves, &engine->previous_pv.moves[ply]);
+}
+
+void store_killer_move(AIEngine* engine, const AIMove* move, int ply) {
     if (ply >= MAX_SEARCH_PLY) return;
-    if (!(move->from_r == killer_moves[ply][0].from_r && move->to_r == killer_moves[ply][0].to_r && move->from_c == killer_moves[ply][0].from_c && move->to_c == killer_moves[ply][0].to_c)) {
-        killer_moves[ply][1] = killer_moves[ply][0];
-        killer_moves[ply][0] = *move;
+    AIMove* killers = engine->killer_moves[ply];
+    if (!same_squares(move, &killers[0])) {
+        killers[1] = killers[0];
+        killers[0] = *move;
+    }
+}
+
+// --- Quiescence Search ---
+// Searches captures and promotions until the position is quiet, plus moves that give check
+// on its first ply and every evasion when in check. Captures that lose material by static
+// exchange evaluation (SEE) or cannot reach the window (delta pruning) are skipped, so the
+// capture sequences need no depth limit; QUIESCENCE_MAX_PLY only guards the stack.
+#define QUIESCENCE_MAX_PLY AI_MAX_PLY
+#define MAX_SEE_SWAPS 32 // No more captures than pieces on the board
+
+static const int knight_offsets[8][2] = {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}};
+// Rook directions first, then bishop directions; together the king's steps
+static const int line_directions[8][2] = {{-1,0},{1,0},{0,-1},{0,1},{-1,-1},{-1,1},{1,-1},{1,1}};
+
+static int see_value(PieceType type) {
+    return type == KING ? KING_VALUE : piece_values[type];
+}
+
+// Least valuable piece of attacker_color attacking [r][c] (pins are ignored); false if none
+static bool least_valuable_attacker(const Piece board[8][8], int r, int c, PieceColor attacker_color, int* from_r, int* from_c) {
+    int best_value = INT_MAX;
+    int pawn_r = (attacker_color == WHITE) ? r + 1 : r - 1; // White pawns attack upwards (towards row 0)
+    for (int dc = -1; dc <= 1; dc += 2) {
+        if (is_square_on_board(pawn_r, c + dc) && board[pawn_r][c + dc].type == PAWN && board[pawn_r][c + dc].color == attacker_color) {
+            *from_r = pawn_r; *from_c = c + dc;
+            return true;
+        }
+    }
+    for (int i = 0; i < 8; ++i) {
+        int nr = r + knight_offsets[i][0], nc = c + knight_offsets[i][1];
+        if (is_square_on_board(nr, nc) && board[nr][nc].type == KNIGHT && board[nr][nc].color == attacker_color) {
+            *from_r = nr; *from_c = nc;
+            return true;
+        }
+    }
+    for (int d = 0; d < 8; ++d) {
+        bool diagonal = d >= 4;
+        int nr = r + line_directions[d][0], nc = c + line_directions[d][1];
+        for (int steps = 1; is_square_on_board(nr, nc); ++steps, nr += line_directions[d][0], nc += line_directions[d][1]) {
+            Piece p = board[nr][nc];
+            if (p.type == EMPTY) continue;
+            if (p.color == attacker_color && see_value(p.type) < best_value &&
+                (p.type == QUEEN || (p.type == (diagonal ? BISHOP : ROOK)) || (p.type == KING && steps == 1))) {
+                best_value = see_value(p.type); *from_r = nr; *from_c = nc;
+            }
+            break; // Anything behind the first piece is an x-ray, found once that piece has moved
+        }
     }
+    return best_value != INT_MAX;
 }
 
-#define MAX_QUIESCENCE_DEPTH 4
-static int quiescence_search(Piece current_board_sim[8][8], int alpha, int beta, bool is_maximizing_player, PieceColor ai_color_perspective, int q_depth, int current_ply) {
-    nodes_searched++;
-    int stand_pat_score = ai_evaluate_board(current_board_sim, ai_color_perspective);
-    if (q_depth >= MAX_QUIESCENCE_DEPTH) return stand_pat_score;
+// Material the side making the move wins if both sides keep recapturing on its target
+// square with their least valuable piece, each stopping when that no longer pays.
+static int static_exchange_evaluation(const Position* pos, const AIMove* move) {
+    Piece board[8][8];
+    memcpy(board, pos->board, sizeof(board));
+    int r = move->to_r, c = move->to_c;
+    Piece mover = board[move->from_r][move->from_c];
+    int gain[MAX_SEE_SWAPS];
+    gain[0] = capture_gain(pos->board, move);
+    if (mover.type == PAWN && move->from_c != move->to_c && board[r][c].type == EMPTY) board[move->from_r][c].type = EMPTY; // En passant
+    if (move->promotion_to != EMPTY) mover.type = move->promotion_to;
+    board[move->from_r][move->from_c].type = EMPTY;
+    board[r][c] = mover;
 
+    PieceColor side = (mover.color == WHITE) ? BLACK : WHITE;
+    int d = 0, from_r, from_c;
+    while (d + 1 < MAX_SEE_SWAPS && least_valuable_attacker(board, r, c, side, &from_r, &from_c)) {
+        d++;
+        gain[d] = see_value(board[r][c].type) - gain[d - 1];
+        board[r][c] = board[from_r][from_c];
+        board[from_r][from_c].type = EMPTY;
+        side = (side == WHITE) ? BLACK : WHITE;
+    }
+    for (; d > 0; --d) { // Each recapture is only made if it pays
+        if (-gain[d] < gain[d - 1]) gain[d - 1] = -gain[d];
+    }
+    return gain[0];
+}
+
+// Can a piece of this type on [r][c] attack [king_r][king_c] at all? Only the squares that
+// pass are tried as checking moves; discovered checks are left to the main search.
+static bool may_give_check(PieceType type, PieceColor color, int r, int c, int king_r, int king_c) {
+    int dr = king_r - r, dc = king_c - c;
+    int adr = abs(dr), adc = abs(dc);
+    switch (type) {
+        case PAWN:   return adc == 1 && dr == ((color == WHITE) ? -1 : 1);
+        case KNIGHT: return (adr == 1 && adc == 2) || (adr == 2 && adc == 1);
+        case BISHOP: return adr == adc;
+        case ROOK:   return dr == 0 || dc == 0;
+        case QUEEN:  return adr == adc || dr == 0 || dc == 0;
+        default:     return false;
+    }
+}
+
+static void add_quiescence_move(const Position* pos, AIMove moves[], int* count, int capacity, int fr, int fc, int tr, int tc, bool promotion, bool must_check) {
+    if (*count == capacity || !is_move_legal(pos, fr, fc, tr, tc, pos->board[fr][fc].color)) return;
+    AIMove move = {fr, fc, tr, tc, promotion ? QUEEN : EMPTY, 0};
+    if (must_check) {
+        Position child; copy_position(&child, pos); make_search_move(&child, &move);
+        if (!is_king_in_check(child.board, child.turn)) return;
+    }
+    moves[(*count)++] = move;
+}
+
+// Legal captures and promotions of color, walking each piece's own targets instead of
+// testing every square pair. With quiet_checks, also the non-capturing moves that give check.
+static int find_quiescence_moves(const Position* pos, PieceColor color, AIMove moves[], int capacity, bool quiet_checks) {
+    PROFILE_SCOPE(PROF_MOVEGEN);
+    const Piece (*board)[8] = pos->board;
+    PieceColor enemy = (color == WHITE) ? BLACK : WHITE;
+    int king_r = -1, king_c = -1;
+    if (quiet_checks) {
+        for (int r = 0; r < 8; ++r)
+            for (int c = 0; c < 8; ++c)
+                if (board[r][c].type == KING && board[r][c].color == enemy) { king_r = r; king_c = c; }
+        if (king_r < 0) quiet_checks = false;
+    }
+    int count = 0;
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            Piece p = board[r][c];
+            if (p.type == EMPTY || p.color != color) continue;
+            if (p.type == PAWN) {
+                int dir = (color == WHITE) ? -1 : 1;
+                int tr = r + dir;
+                if (!is_square_on_board(tr, c)) continue;
+                bool promotion = (tr == 0 || tr == 7);
+                for (int dc = -1; dc <= 1; dc += 2) {
+                    int tc = c + dc;
+                    if (!is_square_on_board(tr, tc)) continue;
+                    bool en_passant = (tr == pos->en_passant_r && tc == pos->en_passant_c);
+                    if ((board[tr][tc].type != EMPTY && board[tr][tc].color == enemy) || en_passant)
+                        add_quiescence_move(pos, moves, &count, capacity, r, c, tr, tc, promotion, false);
+                }
+                if (board[tr][c].type == EMPTY) {
+                    if (promotion) add_quiescence_move(pos, moves, &count, capacity, r, c, tr, c, true, false);
+                    else if (quiet_checks) {
+                        if (may_give_check(PAWN, color, tr, c, king_r, king_c)) add_quiescence_move(pos, moves, &count, capacity, r, c, tr, c, false, true);
+                        int start_r = (color == WHITE) ? 6 : 1;
+                        if (r == start_r && board[tr + dir][c].type == EMPTY && may_give_check(PAWN, color, tr + dir, c, king_r, king_c))
+                            add_quiescence_move(pos, moves, &count, capacity, r, c, tr + dir, c, false, true);
+                    }
+                }
+            } else if (p.type == KNIGHT || p.type == KING) {
+                const int (*offsets)[2] = (p.type == KNIGHT) ? knight_offsets : line_directions;
+                for (int i = 0; i < 8; ++i) {
+                    int tr = r + offsets[i][0], tc = c + offsets[i][1];
+                    if (!is_square_on_board(tr, tc) || board[tr][tc].color == color) continue;
+                    if (board[tr][tc].type != EMPTY) add_quiescence_move(pos, moves, &count, capacity, r, c, tr, tc, false, false);
+                    else if (quiet_checks && may_give_check(p.type, color, tr, tc, king_r, king_c))
+                        add_quiescence_move(pos, moves, &count, capacity, r, c, tr, tc, false, true);
+                }
+            } else {
+                int first = (p.type == BISHOP) ? 4 : 0, last = (p.type == ROOK) ? 4 : 8;
+                for (int d = first; d < last; ++d) {
+                    int tr = r + line_directions[d][0], tc = c + line_directions[d][1];
+                    for (; is_square_on_board(tr, tc); tr += line_directions[d][0], tc += line_directions[d][1]) {
+                        if (board[tr][tc].type != EMPTY) {
+                            if (board[tr][tc].color == enemy) add_quiescence_move(pos, moves, &count, capacity, r, c, tr, tc, false, false);
+                            break;
+                        }
+                        if (quiet_checks && may_give_check(p.type, color, tr, tc, king_r, king_c))
+                            add_quiescence_move(pos, moves, &count, capacity, r, c, tr, tc, false, true);
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+static int quiescence_search(AIEngine* engine, const Position* pos, int alpha, int beta, bool is_maximizing_player, PieceColor ai_color_perspective, int q_depth, int current_ply, int known_eval) {
+    PROFILE_SCOPE(PROF_QUIESCENCE);
+    AIDepthStats* stats = &engine->iteration_stats;
+    stats->qnodes++;
+    int ply = current_ply + q_depth;
+    const Piece (*board)[8] = pos->board;
     PieceColor player_this_turn = is_maximizing_player ? ai_color_perspective : (ai_color_perspective == WHITE ? BLACK : WHITE);
-    bool in_check = is_king_in_check(current_board_sim, player_this_turn);
+    bool in_check = is_king_in_check(board, player_this_turn);
 
+    stats->eval_calls++;
+    int stand_pat_score = search_evaluation(engine, pos, ai_color_perspective, ply, known_eval);
+    if (ply >= QUIESCENCE_MAX_PLY || search_should_stop(engine)) return stand_pat_score;
+
+    // Transposition table, as in minimax_ids; any entry is at least as deep as this node
+    uint64_t key = tt_key(pos);
+    const TTEntry* tt_entry = tt_probe(&engine->tt, key);
+    AIMove tt_move = {-1, -1, -1, -1, EMPTY, 0};
+    if (tt_entry) {
+        int tt_score = score_from_tt(tt_entry->score, ply);
+        TTBound bound = tt_entry->bound;
+        if (player_this_turn != ai_color_perspective) {
+            tt_score = -tt_score;
+            if (bound != TT_EXACT) bound = (bound == TT_LOWER) ? TT_UPPER : TT_LOWER;
+        }
+        if (bound == TT_EXACT || (bound == TT_LOWER && tt_score >= beta) || (bound == TT_UPPER && tt_score <= alpha)) {
+            stats->tt_hits++;
+            return tt_score;
+        }
+        if (tt_entry->from >= 0) tt_move = (AIMove){tt_entry->from / 8, tt_entry->from % 8, tt_entry->to / 8, tt_entry->to % 8, tt_entry->promotion, 0};
+    }
+
+    int original_alpha = alpha, original_beta = beta;
     if (!in_check) {
-        if (is_maximizing_player) { if (stand_pat_score >= beta) return beta; if (stand_pat_score > alpha) alpha = stand_pat_score; }
-        else { if (stand_pat_score <= alpha) return alpha; if (stand_pat_score < beta) beta = stand_pat_score; }
+        if (is_maximizing_player) { if (stand_pat_score >= beta) return stand_pat_score; if (stand_pat_score > alpha) alpha = stand_pat_score; }
+        else { if (stand_pat_score <= alpha) return stand_pat_score; if (stand_pat_score < beta) beta = stand_pat_score; }
     }
 
-    AIMove q_moves[128]; int num_q_moves = 0;
+    AIMove q_moves[256]; int num_q_moves;
     if (in_check) {
-        num_q_moves = find_all_legal_ai_moves(current_board_sim, player_this_turn, q_moves, 128);
+        num_q_moves = find_all_legal_ai_moves(pos, player_this_turn, q_moves, 256);
+        if (num_q_moves == 0) return (player_this_turn == ai_color_perspective) ? -(KING_VALUE - ply) : KING_VALUE - ply;
     } else {
-        for (int r_f=0;r_f<8;++r_f) for(int c_f=0;c_f<8;++c_f) if(current_board_sim[r_f][c_f].type!=EMPTY && current_board_sim[r_f][c_f].color==player_this_turn) for(int r_t=0;r_t<8;++r_t) for(int c_t=0;c_t<8;++c_t) {
-            bool is_cap = (current_board_sim[r_t][c_t].type!=EMPTY && current_board_sim[r_t][c_t].color!=player_this_turn);
-            bool is_promo = (current_board_sim[r_f][c_f].type==PAWN && ((player_this_turn==WHITE && r_t==0)||(player_this_turn==BLACK && r_t==7)));
-            if (is_cap || is_promo) {
-                int oer=en_passant_target_r,oec=en_passant_target_c; if(is_move_legal(current_board_sim,r_f,c_f,r_t,c_t,player_this_turn)){ if(num_q_moves<128) q_moves[num_q_moves++]=(AIMove){r_f,c_f,r_t,c_t,is_promo?QUEEN:EMPTY,0};} en_passant_target_r=oer;en_passant_target_c=oec;
-            }
+        num_q_moves = find_quiescence_moves(pos, player_this_turn, q_moves, 256, q_depth == 0);
+        if (num_q_moves == 0) return stand_pat_score;
+    }
+    order_moves(engine, pos, q_moves, num_q_moves, ply);
+    if (tt_move.from_r >= 0) move_to_front(q_moves, num_q_moves, &tt_move);
+    bool delta_pruning = !in_check && stand_pat_score > -TB_WIN_THRESHOLD && stand_pat_score < TB_WIN_THRESHOLD;
+
+    int best_val = is_maximizing_player ? (in_check ? INT_MIN : stand_pat_score) : (in_check ? INT_MAX : stand_pat_score);
+    int best_index = -1;
+    for (int i = 0; i < num_q_moves; ++i) {
+        if (!in_check) {
+            int gain = capture_gain(board, &q_moves[i]);
+            if (delta_pruning && (is_maximizing_player ? stand_pat_score + gain + DELTA_MARGIN <= alpha : stand_pat_score - gain - DELTA_MARGIN >= beta)) continue;
+            if (static_exchange_evaluation(pos, &q_moves[i]) < 0) continue;
+        }
+        Position child; make_child(engine, &child, pos, &q_moves[i], ply);
+        int score = quiescence_search(engine, &child, alpha, beta, !is_maximizing_player, ai_color_perspective, q_depth + 1, current_ply,
+                                      known_child_eval(engine, &q_moves[i], is_maximizing_player));
+        if (is_maximizing_player) {
+            if (score > best_val) { best_val = score; best_index = i; }
+            if (score > alpha) alpha = score;
+        } else {
+            if (score < best_val) { best_val = score; best_index = i; }
+            if (score < beta) beta = score;
         }
+        if (alpha >= beta) break;
     }
-    if (num_q_moves == 0) return stand_pat_score;
-    order_moves(current_board_sim, q_moves, num_q_moves, current_ply + q_depth);
 
-    if (is_maximizing_player) {
-        int best_val = in_check ? INT_MIN : stand_pat_score;
-        for (int i=0;i<num_q_moves;++i) {
-            Piece cpy[8][8]; memcpy(cpy,current_board_sim,sizeof(Piece[8][8])); TempMoveInfo info = make_temporary_move(cpy,&q_moves[i],player_this_turn);
-            int score = quiescence_search(cpy,alpha,beta,false,ai_color_perspective,q_depth+1, current_ply);
-            undo_temporary_move(cpy,&q_moves[i],info);
-            best_val=(score>best_val)?score:best_val; alpha=(score>alpha)?score:alpha; if(alpha>=beta)break;
-        } return best_val;
-    } else {
-        int best_val = in_check ? INT_MAX : stand_pat_score;
-        for (int i=0;i<num_q_moves;++i) {
-            Piece cpy[8][8]; memcpy(cpy,current_board_sim,sizeof(Piece[8][8])); TempMoveInfo info = make_temporary_move(cpy,&q_moves[i],player_this_turn);
-            int score = quiescence_search(cpy,alpha,beta,true,ai_color_perspective,q_depth+1, current_ply);
-            undo_temporary_move(cpy,&q_moves[i],info);
-            best_val=(score<best_val)?score:best_val; beta=(score<beta)?score:beta; if(alpha>=beta)break;
-        } return best_val;
+    if (!engine->stopped) {
+        TTBound bound = TT_EXACT;
+        if (best_val <= original_alpha) bound = TT_UPPER;
+        else if (best_val >= original_beta) bound = TT_LOWER;
+        int stored_score = best_val;
+        if (player_this_turn != ai_color_perspective) {
+            stored_score = -stored_score;
+            if (bound != TT_EXACT) bound = (bound == TT_LOWER) ? TT_UPPER : TT_LOWER;
+        }
+        TTEntry entry = {key, (int16_t)score_to_tt(stored_score, ply), 0, (uint8_t)bound, -1, -1, EMPTY, 0};
+        if (best_index >= 0) {
+            const AIMove* best = &q_moves[best_index];
+            entry.from = (int8_t)(best->from_r * 8 + best->from_c);
+            entry.to = (int8_t)(best->to_r * 8 + best->to_c);
+            entry.promotion = (uint8_t)best->promotion_to;
+        }
+        tt_store(&engine->tt, &entry);
     }
+    return best_val;
 }
 
-static int minimax_ids(Piece board_sim[8][8], int depth, int alpha, int beta, bool is_max, PieceColor ai_color, int ply, Uint32 start_time, int time_limit_ms) {
-    nodes_searched++;
-    if (SDL_GetTicks() - start_time > time_limit_ms && depth < 2) {
-        return ai_evaluate_board(board_sim, ai_color);
+static int minimax_ids(AIEngine* engine, const Position* pos, int depth, int alpha, int beta, bool is_max, PieceColor ai_color, int ply, int known_eval);
+
+// Searches every move but the TT move to half the depth with a null window just below the
+// TT score (just above it at a minimizing node); the TT move is singular if none gets there.
+static bool tt_move_is_singular(AIEngine* engine, const Position* pos, const AIMove moves[], int num_moves, const AIMove* tt_move,
+                                int tt_score, int depth, bool is_max, PieceColor ai_color, int ply) {
+    int margin = SINGULAR_MARGIN_PER_PLY * depth;
+    bool follow_pv = engine->follow_pv; // The verification searches are off the PV
+    engine->follow_pv = false;
+    bool singular = true;
+    for (int i = 0; i < num_moves && singular && !engine->stopped; ++i) {
+        if (same_squares(&moves[i], tt_move) && moves[i].promotion_to == tt_move->promotion_to) continue;
+        Position child; make_child(engine, &child, pos, &moves[i], ply);
+        if (is_max) {
+            int singular_beta = tt_score - margin;
+            singular = minimax_ids(engine, &child, (depth - 1) / 2, singular_beta - 1, singular_beta, false, ai_color, ply + 1,
+                                    known_child_eval(engine, &moves[i], true)) < singular_beta;
+        } else {
+            int singular_alpha = tt_score + margin;
+            singular = minimax_ids(engine, &child, (depth - 1) / 2, singular_alpha, singular_alpha + 1, true, ai_color, ply + 1,
+                                    known_child_eval(engine, &moves[i], false)) > singular_alpha;
+        }
     }
+    engine->follow_pv = follow_pv;
+    return singular && !engine->stopped;
+}
+
+// known_eval: the PST evaluation of pos for ai_color if the parent computed it, else EVAL_UNKNOWN
+static int minimax_ids(AIEngine* engine, const Position* pos, int depth, int alpha, int beta, bool is_max, PieceColor ai_color, int ply, int known_eval) {
+    AIDepthStats* stats = &engine->iteration_stats;
+    stats->nodes++;
+    engine->pv_length[ply] = ply; // No line yet, and none at all for leaves
+    if (search_should_stop(engine)) {
+        return evaluate_at_ply(engine, pos, ai_color, ply);
+    }
+    PieceColor turn = is_max ? ai_color : (ai_color == WHITE ? BLACK : WHITE);
+    TBResult tb = {0};
+    if (tb_probe(pos, &tb)) { // Exact result: no need to search below this node
+        stats->tb_hits++;
+        int score = tablebase_score(&tb, ply);
+        return (turn == ai_color) ? score : -score;
+    }
+
+    // Mate distance pruning: nothing here can beat mating on the next ply or do worse than
+    // being mated now, so a window outside those bounds is already decided.
+    int best_possible = KING_VALUE - ply - 1, worst_possible = -(KING_VALUE - ply);
+    if (!is_max) { best_possible = KING_VALUE - ply; worst_possible = -(KING_VALUE - ply - 1); } // For the AI, mated a ply later
+    if (alpha < worst_possible) alpha = worst_possible;
+    if (beta > best_possible) beta = best_possible;
+    if (alpha >= beta) return is_max ? alpha : beta;
+
+    const Piece (*board)[8] = pos->board;
+    bool in_check = is_king_in_check(board, turn);
+    if (in_check && ply + depth < MAX_SEARCH_PLY) depth++; // Check extension
     if (depth == 0) {
-        return quiescence_search(board_sim, alpha, beta, is_max, ai_color, 0, ply);
+        return quiescence_search(engine, pos, alpha, beta, is_max, ai_color, 0, ply, known_eval);
     }
 
-    PieceColor turn = is_max ? ai_color : (ai_color == WHITE ? BLACK : WHITE);
-    if (!has_any_legal_moves(board_sim, turn)) {
-        return ai_evaluate_board(board_sim, ai_color);
+    // Transposition table: entries hold scores for the side to move
+    uint64_t key = tt_key(pos);
+    const TTEntry* tt_entry = tt_probe(&engine->tt, key);
+    AIMove tt_move = {-1, -1, -1, -1, EMPTY, 0};
+    int tt_score = 0;
+    if (tt_entry) {
+        tt_score = score_from_tt(tt_entry->score, ply);
+        TTBound bound = tt_entry->bound;
+        if (turn != ai_color) {
+            tt_score = -tt_score;
+            if (bound != TT_EXACT) bound = (bound == TT_LOWER) ? TT_UPPER : TT_LOWER;
+        }
+        if (tt_entry->depth >= depth && (bound == TT_EXACT || (bound == TT_LOWER && tt_score >= beta) || (bound == TT_UPPER && tt_score <= alpha))) {
+            stats->tt_hits++;
+            return tt_score;
+        }
+        if (tt_entry->from >= 0) tt_move = (AIMove){tt_entry->from / 8, tt_entry->from % 8, tt_entry->to / 8, tt_entry->to % 8, tt_entry->promotion, 0};
     }
 
+    // Near the horizon, away from the PV and mate scores, the static evaluation decides
+    // whether a node is worth searching (reverse futility) and which quiet moves are
+    // (futility). The bound being tested is alpha at a maximizing node, beta at a minimizing one.
+    bool shallow = !in_check && !engine->follow_pv && (depth <= REVERSE_FUTILITY_DEPTH || depth <= FUTILITY_DEPTH) &&
+                   alpha > -TB_WIN_THRESHOLD && beta < TB_WIN_THRESHOLD && has_non_pawn_material(pos, turn);
+    int static_eval = shallow ? search_evaluation(engine, pos, ai_color, ply, known_eval) : 0;
+    if (shallow && depth <= REVERSE_FUTILITY_DEPTH) {
+        int margin = REVERSE_FUTILITY_MARGIN * depth;
+        if (is_max && static_eval - margin >= beta) return static_eval - margin;
+        if (!is_max && static_eval + margin <= alpha) return static_eval + margin;
+    }
+    bool futility_pruning = shallow && depth <= FUTILITY_DEPTH;
+    int futility_value = is_max ? static_eval + FUTILITY_MARGIN * depth : static_eval - FUTILITY_MARGIN * depth;
+
     AIMove legal_moves[256];
-    int num_legal_moves = find_all_legal_ai_moves(board_sim, turn, legal_moves, 256);
-    order_moves(board_sim, legal_moves, num_legal_moves, ply);
+    int num_legal_moves = find_all_legal_ai_moves(pos, turn, legal_moves, 256);
+    if (num_legal_moves == 0) { // Mated here, or stalemate
+        if (!in_check) return 0;
+        return (turn == ai_color) ? -(KING_VALUE - ply) : KING_VALUE - ply;
+    }
+    order_moves(engine, pos, legal_moves, num_legal_moves, ply);
+    bool has_tt_move = tt_move.from_r >= 0 && move_to_front(legal_moves, num_legal_moves, &tt_move);
+    if (engine->follow_pv) order_pv_move_first(engine, legal_moves, num_legal_moves, ply);
 
+    // Singular extension; the TT score must be a bound in the direction being tested
+    bool extend_tt_move = false;
+    if (has_tt_move && depth >= SINGULAR_MIN_DEPTH && ply + depth < MAX_SEARCH_PLY &&
+        tt_entry->depth >= depth - SINGULAR_TT_DEPTH_SLACK && tt_entry->bound != TT_UPPER &&
+        tt_score < MATE_THRESHOLD && tt_score > -MATE_THRESHOLD) {
+        extend_tt_move = tt_move_is_singular(engine, pos, legal_moves, num_legal_moves, &tt_move, tt_score, depth, is_max, ai_color, ply);
+    }
+
+    int original_alpha = alpha, original_beta = beta;
+    int best_index = 0;
+    int best_eval;
     if (is_max) {
         int max_eval = INT_MIN;
         for (int i=0;i<num_legal_moves;++i) {
-            Piece cpy[8][8]; memcpy(cpy,board_sim,sizeof(Piece[8][8])); TempMoveInfo info = make_temporary_move(cpy,&legal_moves[i],turn);
-            int eval = minimax_ids(cpy,depth-1,alpha,beta,false,ai_color,ply+1,start_time,time_limit_ms);
-            undo_temporary_move(cpy,&legal_moves[i],info);
-            if(eval>max_eval) max_eval=eval; if(eval>alpha) alpha=eval;
-            if(beta<=alpha) { if(board_sim[legal_moves[i].to_r][legal_moves[i].to_c].type == EMPTY) store_killer_move(&legal_moves[i], ply); break; }
-        } return max_eval;
+            Position child; make_child(engine, &child, pos, &legal_moves[i], ply);
+            if (futility_pruning && futility_value <= alpha && capture_gain(board, &legal_moves[i]) == 0 && !is_king_in_check(child.board, child.turn)) {
+                if (futility_value > max_eval) max_eval = futility_value; // What the skipped move could have scored at best
+                continue;
+            }
+            int extension = (extend_tt_move && same_squares(&legal_moves[i], &tt_move)) ? 1 : 0;
+            int eval = minimax_ids(engine,&child,depth-1+extension,alpha,beta,false,ai_color,ply+1,known_child_eval(engine,&legal_moves[i],true));
+            if(eval>max_eval) { max_eval=eval; best_index=i; }
+            if(eval>alpha) { alpha=eval; update_pv(engine, ply, &legal_moves[i]); }
+            if(beta<=alpha) { stats->beta_cutoffs++; if(i==0) stats->first_move_cutoffs++; if(board[legal_moves[i].to_r][legal_moves[i].to_c].type == EMPTY) store_killer_move(engine, &legal_moves[i], ply); break; }
+        }
+        best_eval = max_eval;
     } else {
         int min_eval = INT_MAX;
         for (int i=0;i<num_legal_moves;++i) {
-            Piece cpy[8][8]; memcpy(cpy,board_sim,sizeof(Piece[8][8])); TempMoveInfo info = make_temporary_move(cpy,&legal_moves[i],turn);
-            int eval = minimax_ids(cpy,depth-1,alpha,beta,true,ai_color,ply+1,start_time,time_limit_ms);
-            undo_temporary_move(cpy,&legal_moves[i],info);
-            if(eval<min_eval) min_eval=eval; if(eval<beta) beta=eval;
-            if(beta<=alpha) { if(board_sim[legal_moves[i].to_r][legal_moves[i].to_c].type == EMPTY) store_killer_move(&legal_moves[i], ply); break; }
-        } return min_eval;
+            Position child; make_child(engine, &child, pos, &legal_moves[i], ply);
+            if (futility_pruning && futility_value >= beta && capture_gain(board, &legal_moves[i]) == 0 && !is_king_in_check(child.board, child.turn)) {
+                if (futility_value < min_eval) min_eval = futility_value;
+                continue;
+            }
+            int extension = (extend_tt_move && same_squares(&legal_moves[i], &tt_move)) ? 1 : 0;
+            int eval = minimax_ids(engine,&child,depth-1+extension,alpha,beta,true,ai_color,ply+1,known_child_eval(engine,&legal_moves[i],false));
+            if(eval<min_eval) { min_eval=eval; best_index=i; }
+            if(eval<beta) { beta=eval; update_pv(engine, ply, &legal_moves[i]); }
+            if(beta<=alpha) { stats->beta_cutoffs++; if(i==0) stats->first_move_cutoffs++; if(board[legal_moves[i].to_r][legal_moves[i].to_c].type == EMPTY) store_killer_move(engine, &legal_moves[i], ply); break; }
+        }
+        best_eval = min_eval;
+    }
+
+    if (!engine->stopped) { // An interrupted search has no reliable result to keep
+        TTBound bound = TT_EXACT;
+        if (best_eval <= original_alpha) bound = TT_UPPER;
+        else if (best_eval >= original_beta) bound = TT_LOWER;
+        int stored_score = best_eval;
+        if (turn != ai_color) {
+            stored_score = -stored_score;
+            if (bound != TT_EXACT) bound = (bound == TT_LOWER) ? TT_UPPER : TT_LOWER;
+        }
+        const AIMove* best = &legal_moves[best_index];
+        TTEntry entry = {key, (int16_t)score_to_tt(stored_score, ply), (int8_t)depth, (uint8_t)bound,
+                         (int8_t)(best->from_r * 8 + best->from_c), (int8_t)(best->to_r * 8 + best->to_c), (uint8_t)best->promotion_to, 0};
+        tt_store(&engine->tt, &entry);
+    }
+    return best_eval;
+}
+
+// Plays a move from the opening book, if one is open and has the position. The book move
+// must match one of the generated legal moves, which guards against key collisions.
+static bool select_book_move(const Position* pos, AIMove* chosen_move) {
+    BookMove book_move;
+    if (!book_is_open() || !book_pick_move(pos, &book_move)) return false;
+
+    AIMove legal_moves[256];
+    int num_legal_moves = find_all_legal_ai_moves(pos, pos->turn, legal_moves, 256);
+    for (int i = 0; i < num_legal_moves; ++i) {
+        const AIMove* m = &legal_moves[i];
+        if (m->from_r == book_move.from_r && m->from_c == book_move.from_c &&
+            m->to_r == book_move.to_r && m->to_c == book_move.to_c &&
+            (book_move.promotion_to == EMPTY || book_move.promotion_to == m->promotion_to)) {
+            *chosen_move = *m;
+            char san[MAX_SAN_LENGTH];
+            move_to_san(pos, chosen_move, san, sizeof(san));
+            printf("AI (%s) plays book move %s (weight %d)\n", pos->turn == WHITE ? "W":"B", san, book_move.weight);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ai_select_move(AIEngine* engine, const Position* pos, AIMove* best_overall_move, int time_limit_ms) {
+    if (select_book_move(pos, best_overall_move)) return true;
+
+    AISearchLimits limits = {0};
+    limits.time_limit_ms = time_limit_ms;
+    limits.verbose = true;
+    return ai_search(engine, pos, &limits, best_overall_move, NULL);
+}
+
+bool ai_select_move_clocked(AIEngine* engine, const Position* pos, AIMove* best_overall_move, const TimeControl* clock) {
+    if (select_book_move(pos, best_overall_move)) return true;
+
+    AISearchLimits limits = {0};
+    limits.clock = *clock;
+    limits.verbose = true;
+    return ai_search(engine, pos, &limits, best_overall_move, NULL);
+}
+
+// Picks the root move with the best tablebase outcome: the fastest win, else a draw, else
+// the slowest loss. Returns false if the position (or every move from it) is not covered.
+static bool select_tablebase_move(const Position* pos, const AIMove moves[], int num_moves, AIMove* chosen_move, int* score) {
+    TBResult tb = {0};
+    if (!tb_probe(pos, &tb)) return false;
+
+    PieceColor opponent = (pos->turn == WHITE) ? BLACK : WHITE;
+    bool found = false;
+    for (int i = 0; i < num_moves; ++i) {
+        Position after_move; copy_position(&after_move, pos);
+        make_search_move(&after_move, &moves[i]);
+        TBResult child;
+        bool covered;
+        if (!has_any_legal_moves(&after_move, opponent)) { // Mate or stalemate on the board
+            covered = true;
+            child.wdl = is_king_in_check(after_move.board, opponent) ? -1 : 0;
+            child.dtm = 0;
+        } else {
+            covered = tb_probe(&after_move, &child);
+        }
+        if (!covered) continue; // e.g. a double pawn push leaves an en passant square
+
+        int move_score = -tablebase_score(&child, 1);
+        if (!found || move_score > *score) {
+            found = true;
+            *score = move_score;
+            *chosen_move = moves[i];
+        }
+    }
+    return found;
+}
+
+// Sorts root moves by their score in the previous iteration, best first. The exact scores
+// of the previous lines come before the upper bounds of the other moves; equal scores keep
+// their order, so the previous best move is searched first.
+static void order_root_moves_by_score(AIMove moves[], int num_moves) {
+    for (int i = 1; i < num_moves; ++i) {
+        AIMove move = moves[i];
+        int j = i;
+        for (; j > 0 && moves[j - 1].score < move.score; --j) moves[j] = moves[j - 1];
+        moves[j] = move;
     }
 }
 
-bool ai_select_move(const Piece board[8][8], PieceColor ai_player_color, AIMove* best_overall_move, int time_limit_ms) {
+// Inserts the line of a root move just searched (the move plus the PV below it) into
+// lines, best first, keeping at most max_lines. A move that ties an existing line goes after
+// it, so the earlier move stays ahead.
+static void insert_root_line(const AIEngine* engine, AIPrincipalVariation lines[], int* num_lines, int max_lines, const AIMove* move, int score) {
+    int slot = *num_lines;
+    while (slot > 0 && lines[slot - 1].score < score) slot--;
+    if (slot >= max_lines) return;
+    int last = (*num_lines < max_lines) ? (*num_lines)++ : max_lines - 1;
+    for (int i = last; i > slot; --i) lines[i] = lines[i - 1];
+    AIPrincipalVariation* line = &lines[slot];
+    line->score = score;
+    line->moves[0] = *move;
+    line->length = 1;
+    for (int i = 1; i < engine->pv_length[1]; ++i) line->moves[line->length++] = engine->pv[1][i];
+}
+
+bool ai_search(AIEngine* engine, const Position* pos, const AISearchLimits* limits, AIMove* best_overall_move, AISearchResult* result) {
+    PieceColor ai_player_color = pos->turn;
     AIMove legal_root_moves[256];
-    int num_legal_root_moves = find_all_legal_ai_moves(board, ai_player_color, legal_root_moves, 256);
+    int num_legal_root_moves = find_all_legal_ai_moves(pos, ai_player_color, legal_root_moves, 256);
 
     if (num_legal_root_moves == 0) return false;
 
+    AIDepthStats* iteration_stats = &engine->iteration_stats;
+    AISearchStats* search_stats = &engine->search_stats;
+    int tablebase_score_at_root = 0;
+    if (select_tablebase_move(pos, legal_root_moves, num_legal_root_moves, best_overall_move, &tablebase_score_at_root)) {
+        if (limits->verbose) printf("AI (%s) plays tablebase move [%d,%d]->[%d,%d], score %d\n", ai_player_color == WHITE ? "W":"B",
+                                    best_overall_move->from_r, best_overall_move->from_c, best_overall_move->to_r, best_overall_move->to_c,
+                                    tablebase_score_at_root);
+        memset(search_stats, 0, sizeof(*search_stats));
+        AIPrincipalVariation tablebase_line = {tablebase_score_at_root, 1, {*best_overall_move}};
+        if (limits->on_iteration) {
+            AIIterationInfo info = {0, *best_overall_move, tablebase_score_at_root, 0, 0, 1, &tablebase_line};
+            limits->on_iteration(&info, limits->user_data);
+        }
+        if (result) {
+            memset(result, 0, sizeof(*result));
+            result->score = tablebase_score_at_root;
+            result->num_lines = 1;
+            result->lines[0] = tablebase_line;
+        }
+        return true;
+    }
+
     *best_overall_move = legal_root_moves[0];
     int best_overall_score = INT_MIN;
+    int depth_completed = 0;
+
+    // MultiPV: the best max_lines root moves get exact scores. Every other root move only
+    // has to be shown not to beat the worst of them, so the root window opens at that score
+    // once max_lines moves have been searched (at the best score for a single PV).
+    int max_lines = limits->multipv > 1 ? limits->multipv : 1;
+    if (max_lines > AI_MAX_MULTIPV) max_lines = AI_MAX_MULTIPV;
+    if (max_lines > num_legal_root_moves) max_lines = num_legal_root_moves;
+    AIPrincipalVariation lines[AI_MAX_MULTIPV];         // Iteration in progress
+    AIPrincipalVariation completed_lines[AI_MAX_MULTIPV]; // Last completed iteration
+    int num_lines = 0, num_completed_lines = 0;
+
+    engine->limits = *limits;
+    int max_depth = (limits->depth_limit > 0 && limits->depth_limit < MAX_SEARCH_PLY) ? limits->depth_limit : MAX_SEARCH_PLY;
+    engine->start_time = ai_get_ticks_ms();
+    memset(iteration_stats, 0, sizeof(*iteration_stats));
+    memset(search_stats, 0, sizeof(*search_stats));
+    tt_new_search(&engine->tt);
+    engine->previous_pv.length = 0;
+    engine->follow_pv = false;
+    unsigned int iteration_start_time = engine->start_time;
+    if (limits->verbose) printf("AI (%s) thinking...\n", ai_player_color == WHITE ? "W":"B");
+
+    TimeManager time_manager = {0}; // Only used when clock_managed
+    bool clock_managed = limits->clock.time_left_ms > 0;
+    engine->hard_time_limit_ms = limits->time_limit_ms;
+    if (clock_managed) {
+        tm_start(&time_manager, &limits->clock);
+        engine->hard_time_limit_ms = time_manager.maximum_ms;
+        if (limits->verbose) printf("  Time: optimum %d ms, maximum %d ms\n", time_manager.optimum_ms, time_manager.maximum_ms);
+    }
+    engine->can_stop = false;
+    engine->stopped = false;
+    if (nnue_active(engine)) nnue_refresh(&engine->nnue_stack[0], pos);
 
-    Uint32 search_start_time = SDL_GetTicks();
-    printf("AI (%s) thinking...\n", ai_player_color == WHITE ? "W":"B");
+    for (int current_depth = 1; current_depth <= max_depth; ++current_depth) {
+        add_iteration_to_totals(engine);
+        memset(iteration_stats, 0, sizeof(*iteration_stats));
+        iteration_stats->depth = current_depth;
+        iteration_start_time = ai_get_ticks_ms();
+        num_lines = 0;
 
-    for (int current_depth = 1; current_depth <= MAX_SEARCH_PLY; ++current_depth) {
-        nodes_searched = 0;
-        int current_iteration_best_score = INT_MIN;
-        AIMove current_iteration_best_move = legal_root_moves[0];
-        
-        order_moves(board, legal_root_moves, num_legal_root_moves, 0); // Order root moves based on previous iteration's scores
+        if (depth_completed == 0) order_moves(engine, pos, legal_root_moves, num_legal_root_moves, 0);
+        else order_root_moves_by_score(legal_root_moves, num_legal_root_moves);
+        engine->follow_pv = depth_completed > 0; // The best root move comes first and leads the previous PV
 
         for (int i = 0; i < num_legal_root_moves; ++i) {
-            Piece board_after_ai_move[8][8]; memcpy(board_after_ai_move, board, sizeof(Piece[8][8]));
-            TempMoveInfo root_move_info = make_temporary_move(board_after_ai_move, &legal_root_moves[i], ai_player_color);
+            Position after_ai_move; make_child(engine, &after_ai_move, pos, &legal_root_moves[i], 0);
 
-            int score = minimax_ids(board_after_ai_move, current_depth-1, INT_MIN, INT_MAX, false, ai_player_color, 1, search_start_time, time_limit_ms);
-            legal_root_moves[i].score = score; // Update score for this move
+            int root_alpha = (num_lines == max_lines) ? lines[max_lines - 1].score : INT_MIN;
+            int score = minimax_ids(engine, &after_ai_move, current_depth-1, root_alpha, INT_MAX, false, ai_player_color, 1, EVAL_UNKNOWN);
+            legal_root_moves[i].score = score; // Exact inside the window, an upper bound otherwise
 
-            undo_temporary_move(board_after_ai_move, &legal_root_moves[i], root_move_info);
+            if (score > root_alpha) insert_root_line(engine, lines, &num_lines, max_lines, &legal_root_moves[i], score);
 
-            if (score > current_iteration_best_score) {
-                current_iteration_best_score = score;
-                current_iteration_best_move = legal_root_moves[i];
+            if (engine->can_stop && (engine->stopped || search_limit_reached(engine))) {
+                goto end_ids_loop; // Unfinished iteration: keep the previous one's move
             }
+        }
 
-            if (SDL_GetTicks() - search_start_time > time_limit_ms && i > 0) {
-                goto end_ids_loop;
-            }
+        bool best_move_changed = depth_completed > 0 && !same_squares(&lines[0].moves[0], best_overall_move);
+        *best_overall_move = lines[0].moves[0];
+        best_overall_score = lines[0].score;
+        depth_completed = current_depth;
+        memcpy(completed_lines, lines, sizeof(lines[0]) * num_lines);
+        num_completed_lines = num_lines;
+        engine->previous_pv = lines[0];
+
+        iteration_stats->time_ms = ai_get_ticks_ms() - iteration_start_time;
+        iteration_stats->score = best_overall_score;
+        iteration_stats->best_move = *best_overall_move;
+        if (search_stats->num_depths > 0) {
+            const AIDepthStats* prev = &search_stats->depths[search_stats->num_depths - 1];
+            long prev_nodes = prev->nodes + prev->qnodes;
+            iteration_stats->branching_factor = prev_nodes ? (double)iteration_node_count(engine) / prev_nodes : 0.0;
         }
-        
-        *best_overall_move = current_iteration_best_move;
-        best_overall_score = current_iteration_best_score;
+        search_stats->depths[search_stats->num_depths++] = *iteration_stats;
+        if (engine->stats_output) write_depth_stats_json(engine->stats_output, iteration_stats, &lines[0]);
 
-        printf("  Depth %d complete. Best move: [%d,%d]->[%d,%d] Score: %d. Nodes: %d. Time: %.2fs\n",
-               current_depth, best_overall_move->from_r, best_overall_move->from_c,
-               best_overall_move->to_r, best_overall_move->to_c, best_overall_score,
-               nodes_searched, (float)(SDL_GetTicks() - search_start_time) / 1000.0f);
+        if (limits->verbose) {
+            char pv_text[MAX_PV_TEXT_LENGTH];
+            pv_to_coordinates(&lines[0], pv_text);
+            printf("  Depth %d complete. Best move: [%d,%d]->[%d,%d] Score: %d. Nodes: %ld (+%ld q). Time: %.2fs PV: %s\n",
+                   current_depth, best_overall_move->from_r, best_overall_move->from_c,
+                   best_overall_move->to_r, best_overall_move->to_c, best_overall_score,
+                   iteration_stats->nodes, iteration_stats->qnodes, (float)(ai_get_ticks_ms() - engine->start_time) / 1000.0f, pv_text);
+        }
+        if (limits->on_iteration) {
+            AIIterationInfo info = {current_depth, *best_overall_move, best_overall_score,
+                                    search_node_count(engine), ai_get_ticks_ms() - engine->start_time,
+                                    num_completed_lines, completed_lines};
+            limits->on_iteration(&info, limits->user_data);
+        }
 
-        if (best_overall_score >= (KING_VALUE - 100) || best_overall_score <= (-KING_VALUE + 100) ) {
-            printf("  Mate found or unavoidable.\n"); break; 
+        // Once the depth reaches the mate distance every shorter line has been searched, so
+        // the mate is the fastest (or the longest defence) and deeper iterations add nothing
+        int mate_distance = KING_VALUE - abs(best_overall_score);
+        if (abs(best_overall_score) >= MATE_THRESHOLD && current_depth >= mate_distance) {
+            if (limits->verbose) printf("  Mate in %d found or unavoidable.\n", (mate_distance + 1) / 2);
+            break;
         }
-        if (SDL_GetTicks() - search_start_time > time_limit_ms) {
-             printf("  Time limit reached.\n"); break; 
+        if (search_limit_reached(engine)) {
+            if (limits->verbose) printf("  Search limit reached.\n");
+            break;
+        }
+        engine->can_stop = true;
+
+        if (clock_managed) {
+            if (num_legal_root_moves == 1) break; // Forced move: don't spend clock on it
+            int second_best_score = INT_MIN;
+            bool skipped_best = false;
+            for (int i = 0; i < num_legal_root_moves; ++i) {
+                if (!skipped_best && legal_root_moves[i].score == best_overall_score) { skipped_best = true; continue; }
+                if (legal_root_moves[i].score > second_best_score) second_best_score = legal_root_moves[i].score;
+            }
+            int best_margin = (second_best_score == INT_MIN) ? 0 : best_overall_score - second_best_score;
+            unsigned int elapsed_ms = ai_get_ticks_ms() - engine->start_time;
+            if (tm_iteration_done(&time_manager, elapsed_ms, iteration_stats->time_ms, best_move_changed, best_overall_score, best_margin)) {
+                if (limits->verbose) printf("  Time manager stops after %u ms.\n", elapsed_ms);
+                break;
+            }
         }
     }
 
 end_ids_loop:;
-    printf("AI chose final move: [%d,%d] to [%d,%d]", best_overall_move->from_r, best_overall_move->from_c, best_overall_move->to_r, best_overall_move->to_c);
-    if(best_overall_move->promotion_to != EMPTY) printf(" (promo Q)");
-    printf(" with final eval score: %d\n", best_overall_score);
+    add_iteration_to_totals(engine); // The last iteration counts even if it was cut short
+    profile_flush_thread();
+    search_stats->time_ms = ai_get_ticks_ms() - engine->start_time;
+    if (engine->stats_output) write_search_stats_json(engine->stats_output, search_stats);
+
+    if (result) {
+        result->depth_completed = depth_completed;
+        result->score = best_overall_score;
+        result->nodes = search_stats->nodes + search_stats->qnodes;
+        result->time_ms = search_stats->time_ms;
+        result->num_lines = num_completed_lines;
+        memcpy(result->lines, completed_lines, sizeof(completed_lines[0]) * num_completed_lines);
+    }
+    if (limits->verbose) {
+        printf("AI chose final move: [%d,%d] to [%d,%d]", best_overall_move->from_r, best_overall_move->from_c, best_overall_move->to_r, best_overall_move->to_c);
+        if(best_overall_move->promotion_to != EMPTY) printf(" (promo Q)");
+        printf(" with final eval score: %d\n", best_overall_score);
+    }
     return true;
-}
\ No newline at end of file
+}
@@ -1,8 +1,16 @@
 #ifndef AI_H
 #define AI_H
 
+#include <stdio.h>
 #include "board.h"
 #include "rules.h"
+#include "timeman.h"
+#include "tt.h"
+#include "nnue.h"
+
+#define AI_MAX_DEPTH 30 // Deepest iterative-deepening iteration (and ply table size)
+#define AI_MAX_PLY 128  // Deepest ply from the root, quiescence search included
+#define AI_MAX_MULTIPV 16 // Most root lines one search can score exactly
 
 typedef struct {
     int from_r, from_c;
@@ -11,8 +19,132 @@ typedef struct {
     int score;
 } AIMove;
 
+// A principal variation: the expected line of play from the root, starting with the root move.
+typedef struct {
+    int score; // For the side to move at the root
+    int length;
+    AIMove moves[AI_MAX_DEPTH];
+} AIPrincipalVariation;
+
+// Summary of one completed iterative-deepening iteration, passed to AISearchLimits.on_iteration.
+typedef struct {
+    int depth;
+    AIMove best_move;
+    int score;
+    long nodes;           // Nodes searched so far in the whole search
+    unsigned int time_ms; // Time elapsed since the search started
+    int num_lines;        // The best num_lines root moves, best first (see AISearchLimits.multipv)
+    const AIPrincipalVariation* lines;
+} AIIterationInfo;
+
+// Bounds for one ai_search call. A zero field means "no limit" (depth falls back to the engine maximum).
+typedef struct {
+    int time_limit_ms;
+    long node_limit;
+    int depth_limit;
+    TimeControl clock; // Game clock; clock.time_left_ms > 0 lets the time manager set the time limit
+    int multipv;  // Root moves to score exactly, with their PVs (0 or 1: just the best one)
+    bool verbose; // Print per-depth progress to stdout like the GUI does
+    void (*on_iteration)(const AIIterationInfo* info, void* user_data);
+    void* user_data;
+} AISearchLimits;
+
+// Counters for one iterative-deepening iteration.
+typedef struct {
+    int depth;
+    long nodes;              // Main-search (minimax) nodes
+    long qnodes;             // Quiescence nodes
+    long eval_calls;         // Static evaluations (quiescence stand-pats and ai_evaluate_board calls)
+    long beta_cutoffs;       // Main-search fail-highs
+    long first_move_cutoffs; // ...of which on the first move searched (move ordering quality)
+    long tb_hits;            // Nodes resolved by a tablebase probe
+    long tt_hits;            // Nodes cut off by a transposition table entry
+    double branching_factor; // (nodes + qnodes) relative to the previous iteration; 0 for depth 1
+    unsigned int time_ms;    // Time spent in this iteration alone
+    int score;
+    AIMove best_move;
+} AIDepthStats;
+
+// Per-search statistics; one AIDepthStats per completed iteration plus totals over the
+// whole search (including a final, possibly unfinished, iteration).
+typedef struct {
+    int num_depths;
+    AIDepthStats depths[AI_MAX_DEPTH];
+    long nodes;
+    long qnodes;
+    long eval_calls;
+    long beta_cutoffs;
+    long first_move_cutoffs;
+    long tb_hits;
+    long tt_hits;
+    unsigned int time_ms;
+} AISearchStats;
+
+// Totals for the last ai_search call, with the lines of the last completed iteration.
+typedef struct {
+    int depth_completed;
+    int score;
+    long nodes;
+    unsigned int time_ms;
+    int num_lines;
+    AIPrincipalVariation lines[AI_MAX_MULTIPV];
+} AISearchResult;
+
+// Search state of one engine instance: transposition table, killer moves, the PV table, the
+// limits of the running search and its statistics. Engines are independent of each other and of any game, so a process can
+// run as many as it hosts games; they share nothing but the read-only evaluation tables,
+// the opening book and the tablebases.
+typedef struct {
+    TranspositionTable tt;
+    AIMove killer_moves[AI_MAX_DEPTH][2]; // [ply][killer_slot]
+    NNUEAccumulator* nnue_stack; // [AI_MAX_PLY + 1], accumulator of the node at each ply; used while a network is loaded
+    // Triangular PV table: pv[ply][ply..pv_length[ply]-1] is the best line found below the
+    // node being searched at ply
+    AIMove pv[AI_MAX_DEPTH + 1][AI_MAX_DEPTH + 1];
+    int pv_length[AI_MAX_DEPTH + 1];
+    AIPrincipalVariation previous_pv; // Best line of the last completed iteration, searched first
+    bool follow_pv;                   // Still on previous_pv in the iteration in progress
+    AIDepthStats iteration_stats; // Iteration in progress
+    AISearchStats search_stats;   // Completed iterations and totals of the last search
+    FILE* stats_output;
+    AISearchLimits limits;        // Valid for the duration of one ai_search call
+    unsigned int start_time;
+    int hard_time_limit_ms;       // time_limit_ms, or the time manager's maximum; 0 = none
+    bool can_stop;                // Set once the first iteration has completed
+    bool stopped;                 // A limit was hit: every node returns at once
+} AIEngine;
+
 void ai_init_random();
-int ai_evaluate_board(const Piece board[8][8], PieceColor player_to_evaluate_for);
-bool ai_select_move(const Piece board[8][8], PieceColor ai_player_color, AIMove* chosen_move, int time_limit_ms); // Added time limit
+// Prepares a new engine (empty search state, a hash_mb megabyte transposition table, normally
+// TT_DEFAULT_SIZE_MB, and NNUE accumulators, no statistics output).
+void ai_engine_init(AIEngine* engine, size_t hash_mb);
+void ai_engine_free(AIEngine* engine);
+// Replaces the transposition table with an empty one of hash_mb megabytes (0 for none). Returns
+// false when it cannot be allocated; the engine then searches without a table.
+bool ai_engine_set_hash(AIEngine* engine, size_t hash_mb);
+// Clears everything the engine remembers between searches (transposition table, killer
+// moves, counters) without touching the random seed, so a search from a given position is
+// reproducible.
+void ai_reset_search_state(AIEngine* engine);
+// Monotonic milliseconds, independent of any SDL initialisation.
+unsigned int ai_get_ticks_ms(void);
+// Moves to mate for a search score (negative when the side to move gets mated), or 0 when
+// the score is not a mate.
+int ai_score_to_mate(int score);
+int ai_evaluate_board(AIEngine* engine, const Position* pos, PieceColor player_to_evaluate_for);
+// Picks a move for the side to move in pos. Plays from the opening book (book.h) when one
+// is open and knows the position, otherwise searches.
+bool ai_select_move(AIEngine* engine, const Position* pos, AIMove* chosen_move, int time_limit_ms);
+// ai_select_move for a game played on a clock (see timeman.h).
+bool ai_select_move_clocked(AIEngine* engine, const Position* pos, AIMove* chosen_move, const TimeControl* clock);
+// Like ai_select_move but with explicit limits; result may be NULL. When tablebases are
+// enabled (tablebase.h) and cover the position, the move is taken from them without searching.
+bool ai_search(AIEngine* engine, const Position* pos, const AISearchLimits* limits, AIMove* chosen_move, AISearchResult* result);
+
+// Statistics of the engine's most recent (or currently running) search.
+const AISearchStats* ai_get_search_stats(const AIEngine* engine);
+// When out is non-NULL, every search of engine writes one JSON object per completed
+// iteration ("type":"depth") and one for the whole search ("type":"search") to out, one per line.
+void ai_set_stats_output(AIEngine* engine, FILE* out);
 
-#endif // AI_H
\ No newline at end of file
+#endif // AI_H
@@ -0,0 +1,588 @@
+// Headless analysis server.
+// Reads JSON-lines requests from stdin, or from any number of clients on a Unix socket,
+// and searches them on a fixed pool of worker threads, so one process serves many games
+// and analysis sessions at once:
+//   {"id":"g17","cmd":"bestmove","fen":"<fen>","wtime":60000,"btime":58000,"winc":1000,"binc":1000}
+//   {"id":"a3","cmd":"analyse","fen":"<fen>","depth":10,"multipv":3}
+// Answers go back to the client that sent the request, in the order searches finish, and
+// carry its "id": "analyse" streams one "info" line per completed depth before its
+// "result", "bestmove" only sends the result (from the opening book when one is open and
+// knows the position). Each worker keeps its transposition table from one request to the
+// next, so follow-up positions of a game start warm; entries from earlier searches age out
+// as new ones are stored, so {"cmd":"newgame"} needs to clear nothing. The admin command
+// {"cmd":"clear"} empties every worker's table before its next search. The evaluation
+// tables, the opening book and the tablebases are shared read-only.
+#define _POSIX_C_SOURCE 200809L // For sigaction(), sysconf() and the socket calls
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "board.h"
+#include "rules.h"
+#include "ai.h"
+#include "book.h"
+#include "notation.h"
+#include "tablebase.h"
+#include "nnue.h"
+#include "tablemem.h"
+
+#define MAX_CLIENTS 256
+#define MAX_REQUEST_LINE 4096
+#define MAX_ID_LENGTH 64
+#define MAX_RESPONSE_LINE 8192    // A result with AI_MAX_MULTIPV full-length PVs fits
+#define MAX_QUEUED_REQUESTS 100000 // Beyond this, requests are refused with "queue full"
+#define DEFAULT_MOVETIME_MS 1000   // For requests without any limit
+#define MOVE_OVERHEAD_MS 10
+
+// A connection (or stdin/stdout). Freed once it has stopped sending and its last request
+// has been answered.
+typedef struct {
+    int in_fd, out_fd;
+    char buffer[MAX_REQUEST_LINE];
+    size_t buffered;
+    bool discarding;       // Skipping the rest of an overlong line
+    pthread_mutex_t write_lock; // One response line is written at a time
+    // Protected by queue_lock:
+    int references;        // 1 while reading, plus one per queued or running request
+    bool gone;             // A write failed: drop its remaining requests
+} Client;
+
+typedef struct Request {
+    struct Request* next;
+    Client* client;
+    char id[MAX_ID_LENGTH];
+    bool analyse;          // Stream per-depth info; never play from the book
+    Position pos;
+    AISearchLimits limits;
+    unsigned clears_before; // "clear" commands read before this request was queued
+} Request;
+
+// --- Request Queue ---
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static Request* queue_head = NULL;
+static Request* queue_tail = NULL;
+static int num_queued = 0;
+static int num_running = 0;
+static unsigned clear_count = 0; // "clear" commands so far
+static bool draining = false;   // No more requests: workers exit once the queue is empty
+static bool abandoning = false; // Shutting down: workers exit after their current search
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void release_client_locked(Client* client) {
+    if (--client->references > 0) return;
+    if (client->out_fd != STDOUT_FILENO) close(client->out_fd);
+    pthread_mutex_destroy(&client->write_lock);
+    free(client);
+}
+
+static void release_client(Client* client) {
+    pthread_mutex_lock(&queue_lock);
+    release_client_locked(client);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static bool enqueue_request(Request* request) {
+    pthread_mutex_lock(&queue_lock);
+    if (num_queued >= MAX_QUEUED_REQUESTS) {
+        pthread_mutex_unlock(&queue_lock);
+        return false;
+    }
+    request->next = NULL;
+    if (queue_tail) queue_tail->next = request;
+    else queue_head = request;
+    queue_tail = request;
+    request->clears_before = clear_count;
+    num_queued++;
+    request->client->references++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    return true;
+}
+
+// Blocks until there is work; returns NULL when the worker should exit. Requests of
+// clients that went away are dropped here rather than searched.
+static Request* dequeue_request(void) {
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        while (queue_head == NULL && !draining && !abandoning) pthread_cond_wait(&queue_ready, &queue_lock);
+        if (abandoning || queue_head == NULL) {
+            pthread_mutex_unlock(&queue_lock);
+            return NULL;
+        }
+        Request* request = queue_head;
+        queue_head = request->next;
+        if (queue_head == NULL) queue_tail = NULL;
+        num_queued--;
+        if (request->client->gone) {
+            release_client_locked(request->client);
+            free(request);
+            continue;
+        }
+        num_running++;
+        pthread_mutex_unlock(&queue_lock);
+        return request;
+    }
+}
+
+static void finish_request(Request* request) {
+    pthread_mutex_lock(&queue_lock);
+    num_running--;
+    release_client_locked(request->client);
+    pthread_mutex_unlock(&queue_lock);
+    free(request);
+}
+
+// --- Responses ---
+
+static void send_line(Client* client, const char* line) {
+    pthread_mutex_lock(&client->write_lock);
+    size_t length = strlen(line), written = 0;
+    bool failed = false;
+    while (written < length && !failed) {
+        ssize_t n = write(client->out_fd, line + written, length - written);
+        if (n > 0) written += (size_t)n;
+        else if (n < 0 && errno == EINTR) continue;
+        else failed = true;
+    }
+    pthread_mutex_unlock(&client->write_lock);
+    if (failed) {
+        pthread_mutex_lock(&queue_lock);
+        client->gone = true;
+        pthread_mutex_unlock(&queue_lock);
+    }
+}
+
+// Copies s into out as the body of a JSON string (quotes and backslashes escaped,
+// control characters dropped).
+static void json_escape(const char* s, char* out, size_t out_size) {
+    size_t n = 0;
+    for (; *s && n + 2 < out_size; ++s) {
+        if (*s == '"' || *s == '\\') out[n++] = '\\';
+        if ((unsigned char)*s >= 0x20) out[n++] = *s;
+    }
+    out[n] = '\0';
+}
+
+static void send_ack(Client* client, const char* id, const char* type) {
+    char escaped_id[2 * MAX_ID_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(id, escaped_id, sizeof(escaped_id));
+    snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"%s\"}\n", escaped_id, type);
+    send_line(client, line);
+}
+
+static void send_error(Client* client, const char* id, const char* message) {
+    char escaped_id[2 * MAX_ID_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(id, escaped_id, sizeof(escaped_id));
+    snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"error\",\"message\":\"%s\"}\n", escaped_id, message);
+    send_line(client, line);
+}
+
+// "score":<centipawns>, plus "mate":<moves> (negative when getting mated) for a mate score.
+static void format_score(int score, char* out, size_t out_size) {
+    int mate = ai_score_to_mate(score);
+    if (mate != 0) snprintf(out, out_size, "\"score\":%d,\"mate\":%d", score, mate);
+    else snprintf(out, out_size, "\"score\":%d", score);
+}
+
+// One info line per MultiPV line and completed depth.
+static void on_iteration(const AIIterationInfo* info, void* user_data) {
+    const Request* request = user_data;
+    char escaped_id[2 * MAX_ID_LENGTH], score[48], pv[MAX_PV_TEXT_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(request->id, escaped_id, sizeof(escaped_id));
+    for (int i = 0; i < info->num_lines; ++i) {
+        format_score(info->lines[i].score, score, sizeof(score));
+        pv_to_coordinates(&info->lines[i], pv);
+        snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"info\",\"depth\":%d,\"multipv\":%d,%s,\"nodes\":%ld,\"time_ms\":%u,\"pv\":\"%s\"}\n",
+                 escaped_id, info->depth, i + 1, score, info->nodes, info->time_ms, pv);
+        send_line(request->client, line);
+    }
+}
+
+// Final answer: the best move and every MultiPV line of the last completed depth.
+static void send_result(const Request* request, const AISearchResult* result, bool from_book) {
+    char escaped_id[2 * MAX_ID_LENGTH], move[8], san[MAX_SAN_LENGTH], score[48], pv[MAX_PV_TEXT_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(request->id, escaped_id, sizeof(escaped_id));
+    const AIMove* best_move = &result->lines[0].moves[0];
+    move_to_coordinate(best_move, move);
+    move_to_san(&request->pos, best_move, san, sizeof(san));
+    format_score(result->score, score, sizeof(score));
+    int n = snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"result\",\"bestmove\":\"%s\",\"san\":\"%s\",%s,\"depth\":%d,\"nodes\":%ld,\"time_ms\":%u,\"book\":%s,\"lines\":[",
+                     escaped_id, move, san, score, result->depth_completed, result->nodes, result->time_ms, from_book ? "true" : "false");
+    for (int i = 0; i < result->num_lines; ++i) {
+        format_score(result->lines[i].score, score, sizeof(score));
+        pv_to_coordinates(&result->lines[i], pv);
+        n += snprintf(line + n, sizeof(line) - n, "%s{\"multipv\":%d,%s,\"pv\":\"%s\"}", i ? "," : "", i + 1, score, pv);
+    }
+    snprintf(line + n, sizeof(line) - n, "]}\n");
+    send_line(request->client, line);
+}
+
+// Result for a position without legal moves.
+static void send_game_over(const Request* request) {
+    char escaped_id[2 * MAX_ID_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(request->id, escaped_id, sizeof(escaped_id));
+    bool mated = is_king_in_check(request->pos.board, request->pos.turn);
+    snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"result\",\"bestmove\":null,\"reason\":\"%s\"}\n",
+             escaped_id, mated ? "checkmate" : "stalemate");
+    send_line(request->client, line);
+}
+
+// --- Workers ---
+
+// The book move must be legal, which guards against key collisions.
+static bool pick_book_move(const Position* pos, AIMove* move) {
+    BookMove book_move;
+    if (!book_is_open() || !book_pick_move(pos, &book_move)) return false;
+    if (!is_move_legal(pos, book_move.from_r, book_move.from_c, book_move.to_r, book_move.to_c, pos->turn)) return false;
+    *move = (AIMove){book_move.from_r, book_move.from_c, book_move.to_r, book_move.to_c, EMPTY, 0};
+    if (pos->board[book_move.from_r][book_move.from_c].type == PAWN && (book_move.to_r == 0 || book_move.to_r == 7)) {
+        move->promotion_to = book_move.promotion_to != EMPTY ? book_move.promotion_to : QUEEN;
+    }
+    return true;
+}
+
+static void run_request(AIEngine* engine, Request* request) {
+    AISearchResult result = {0};
+    AIMove best_move;
+    if (!request->analyse && pick_book_move(&request->pos, &best_move)) {
+        result.num_lines = 1;
+        result.lines[0] = (AIPrincipalVariation){0, 1, {best_move}};
+        send_result(request, &result, true);
+        return;
+    }
+
+    if (request->analyse) {
+        request->limits.on_iteration = on_iteration;
+        request->limits.user_data = request;
+    }
+    if (!ai_search(engine, &request->pos, &request->limits, &best_move, &result)) {
+        send_game_over(request);
+        return;
+    }
+    send_result(request, &result, false);
+}
+
+static void* worker_main(void* arg) {
+    AIEngine engine;
+    ai_engine_init(&engine, *(const size_t*)arg);
+    unsigned clears_seen = 0;
+    Request* request;
+    while ((request = dequeue_request()) != NULL) {
+        if (request->clears_before > clears_seen) { // A "clear" came in since this table was last cleared
+            ai_reset_search_state(&engine);
+            clears_seen = request->clears_before;
+        }
+        run_request(&engine, request);
+        finish_request(request);
+    }
+    ai_engine_free(&engine);
+    return NULL;
+}
+
+// --- Request Parsing ---
+// Requests are flat JSON objects; values are strings or integers.
+
+// Returns the start of the value of "key", or NULL.
+static const char* json_value(const char* line, const char* key) {
+    size_t key_length = strlen(key);
+    for (const char* p = strchr(line, '"'); p != NULL; p = strchr(p + 1, '"')) {
+        if (strncmp(p + 1, key, key_length) != 0 || p[key_length + 1] != '"') continue;
+        const char* v = p + key_length + 2;
+        while (*v == ' ' || *v == '\t') v++;
+        if (*v != ':') continue;
+        v++;
+        while (*v == ' ' || *v == '\t') v++;
+        return v;
+    }
+    return NULL;
+}
+
+static bool json_string(const char* line, const char* key, char* out, size_t out_size) {
+    const char* v = json_value(line, key);
+    if (v == NULL || *v != '"') return false;
+    size_t n = 0;
+    for (++v; *v && *v != '"'; ++v) {
+        if (*v == '\\' && v[1]) v++;
+        if (n + 1 < out_size) out[n++] = *v;
+    }
+    out[n] = '\0';
+    return *v == '"';
+}
+
+static bool json_long(const char* line, const char* key, long* out) {
+    const char* v = json_value(line, key);
+    if (v == NULL) return false;
+    char* end;
+    long value = strtol(v, &end, 10);
+    if (end == v) return false;
+    *out = value;
+    return true;
+}
+
+static int json_int(const char* line, const char* key, int fallback) {
+    long value;
+    if (!json_long(line, key, &value) || value < 0 || value > 1000000000L) return fallback;
+    return (int)value;
+}
+
+static void send_status(Client* client, const char* id, int num_workers) {
+    char escaped_id[2 * MAX_ID_LENGTH], line[MAX_RESPONSE_LINE];
+    json_escape(id, escaped_id, sizeof(escaped_id));
+    pthread_mutex_lock(&queue_lock);
+    int queued = num_queued, running = num_running;
+    pthread_mutex_unlock(&queue_lock);
+    TableMemUsage memory;
+    tablemem_usage(&memory);
+    snprintf(line, sizeof(line), "{\"id\":\"%s\",\"type\":\"status\",\"queued\":%d,\"running\":%d,\"workers\":%d,"
+             "\"table_mb\":%.1f,\"resident_mb\":%.1f,\"huge_page_mb\":%.1f}\n",
+             escaped_id, queued, running, num_workers, memory.reserved_bytes / (1024.0 * 1024.0),
+             memory.resident_bytes / (1024.0 * 1024.0), memory.huge_page_bytes / (1024.0 * 1024.0));
+    send_line(client, line);
+}
+
+static void handle_request_line(Client* client, const char* line, int num_workers) {
+    static Game game; // Only the reading thread parses FENs
+    char id[MAX_ID_LENGTH] = "", command[16] = "", fen[MAX_REQUEST_LINE];
+    long numeric_id;
+    if (!json_string(line, "id", id, sizeof(id)) && json_long(line, "id", &numeric_id)) {
+        snprintf(id, sizeof(id), "%ld", numeric_id);
+    }
+    if (!json_string(line, "cmd", command, sizeof(command))) {
+        send_error(client, id, "missing cmd");
+        return;
+    }
+    if (strcmp(command, "status") == 0) {
+        send_status(client, id, num_workers);
+        return;
+    }
+    if (strcmp(command, "newgame") == 0) { // Other games share the tables: nothing to clear
+        send_ack(client, id, "newgame");
+        return;
+    }
+    if (strcmp(command, "clear") == 0) { // Admin: every game's searches start cold again
+        pthread_mutex_lock(&queue_lock);
+        clear_count++;
+        pthread_mutex_unlock(&queue_lock);
+        send_ack(client, id, "cleared");
+        return;
+    }
+    bool analyse = strcmp(command, "analyse") == 0 || strcmp(command, "analyze") == 0;
+    if (!analyse && strcmp(command, "bestmove") != 0) {
+        send_error(client, id, "unknown cmd");
+        return;
+    }
+    if (!json_string(line, "fen", fen, sizeof(fen)) || !load_fen(&game, fen)) {
+        send_error(client, id, "invalid fen");
+        return;
+    }
+
+    Request* request = calloc(1, sizeof(*request));
+    if (request == NULL) {
+        send_error(client, id, "out of memory");
+        return;
+    }
+    request->client = client;
+    memcpy(request->id, id, sizeof(request->id));
+    request->analyse = analyse;
+    request->pos = game.pos;
+
+    AISearchLimits* limits = &request->limits;
+    limits->multipv = json_int(line, "multipv", 1); // Capped at AI_MAX_MULTIPV by the search
+    limits->depth_limit = json_int(line, "depth", 0);
+    limits->node_limit = json_int(line, "nodes", 0);
+    limits->time_limit_ms = json_int(line, "movetime", 0);
+    bool white = game.pos.turn == WHITE;
+    limits->clock.time_left_ms = json_int(line, white ? "wtime" : "btime", 0);
+    limits->clock.increment_ms = json_int(line, white ? "winc" : "binc", 0);
+    limits->clock.moves_to_go = json_int(line, "movestogo", 0);
+    limits->clock.move_overhead_ms = MOVE_OVERHEAD_MS;
+    if (limits->depth_limit == 0 && limits->node_limit == 0 && limits->time_limit_ms == 0 && limits->clock.time_left_ms == 0) {
+        limits->time_limit_ms = DEFAULT_MOVETIME_MS;
+    }
+
+    if (!enqueue_request(request)) {
+        free(request);
+        send_error(client, id, "queue full");
+    }
+}
+
+// --- Connections ---
+
+static Client* client_create(int in_fd, int out_fd) {
+    Client* client = calloc(1, sizeof(*client));
+    if (client == NULL) return NULL;
+    client->in_fd = in_fd;
+    client->out_fd = out_fd;
+    client->references = 1;
+    pthread_mutex_init(&client->write_lock, NULL);
+    return client;
+}
+
+// Reads what is available and handles every complete line. Returns false at end of input.
+static bool client_read(Client* client, int num_workers) {
+    ssize_t n = read(client->in_fd, client->buffer + client->buffered, sizeof(client->buffer) - 1 - client->buffered);
+    if (n < 0 && errno == EINTR) return true;
+    if (n <= 0) return false;
+    client->buffered += (size_t)n;
+    client->buffer[client->buffered] = '\0';
+
+    char* start = client->buffer;
+    char* newline;
+    while ((newline = strchr(start, '\n')) != NULL) {
+        *newline = '\0';
+        if (!client->discarding && strspn(start, " \t\r") != strlen(start)) handle_request_line(client, start, num_workers);
+        client->discarding = false;
+        start = newline + 1;
+    }
+    client->buffered -= (size_t)(start - client->buffer);
+    memmove(client->buffer, start, client->buffered);
+    if (client->buffered == sizeof(client->buffer) - 1) {
+        if (!client->discarding) send_error(client, "", "request line too long");
+        client->discarding = true;
+        client->buffered = 0;
+    }
+    return true;
+}
+
+static int open_socket(const char* path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path); // A stale socket from an earlier run
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void handle_stop_signal(int signal_number) {
+    stop_requested = 1;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-j threads] [-H MB] [-s socket_path] [-b book.bin] [-T tb_dir] [-N net]\n", program);
+    fprintf(stderr, "Reads JSON-lines requests from stdin, or from clients of socket_path with -s.\n");
+    fprintf(stderr, "-H MB caps the transposition tables of all threads together (default %d MB each).\n", TT_DEFAULT_SIZE_MB);
+}
+
+int main(int argc, char* argv[]) {
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char* socket_path = NULL;
+    const char* book_path = NULL;
+    long hash_mb = 0; // Total over the workers; default TT_DEFAULT_SIZE_MB each
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) num_workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) hash_mb = atol(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) socket_path = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) book_path = argv[++i];
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) tb_init(argv[++i]);
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) { if (!nnue_load(argv[++i])) return 1; }
+        else { print_usage(argv[0]); return 1; }
+    }
+    if (num_workers < 1) num_workers = 1;
+    if (hash_mb < 0) { print_usage(argv[0]); return 1; }
+    size_t worker_hash_mb = TT_DEFAULT_SIZE_MB;
+    if (hash_mb > 0) {
+        tablemem_set_budget_mb((size_t)hash_mb);
+        worker_hash_mb = (size_t)hash_mb / (size_t)num_workers;
+        while (worker_hash_mb & (worker_hash_mb - 1)) worker_hash_mb &= worker_hash_mb - 1; // What tt_init would round it to
+    }
+    ai_init_random(); // Book move choice
+    if (book_path != NULL && !book_open(book_path)) return 1;
+
+    int listen_fd = -1;
+    if (socket_path != NULL && (listen_fd = open_socket(socket_path)) < 0) return 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL); // A vanished client shows up as a failed write
+    action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pthread_t* workers = malloc(sizeof(pthread_t) * (size_t)num_workers);
+    if (workers == NULL) return 1;
+    for (int i = 0; i < num_workers; ++i) {
+        if (pthread_create(&workers[i], NULL, worker_main, &worker_hash_mb) != 0) {
+            fprintf(stderr, "Could not start worker thread %d\n", i);
+            return 1;
+        }
+    }
+    fprintf(stderr, "Analysis server: %d worker(s), %zu MB hash each, requests on %s\n", num_workers, worker_hash_mb,
+            socket_path ? socket_path : "stdin");
+
+    // The main thread only reads and parses requests; results are written by the workers
+    Client* clients[MAX_CLIENTS];
+    int num_clients = 0;
+    if (listen_fd < 0) {
+        clients[num_clients++] = client_create(STDIN_FILENO, STDOUT_FILENO);
+        if (clients[0] == NULL) return 1;
+    }
+    while (!stop_requested && (listen_fd >= 0 || num_clients > 0)) {
+        struct pollfd fds[MAX_CLIENTS + 1];
+        for (int i = 0; i < num_clients; ++i) fds[i] = (struct pollfd){clients[i]->in_fd, POLLIN, 0};
+        int num_fds = num_clients;
+        int listen_index = -1; // Not polled while the client table is full
+        if (listen_fd >= 0 && num_clients < MAX_CLIENTS) {
+            listen_index = num_fds;
+            fds[num_fds++] = (struct pollfd){listen_fd, POLLIN, 0};
+        }
+        if (poll(fds, (nfds_t)num_fds, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        for (int i = num_clients - 1; i >= 0; --i) {
+            if (fds[i].revents == 0 || client_read(clients[i], num_workers)) continue;
+            // End of input: answers to its queued requests are still delivered
+            if (clients[i]->in_fd != STDIN_FILENO) shutdown(clients[i]->in_fd, SHUT_RD);
+            release_client(clients[i]);
+            clients[i] = clients[--num_clients];
+        }
+        if (listen_index >= 0 && (fds[listen_index].revents & POLLIN)) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                Client* client = client_create(fd, fd);
+                if (client != NULL) clients[num_clients++] = client;
+                else close(fd);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    if (stop_requested) abandoning = true; // Running searches still finish within their limits
+    draining = true;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    for (int i = 0; i < num_workers; ++i) pthread_join(workers[i], NULL);
+    free(workers);
+
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    book_close();
+    tb_free();
+    return 0;
+}
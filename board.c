@@ -1,18 +1,23 @@
 #include "board.h"
 #include <stddef.h>
 #include "rules.h" 
-#include <stdio.h> // For debug prints
+#include <stdio.h> // For snprintf, and the record-full warning on stderr
+#include <stdlib.h> // For abs
 #include <string.h> // For memcpy for potential future board state saving
 
-Piece game_board[8][8];
-PieceColor current_player_turn;
-int en_passant_target_r = -1;
-int en_passant_target_c = -1;
-int halfmove_clock = 0;
-
-// --- NEW: Move History Definition ---
-Move move_history[MAX_MOVES_IN_GAME];
-int current_move_number = 0; // Number of moves made, index for next move
+// Moving a king off e1/e8 or a rook off (or anything onto) a corner drops the matching rights.
+const int castling_rights_mask[8][8] = {
+    {CASTLE_ALL & ~CASTLE_BLACK_QUEENSIDE, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL,
+     CASTLE_ALL & ~(CASTLE_BLACK_KINGSIDE | CASTLE_BLACK_QUEENSIDE), CASTLE_ALL, CASTLE_ALL, CASTLE_ALL & ~CASTLE_BLACK_KINGSIDE},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL},
+    {CASTLE_ALL & ~CASTLE_WHITE_QUEENSIDE, CASTLE_ALL, CASTLE_ALL, CASTLE_ALL,
+     CASTLE_ALL & ~(CASTLE_WHITE_KINGSIDE | CASTLE_WHITE_QUEENSIDE), CASTLE_ALL, CASTLE_ALL, CASTLE_ALL & ~CASTLE_WHITE_KINGSIDE}
+};
 
 // (get_piece_type_string, get_piece_color_string remain same)
 const char* get_piece_type_string(PieceType type) {
@@ -28,141 +33,449 @@ const char* get_piece_color_string(PieceColor color) {
     }
 }
 
-void init_board() {
+// Empties the record, making start the position it starts from.
+static void start_record(Game* game, const Position* start, int fullmove_number) {
+    game->start = *start;
+    game->record.length = 0;
+    game->record.num_snapshots = 0;
+    game->move_count = 0;
+    game->start_fullmove_number = fullmove_number;
+    game->start_turn = start->turn;
+}
+
+// FEN fullmove number of the current position: moves made since the start position,
+// shifted by one ply if that position had Black to move.
+static int fullmove_number(const Game* game) {
+    int plies = game->move_count + (game->start_turn == BLACK ? 1 : 0);
+    return game->start_fullmove_number + plies / 2;
+}
+
+void init_board(Game* game) {
+    Position* pos = &game->pos;
     for (int r = 0; r < 8; ++r) {
         for (int c = 0; c < 8; ++c) {
-            game_board[r][c] = (Piece){EMPTY, NO_COLOR, false};
+            pos->board[r][c] = (Piece){EMPTY, NO_COLOR};
         }
     }
-    // ... (Standard piece setup with has_moved = false) ...
     for (int c = 0; c < 8; ++c) {
-        game_board[1][c] = (Piece){PAWN, BLACK, false};
-        game_board[6][c] = (Piece){PAWN, WHITE, false};
+        pos->board[1][c] = (Piece){PAWN, BLACK};
+        pos->board[6][c] = (Piece){PAWN, WHITE};
     }
-    game_board[0][0] = (Piece){ROOK, BLACK, false}; game_board[0][7] = (Piece){ROOK, BLACK, false};
-    game_board[7][0] = (Piece){ROOK, WHITE, false}; game_board[7][7] = (Piece){ROOK, WHITE, false};
-    game_board[0][1] = (Piece){KNIGHT, BLACK, false}; game_board[0][6] = (Piece){KNIGHT, BLACK, false};
-    game_board[7][1] = (Piece){KNIGHT, WHITE, false}; game_board[7][6] = (Piece){KNIGHT, WHITE, false};
-    game_board[0][2] = (Piece){BISHOP, BLACK, false}; game_board[0][5] = (Piece){BISHOP, BLACK, false};
-    game_board[7][2] = (Piece){BISHOP, WHITE, false}; game_board[7][5] = (Piece){BISHOP, WHITE, false};
-    game_board[0][3] = (Piece){QUEEN, BLACK, false}; game_board[7][3] = (Piece){QUEEN, WHITE, false};
-    game_board[0][4] = (Piece){KING, BLACK, false}; game_board[7][4] = (Piece){KING, WHITE, false};
+    pos->board[0][0] = (Piece){ROOK, BLACK}; pos->board[0][7] = (Piece){ROOK, BLACK};
+    pos->board[7][0] = (Piece){ROOK, WHITE}; pos->board[7][7] = (Piece){ROOK, WHITE};
+    pos->board[0][1] = (Piece){KNIGHT, BLACK}; pos->board[0][6] = (Piece){KNIGHT, BLACK};
+    pos->board[7][1] = (Piece){KNIGHT, WHITE}; pos->board[7][6] = (Piece){KNIGHT, WHITE};
+    pos->board[0][2] = (Piece){BISHOP, BLACK}; pos->board[0][5] = (Piece){BISHOP, BLACK};
+    pos->board[7][2] = (Piece){BISHOP, WHITE}; pos->board[7][5] = (Piece){BISHOP, WHITE};
+    pos->board[0][3] = (Piece){QUEEN, BLACK}; pos->board[7][3] = (Piece){QUEEN, WHITE};
+    pos->board[0][4] = (Piece){KING, BLACK}; pos->board[7][4] = (Piece){KING, WHITE};
+
+    pos->turn = WHITE;
+    clear_en_passant_target(pos);
+    pos->halfmove_clock = 0;
+    pos->castling_rights = CASTLE_ALL;
+    start_record(game, pos, 1); // Reset move history
+}
 
-    current_player_turn = WHITE;
-    clear_en_passant_target();
-    halfmove_clock = 0;
-    current_move_number = 0; // Reset move history
+void game_free(Game* game) {
+    free(game->record.entries);
+    free(game->record.snapshots);
+    memset(&game->record, 0, sizeof(game->record));
+    game->move_count = 0;
 }
 
-void move_piece_on_board(int from_r, int from_c, int to_r, int to_c) {
+// --- FEN Import/Export ---
+static PieceType piece_type_from_fen_char(char ch) {
+    switch (ch) {
+        case 'p': case 'P': return PAWN;   case 'n': case 'N': return KNIGHT;
+        case 'b': case 'B': return BISHOP; case 'r': case 'R': return ROOK;
+        case 'q': case 'Q': return QUEEN;  case 'k': case 'K': return KING;
+        default: return EMPTY;
+    }
+}
+
+static char fen_char_from_piece(Piece p) {
+    static const char chars[] = " pnbrqk"; // Indexed by PieceType
+    char ch = chars[p.type];
+    return (p.color == WHITE) ? (char)(ch - 'a' + 'A') : ch;
+}
+
+static const char* skip_fen_spaces(const char* s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+bool load_fen(Game* game, const char* fen) {
+    Piece board[8][8];
+    const char* s = skip_fen_spaces(fen);
+    int white_kings = 0, black_kings = 0;
+
+    // 1. Piece placement, rank 8 (row 0) first
+    for (int r = 0; r < 8; ++r) {
+        int c = 0;
+        while (c < 8) {
+            char ch = *s++;
+            if (ch >= '1' && ch <= '8') {
+                int run = ch - '0';
+                if (c + run > 8) return false;
+                for (int i = 0; i < run; ++i) board[r][c++] = (Piece){EMPTY, NO_COLOR};
+            } else {
+                PieceType type = piece_type_from_fen_char(ch);
+                if (type == EMPTY) return false;
+                PieceColor color = (ch >= 'A' && ch <= 'Z') ? WHITE : BLACK;
+                if (type == PAWN && (r == 0 || r == 7)) return false;
+                if (type == KING) { if (color == WHITE) white_kings++; else black_kings++; }
+                board[r][c++] = (Piece){type, color};
+            }
+        }
+        if (r < 7 && *s++ != '/') return false;
+    }
+    if (white_kings != 1 || black_kings != 1) return false;
+
+    // 2. Side to move
+    s = skip_fen_spaces(s);
+    PieceColor turn;
+    if (*s == 'w') turn = WHITE;
+    else if (*s == 'b') turn = BLACK;
+    else return false;
+    s++;
+
+    // 3. Castling rights
+    s = skip_fen_spaces(s);
+    int rights = 0;
+    if (*s == '-') {
+        s++;
+    } else {
+        if (*s == '\0' || *s == ' ') return false;
+        while (*s && *s != ' ') {
+            int row, rook_col, right;
+            switch (*s) {
+                case 'K': row = 7; rook_col = 7; right = CASTLE_WHITE_KINGSIDE; break;
+                case 'Q': row = 7; rook_col = 0; right = CASTLE_WHITE_QUEENSIDE; break;
+                case 'k': row = 0; rook_col = 7; right = CASTLE_BLACK_KINGSIDE; break;
+                case 'q': row = 0; rook_col = 0; right = CASTLE_BLACK_QUEENSIDE; break;
+                default: return false;
+            }
+            PieceColor color = (row == 7) ? WHITE : BLACK;
+            if (board[row][4].type != KING || board[row][4].color != color ||
+                board[row][rook_col].type != ROOK || board[row][rook_col].color != color) {
+                return false;
+            }
+            rights |= right;
+            s++;
+        }
+    }
+
+    // 4. En passant target square
+    s = skip_fen_spaces(s);
+    int ep_r = -1, ep_c = -1;
+    if (*s == '-') {
+        s++;
+    } else {
+        if (s[0] < 'a' || s[0] > 'h' || (s[1] != '3' && s[1] != '6')) return false;
+        ep_c = s[0] - 'a';
+        ep_r = '8' - s[1];
+        s += 2;
+    }
+
+    // 5./6. Halfmove clock and fullmove number (optional)
+    int halfmove = 0, fullmove = 1;
+    s = skip_fen_spaces(s);
+    if (*s >= '0' && *s <= '9') {
+        halfmove = 0;
+        while (*s >= '0' && *s <= '9') halfmove = halfmove * 10 + (*s++ - '0');
+        s = skip_fen_spaces(s);
+        if (*s >= '0' && *s <= '9') {
+            fullmove = 0;
+            while (*s >= '0' && *s <= '9') fullmove = fullmove * 10 + (*s++ - '0');
+            if (fullmove < 1) fullmove = 1;
+        }
+    }
+
+    Position* pos = &game->pos;
+    memcpy(pos->board, board, sizeof(board));
+    pos->turn = turn;
+    pos->en_passant_r = ep_r;
+    pos->en_passant_c = ep_c;
+    pos->halfmove_clock = halfmove;
+    pos->castling_rights = rights;
+    start_record(game, pos, fullmove);
+    return true;
+}
+
+void get_fen(const Game* game, char* out, size_t out_size) {
+    const Position* pos = &game->pos;
+    char fen[MAX_FEN_LENGTH];
+    int n = 0;
+
+    for (int r = 0; r < 8; ++r) {
+        int empty_run = 0;
+        for (int c = 0; c < 8; ++c) {
+            Piece p = pos->board[r][c];
+            if (p.type == EMPTY) { empty_run++; continue; }
+            if (empty_run > 0) { fen[n++] = (char)('0' + empty_run); empty_run = 0; }
+            fen[n++] = fen_char_from_piece(p);
+        }
+        if (empty_run > 0) fen[n++] = (char)('0' + empty_run);
+        if (r < 7) fen[n++] = '/';
+    }
+
+    fen[n++] = ' ';
+    fen[n++] = (pos->turn == WHITE) ? 'w' : 'b';
+    fen[n++] = ' ';
+
+    if (pos->castling_rights & CASTLE_WHITE_KINGSIDE)  fen[n++] = 'K';
+    if (pos->castling_rights & CASTLE_WHITE_QUEENSIDE) fen[n++] = 'Q';
+    if (pos->castling_rights & CASTLE_BLACK_KINGSIDE)  fen[n++] = 'k';
+    if (pos->castling_rights & CASTLE_BLACK_QUEENSIDE) fen[n++] = 'q';
+    if (pos->castling_rights == 0) fen[n++] = '-';
+    fen[n++] = ' ';
+
+    if (pos->en_passant_r != -1) {
+        fen[n++] = (char)('a' + pos->en_passant_c);
+        fen[n++] = (char)('8' - pos->en_passant_r);
+    } else {
+        fen[n++] = '-';
+    }
+    fen[n] = '\0';
+
+    snprintf(out, out_size, "%s %d %d", fen, pos->halfmove_clock, fullmove_number(game));
+}
+
+void move_piece_on_board(Position* pos, int from_r, int from_c, int to_r, int to_c) {
     if (!is_square_on_board(from_r, from_c) || !is_square_on_board(to_r, to_c)) return;
     if (from_r == to_r && from_c == to_c) return;
 
-    game_board[to_r][to_c] = game_board[from_r][from_c];
-    game_board[to_r][to_c].has_moved = true; // This is the key part for `has_moved`
+    pos->board[to_r][to_c] = pos->board[from_r][from_c];
+    pos->board[from_r][from_c].type = EMPTY;
+    pos->board[from_r][from_c].color = NO_COLOR;
+}
 
-    game_board[from_r][from_c].type = EMPTY;
-    game_board[from_r][from_c].color = NO_COLOR;
-    game_board[from_r][from_c].has_moved = false; // Or true, doesn't matter for empty
+void switch_player_turn(Position* pos) {
+    pos->turn = (pos->turn == WHITE) ? BLACK : WHITE;
+}
+void clear_en_passant_target(Position* pos) {
+    pos->en_passant_r = -1; pos->en_passant_c = -1;
+}
+void set_en_passant_target(Position* pos, int r, int c) {
+    pos->en_passant_r = r; pos->en_passant_c = c;
+}
+void update_castling_rights(Position* pos, int from_r, int from_c, int to_r, int to_c) {
+    pos->castling_rights &= castling_rights_mask[from_r][from_c] & castling_rights_mask[to_r][to_c];
 }
 
-void switch_player_turn() {
-    current_player_turn = (current_player_turn == WHITE) ? BLACK : WHITE;
+// --- Move History Functions ---
+static uint8_t pack_piece(Piece piece) {
+    return (uint8_t)(piece.type | piece.color << 3);
 }
-void clear_en_passant_target() {
-    en_passant_target_r = -1; en_passant_target_c = -1;
+
+static Piece unpack_piece(uint8_t packed) {
+    return (Piece){(PieceType)(packed & 7), (PieceColor)(packed >> 3)};
 }
-void set_en_passant_target(int r, int c) {
-    en_passant_target_r = r; en_passant_target_c = c;
+
+static GameMove unpack_move(uint16_t move) {
+    int from = move & 63, to = (move >> 6) & 63;
+    return (GameMove){from / 8, from % 8, to / 8, to % 8, (PieceType)(move >> 12)};
 }
 
-// --- NEW: Move History Functions ---
-void record_move(int fr, int fc, int tr, int tc, Piece moved, Piece captured, PieceType promo,
-                 bool cast_k, bool cast_q, bool ep, int ep_cap_r, int ep_cap_c,
-                 int prev_ep_r, int prev_ep_c, int prev_hm_clock) {
-    if (current_move_number >= MAX_MOVES_IN_GAME) {
-        printf("Warning: Max move history reached.\n");
+// Plays a move on pos, leaving the turn to the caller, and returns what undoing it needs.
+static GameRecordEntry make_move(Position* pos, int from_r, int from_c, int to_r, int to_c, PieceType promotion) {
+    Piece moved = pos->board[from_r][from_c];
+    Piece captured = pos->board[to_r][to_c];
+    GameRecordEntry entry;
+    entry.move = (uint16_t)((from_r * 8 + from_c) | (to_r * 8 + to_c) << 6 | promotion << 12);
+    entry.prev_halfmove_clock = (uint16_t)(pos->halfmove_clock < 65535 ? pos->halfmove_clock : 65535);
+    entry.captured = pack_piece(captured);
+    entry.prev_castling_rights = (uint8_t)pos->castling_rights;
+    entry.prev_en_passant = (int8_t)(pos->en_passant_r >= 0 ? pos->en_passant_r * 8 + pos->en_passant_c : -1);
+    entry.reserved = 0;
+
+    bool is_castling = moved.type == KING && abs(to_c - from_c) == 2;
+    bool is_ep_capture = moved.type == PAWN && to_r == pos->en_passant_r && to_c == pos->en_passant_c && captured.type == EMPTY;
+
+    if (moved.type == PAWN || captured.type != EMPTY) pos->halfmove_clock = 0;
+    else pos->halfmove_clock++;
+
+    move_piece_on_board(pos, from_r, from_c, to_r, to_c);
+    update_castling_rights(pos, from_r, from_c, to_r, to_c);
+
+    if (is_castling && to_c > from_c) move_piece_on_board(pos, from_r, 7, from_r, 5);
+    else if (is_castling) move_piece_on_board(pos, from_r, 0, from_r, 3);
+    if (is_ep_capture) pos->board[from_r][to_c] = (Piece){EMPTY, NO_COLOR};
+    if (promotion != EMPTY) pos->board[to_r][to_c].type = promotion;
+
+    clear_en_passant_target(pos);
+    if (moved.type == PAWN && abs(to_r - from_r) == 2) {
+        set_en_passant_target(pos, (moved.color == WHITE) ? to_r + 1 : to_r - 1, to_c);
+    }
+    return entry;
+}
+
+// Takes back the move entry was recorded for; pos is the position after it, with the turn
+// already passed to the opponent, and is left with the mover to move again.
+static void unmake_move(Position* pos, const GameRecordEntry* entry) {
+    GameMove m = unpack_move(entry->move);
+    Piece moved = pos->board[m.to_r][m.to_c];
+    if (m.promotion != EMPTY) moved.type = PAWN;
+    Piece captured = unpack_piece(entry->captured);
+
+    pos->board[m.from_r][m.from_c] = moved;
+    pos->board[m.to_r][m.to_c] = captured;
+    if (moved.type == KING && m.to_c - m.from_c == 2) move_piece_on_board(pos, m.from_r, 5, m.from_r, 7);
+    else if (moved.type == KING && m.to_c - m.from_c == -2) move_piece_on_board(pos, m.from_r, 3, m.from_r, 0);
+    if (moved.type == PAWN && m.to_c != m.from_c && captured.type == EMPTY) { // En passant
+        pos->board[m.from_r][m.to_c] = (Piece){PAWN, moved.color == WHITE ? BLACK : WHITE};
+    }
+
+    pos->halfmove_clock = entry->prev_halfmove_clock;
+    pos->en_passant_r = entry->prev_en_passant >= 0 ? entry->prev_en_passant / 8 : -1;
+    pos->en_passant_c = entry->prev_en_passant >= 0 ? entry->prev_en_passant % 8 : -1;
+    pos->castling_rights = entry->prev_castling_rights;
+    switch_player_turn(pos);
+}
+
+// Room for one more entry; false when out of memory.
+static bool reserve_entry(GameRecord* record) {
+    if (record->length < record->capacity) return true;
+    int capacity = record->capacity > 0 ? record->capacity * 2 : 2 * GAME_SNAPSHOT_INTERVAL;
+    GameRecordEntry* entries = realloc(record->entries, (size_t)capacity * sizeof(GameRecordEntry));
+    if (entries == NULL) return false;
+    record->entries = entries;
+    record->capacity = capacity;
+    return true;
+}
+
+// Keeps pos as the snapshot before ply when one is due there. A snapshot that cannot be
+// stored is skipped (and with it the later ones): they only make jumps faster.
+static void take_snapshot(GameRecord* record, int ply, const Position* pos) {
+    int index = ply / GAME_SNAPSHOT_INTERVAL - 1;
+    if (ply % GAME_SNAPSHOT_INTERVAL != 0 || index < 0 || record->num_snapshots != index) return;
+    if (index >= record->snapshot_capacity) {
+        int capacity = record->snapshot_capacity > 0 ? record->snapshot_capacity * 2 : 4;
+        Position* snapshots = realloc(record->snapshots, (size_t)capacity * sizeof(Position));
+        if (snapshots == NULL) return;
+        record->snapshots = snapshots;
+        record->snapshot_capacity = capacity;
+    }
+    record->snapshots[record->num_snapshots++] = *pos;
+}
+
+void execute_move(Game* game, int from_r, int from_c, int to_r, int to_c, PieceType promotion_piece_type) {
+    GameRecord* record = &game->record;
+    int ply = game->move_count;
+    record->length = ply; // Drops the undone moves, and the snapshots after them
+    if (record->num_snapshots > ply / GAME_SNAPSHOT_INTERVAL) record->num_snapshots = ply / GAME_SNAPSHOT_INTERVAL;
+
+    if (ply >= GAME_MAX_PLIES || !reserve_entry(record)) {
+        // Played unrecorded; the record restarts from the position after it, whose side to
+        // move is the one the caller is about to switch to
+        fprintf(stderr, "Warning: game record full; earlier moves can no longer be undone.\n");
+        int fullmove = fullmove_number(game) + (game->pos.turn == BLACK ? 1 : 0);
+        make_move(&game->pos, from_r, from_c, to_r, to_c, promotion_piece_type);
+        Position start = game->pos;
+        switch_player_turn(&start);
+        start_record(game, &start, fullmove);
         return;
     }
-    Move* m = &move_history[current_move_number];
-    m->from_r = fr; m->from_c = fc;
-    m->to_r = tr; m->to_c = tc;
-    m->piece_moved = moved;         // This should be the state *before* its .has_moved was set to true by move_piece_on_board
-    m->piece_captured = captured;
-    m->promotion_to = promo;
-    m->was_castling_kingside = cast_k;
-    m->was_castling_queenside = cast_q;
-    m->was_en_passant = ep;
-    m->captured_ep_pawn_r = ep_cap_r;
-    m->captured_ep_pawn_c = ep_cap_c;
-    m->prev_en_passant_target_r = prev_ep_r;
-    m->prev_en_passant_target_c = prev_ep_c;
-    m->prev_halfmove_clock = prev_hm_clock;
-
-    current_move_number++;
-}
-
-bool undo_last_move() {
-    if (current_move_number == 0) {
-        printf("No moves to undo.\n");
-        return false;
-    }
-
-    current_move_number--; // Go to the last move made
-    Move* last_m = &move_history[current_move_number];
-
-    // 1. Restore the piece that moved to its original square
-    // The `piece_moved` in history already has its original `has_moved` status.
-    game_board[last_m->from_r][last_m->from_c] = last_m->piece_moved;
-
-    // 2. Restore the captured piece (if any) to the destination square
-    // Or clear the destination square if it was an empty move
-    game_board[last_m->to_r][last_m->to_c] = last_m->piece_captured;
-
-    // 3. Handle pawn promotion undo (demote)
-    if (last_m->promotion_to != EMPTY) {
-        game_board[last_m->from_r][last_m->from_c].type = PAWN; // It was a pawn that moved to promote
-    }
-
-    // 4. Handle castling undo
-    if (last_m->was_castling_kingside) {
-        // King is already at from_r, from_c (e.g., e1)
-        // Rook was at (from_r, to_c-1) (e.g., f1), needs to go back to (from_r, 7) (h1)
-        // The rook's piece_moved data is in last_m->piece_moved, which is the KING.
-        // We need the original rook.
-        Piece rook_to_move_back = game_board[last_m->from_r][last_m->to_c - 1]; // Rook on f1/f8
-        rook_to_move_back.has_moved = false; // Reset its moved status
-        game_board[last_m->from_r][7] = rook_to_move_back;
-        game_board[last_m->from_r][last_m->to_c - 1] = (Piece){EMPTY, NO_COLOR, false}; // Clear f1/f8
-    } else if (last_m->was_castling_queenside) {
-        // King at from_r, from_c (e.g., e1)
-        // Rook was at (from_r, to_c+1) (e.g., d1), needs to go back to (from_r, 0) (a1)
-        Piece rook_to_move_back = game_board[last_m->from_r][last_m->to_c + 1]; // Rook on d1/d8
-        rook_to_move_back.has_moved = false;
-        game_board[last_m->from_r][0] = rook_to_move_back;
-        game_board[last_m->from_r][last_m->to_c + 1] = (Piece){EMPTY, NO_COLOR, false}; // Clear d1/d8
-    }
-
-    // 5. Handle en passant undo
-    if (last_m->was_en_passant) {
-        // The moving pawn is at from_r, from_c.
-        // The captured pawn was at captured_ep_pawn_r, captured_ep_pawn_c.
-        // It was captured by piece_moved (a pawn). We need to restore it.
-        // The color of the captured EP pawn is the opponent's color.
-        PieceColor captured_pawn_color = (last_m->piece_moved.color == WHITE) ? BLACK : WHITE;
-        game_board[last_m->captured_ep_pawn_r][last_m->captured_ep_pawn_c] = (Piece){PAWN, captured_pawn_color, true}; // Assume it had moved
-        // The destination square to_r, to_c should already be empty or contain what was there before the EP capture
-        // which is handled by restoring piece_captured (which should be EMPTY for EP).
-    }
-
-    // 6. Restore game state variables
-    halfmove_clock = last_m->prev_halfmove_clock;
-    en_passant_target_r = last_m->prev_en_passant_target_r;
-    en_passant_target_c = last_m->prev_en_passant_target_c;
-
-    // 7. Switch player turn back
-    switch_player_turn(); // This switches to the player who made the undone move
-
-    printf("Move undone. Player to move: %s\n", current_player_turn == WHITE ? "W" : "B");
+
+    take_snapshot(record, ply, &game->pos);
+    record->entries[ply] = make_move(&game->pos, from_r, from_c, to_r, to_c, promotion_piece_type);
+    record->length = ++game->move_count;
+}
+
+void position_execute_move(Position* pos, int from_r, int from_c, int to_r, int to_c, PieceType promotion_piece_type) {
+    make_move(pos, from_r, from_c, to_r, to_c, promotion_piece_type);
+}
+
+bool undo_last_move(Game* game) {
+    if (game->move_count == 0) return false;
+    unmake_move(&game->pos, &game->record.entries[--game->move_count]);
+    return true;
+}
+
+bool redo_move(Game* game) {
+    if (game->move_count >= game->record.length) return false;
+    GameRecordEntry* entry = &game->record.entries[game->move_count];
+    GameMove m = unpack_move(entry->move);
+    *entry = make_move(&game->pos, m.from_r, m.from_c, m.to_r, m.to_c, m.promotion); // The same entry again
+    switch_player_turn(&game->pos);
+    game->move_count++;
+    return true;
+}
+
+bool game_goto_ply(Game* game, int ply) {
+    const GameRecord* record = &game->record;
+    if (ply < 0 || ply > record->length) return false;
+    // Replay from the last snapshot (or the start) at or before ply when that is closer
+    int snapshot = ply / GAME_SNAPSHOT_INTERVAL;
+    if (snapshot > record->num_snapshots) snapshot = record->num_snapshots;
+    int snapshot_ply = snapshot * GAME_SNAPSHOT_INTERVAL;
+    if (ply - snapshot_ply < abs(ply - game->move_count)) {
+        game->pos = snapshot > 0 ? record->snapshots[snapshot - 1] : game->start;
+        game->move_count = snapshot_ply;
+    }
+    while (game->move_count > ply) unmake_move(&game->pos, &record->entries[--game->move_count]);
+    while (game->move_count < ply) redo_move(game);
+    return true;
+}
+
+bool game_get_move(const Game* game, int ply, GameMove* move) {
+    if (ply < 0 || ply >= game->record.length) return false;
+    *move = unpack_move(game->record.entries[ply].move);
     return true;
-}
\ No newline at end of file
+}
+
+// --- Record Serialization ---
+static void put_u32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t game_serialize(const Game* game, uint8_t* out, size_t out_size) {
+    Game start = {0}; // Just the start position, for its FEN
+    start.pos = game->start;
+    start.start_fullmove_number = game->start_fullmove_number;
+    start.start_turn = game->start_turn;
+    char fen[MAX_FEN_LENGTH];
+    get_fen(&start, fen, sizeof(fen));
+
+    size_t fen_size = strlen(fen) + 1;
+    size_t size = fen_size + 8 + 2 * (size_t)game->record.length;
+    if (out == NULL || out_size < size) return size;
+    memcpy(out, fen, fen_size);
+    uint8_t* p = out + fen_size;
+    put_u32(p, (uint32_t)game->record.length);
+    put_u32(p + 4, (uint32_t)game->move_count);
+    p += 8;
+    for (int i = 0; i < game->record.length; ++i, p += 2) {
+        p[0] = (uint8_t)(game->record.entries[i].move & 0xFF);
+        p[1] = (uint8_t)(game->record.entries[i].move >> 8);
+    }
+    return size;
+}
+
+bool game_deserialize(Game* game, const uint8_t* data, size_t size) {
+    const uint8_t* fen_end = memchr(data, '\0', size);
+    if (fen_end == NULL || !load_fen(game, (const char*)data)) return false;
+    const uint8_t* p = fen_end + 1;
+    size_t remaining = size - (size_t)(p - data);
+    if (remaining < 8) return false;
+    uint32_t length = get_u32(p), current = get_u32(p + 4);
+    p += 8;
+    remaining -= 8;
+    if (length > GAME_MAX_PLIES || current > length || remaining != 2 * (size_t)length) return false;
+
+    Position* pos = &game->pos;
+    for (uint32_t i = 0; i < length; ++i, p += 2) {
+        GameMove m = unpack_move((uint16_t)(p[0] | p[1] << 8));
+        bool promotes = pos->board[m.from_r][m.from_c].type == PAWN && (m.to_r == 0 || m.to_r == 7);
+        bool promotion_ok = promotes ? (m.promotion >= KNIGHT && m.promotion <= QUEEN) : m.promotion == EMPTY;
+        if (!promotion_ok || !is_move_legal(pos, m.from_r, m.from_c, m.to_r, m.to_c, pos->turn)) return false;
+        execute_move(game, m.from_r, m.from_c, m.to_r, m.to_c, m.promotion);
+        switch_player_turn(pos);
+    }
+    return game_goto_ply(game, (int)current);
+}
@@ -2,6 +2,8 @@
 #define BOARD_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Represents the color of a piece or an empty square
 typedef enum { NO_COLOR, WHITE, BLACK } PieceColor;
@@ -10,53 +12,120 @@ typedef enum { EMPTY, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING } PieceType;
 typedef struct {
     PieceType type;
     PieceColor color;
-    bool has_moved;
 } Piece;
 
-// --- NEW: Move Structure ---
+// --- Castling Rights ---
+// 4-bit field: a bit is cleared once its king or rook leaves (or is captured on) its home square.
+#define CASTLE_WHITE_KINGSIDE  1
+#define CASTLE_WHITE_QUEENSIDE 2
+#define CASTLE_BLACK_KINGSIDE  4
+#define CASTLE_BLACK_QUEENSIDE 8
+#define CASTLE_ALL (CASTLE_WHITE_KINGSIDE | CASTLE_WHITE_QUEENSIDE | CASTLE_BLACK_KINGSIDE | CASTLE_BLACK_QUEENSIDE)
+
+#define START_POSITION_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define MAX_FEN_LENGTH 100 // Longest legal FEN is well under this
+
+// --- Position and Game ---
+// A position is the pieces plus the state move legality depends on; it is small enough to
+// copy, so the search keeps one per ply. A game adds the moves that led to it. Neither has
+// any global instance: every caller owns its games, so one process can host many.
+typedef struct {
+    Piece board[8][8];
+    PieceColor turn;
+    int en_passant_r, en_passant_c; // Square a pawn can capture onto en passant; -1 if none
+    int castling_rights;
+    int halfmove_clock;
+} Position;
+
+// --- Game Record ---
+// The moves of a game, each packed together with what undoing it needs into 8 bytes, in an
+// array that grows with the game: a short game costs a few hundred bytes and a long
+// correspondence game is never cut off. Undone moves stay recorded until another move is
+// played in their place, so undo and redo are one move each. Every GAME_SNAPSHOT_INTERVAL
+// plies the position is kept as well, so any ply is reached by replaying fewer moves than
+// that. A Game must start zeroed (static, or = {0}); game_free releases its record.
+
+#define GAME_SNAPSHOT_INTERVAL 32
+#define GAME_MAX_PLIES 65535 // The record restarts from the current position beyond this
+
+typedef struct {
+    uint16_t move;                // From square | to square << 6 | promotion << 12; a square is r * 8 + c
+    uint16_t prev_halfmove_clock; // Saturated at 65535
+    uint8_t captured;             // Piece on the destination square: type | color << 3
+    uint8_t prev_castling_rights;
+    int8_t prev_en_passant;       // Square, or -1
+    uint8_t reserved;
+} GameRecordEntry;
+
+typedef struct {
+    GameRecordEntry* entries; // [length]: moves played, then the undone ones that can be redone
+    int length, capacity;
+    Position* snapshots;      // [k]: position before ply (k + 1) * GAME_SNAPSHOT_INTERVAL
+    int num_snapshots, snapshot_capacity;
+} GameRecord;
+
+// A recorded move, unpacked.
 typedef struct {
     int from_r, from_c;
     int to_r, to_c;
-    Piece piece_moved;         // What piece was moved
-    Piece piece_captured;      // What piece was at to_sq (EMPTY if none)
-    PieceType promotion_to;    // Type of piece pawn promoted to (EMPTY if no promotion)
-    bool was_castling_kingside;
-    bool was_castling_queenside;
-    bool was_en_passant;
-    int captured_ep_pawn_r;   // If EP, original row of captured pawn
-    int captured_ep_pawn_c;   // If EP, original col of captured pawn
-    // For restoring state before this move:
-    int prev_en_passant_target_r;
-    int prev_en_passant_target_c;
-    int prev_halfmove_clock;
-    // We might also need to store castling rights before the move if not derivable
-    // from piece.has_moved easily for undo. For now, has_moved is primary.
-} Move;
-
-#define MAX_MOVES_IN_GAME 500 // Arbitrary limit for history, can be dynamic
-
-extern Piece game_board[8][8];
-extern PieceColor current_player_turn;
-extern int en_passant_target_r;
-extern int en_passant_target_c;
-extern int halfmove_clock;
-
-// --- NEW: Move History ---
-extern Move move_history[MAX_MOVES_IN_GAME];
-extern int current_move_number; // Index of the *next* move to be stored (also total moves made)
-
-void init_board(); // Will also need to init move history
+    PieceType promotion; // EMPTY for none
+} GameMove;
+
+typedef struct {
+    Position pos;
+    Position start;  // Position before the first recorded move
+    GameRecord record;
+    int move_count;  // Plies played from start to reach pos
+    // Where the record starts, so the FEN fullmove counter stays correct for games set up
+    // from an arbitrary position.
+    int start_fullmove_number;
+    PieceColor start_turn;
+} Game;
+
+// Castling rights that survive a move touching square [r][c] (from or to).
+extern const int castling_rights_mask[8][8];
+
+void init_board(Game* game); // Initial position, empty move history
+void game_free(Game* game);   // Releases the record; the game can be set up again afterwards
+
+// --- FEN Import/Export ---
+// Sets up the position (board, turn, castling rights, en passant and halfmove clock)
+// from a FEN string and clears the move history. The halfmove and fullmove fields
+// are optional so EPD records can be passed in directly.
+// Returns false (leaving the game untouched) if the FEN is malformed.
+bool load_fen(Game* game, const char* fen);
+// Writes the current position as a FEN string into out (at least MAX_FEN_LENGTH bytes).
+void get_fen(const Game* game, char* out, size_t out_size);
 const char* get_piece_type_string(PieceType type);
 const char* get_piece_color_string(PieceColor color);
-void move_piece_on_board(int from_r, int from_c, int to_r, int to_c);
-void switch_player_turn();
-void clear_en_passant_target();
-void set_en_passant_target(int r, int c);
-
-// --- NEW: Move History Functions ---
-void record_move(int fr, int fc, int tr, int tc, Piece moved, Piece captured, PieceType promo,
-                 bool cast_k, bool cast_q, bool ep, int ep_cap_r, int ep_cap_c,
-                 int prev_ep_r, int prev_ep_c, int prev_hm_clock);
-bool undo_last_move(); // Returns true if undo was successful
+void move_piece_on_board(Position* pos, int from_r, int from_c, int to_r, int to_c);
+void switch_player_turn(Position* pos);
+void clear_en_passant_target(Position* pos);
+void set_en_passant_target(Position* pos, int r, int c);
+// Clears the castling rights lost by a move from [from_r][from_c] to [to_r][to_c].
+void update_castling_rights(Position* pos, int from_r, int from_c, int to_r, int to_c);
+
+// --- Move History Functions ---
+// Plays a move in the game (board, record, halfmove clock, castling rights and en passant
+// square); the caller switches the turn. promotion_piece_type is EMPTY for none. Moves that
+// were undone are dropped from the record.
+void execute_move(Game* game, int from_r, int from_c, int to_r, int to_c, PieceType promotion_piece_type);
+// The same move on a bare position, not recorded anywhere; the caller switches the turn.
+void position_execute_move(Position* pos, int from_r, int from_c, int to_r, int to_c, PieceType promotion_piece_type);
+bool undo_last_move(Game* game); // Returns true if undo was successful; switches the turn back; prints nothing
+bool redo_move(Game* game);      // Replays the next undone move, turn included; false if there is none
+// Moves to ply (0 to record.length) by undoing or redoing, or from the nearest snapshot.
+bool game_goto_ply(Game* game, int ply);
+// Recorded move number ply (0-based, played or undone); false past the record.
+bool game_get_move(const Game* game, int ply, GameMove* move);
+
+// --- Record Serialization ---
+// The start position as a FEN with its terminating NUL, the number of recorded moves and
+// the current ply as little-endian uint32, then each move as its little-endian uint16.
+// Writes nothing when out_size is too small; returns the size either way.
+size_t game_serialize(const Game* game, uint8_t* out, size_t out_size);
+// Replays a serialized record, checking each move's legality. Returns false on malformed
+// data or an illegal move; the game then holds the moves before it.
+bool game_deserialize(Game* game, const uint8_t* data, size_t size);
 
 #endif // BOARD_H
\ No newline at end of file
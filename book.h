@@ -0,0 +1,42 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+
+// --- Polyglot Opening Book ---
+// The .bin file is memory-mapped read-only and shared, so any number of engine processes
+// on one machine use a single page-cached copy and opening a book costs no parsing.
+// Positions are looked up by their Polyglot Zobrist key with a binary search over the
+// sorted 16-byte entries.
+//
+// The key is built from the 781 "Random64" constants of the Polyglot book format, which
+// are compiled in, so any standard Polyglot book works as is.
+
+#define BOOK_MAX_MOVES 64 // Entries considered for one position
+
+typedef struct {
+    int from_r, from_c;
+    int to_r, to_c;
+    PieceType promotion_to; // EMPTY unless the book move is a promotion
+    int weight;
+} BookMove;
+
+// Maps book_path. Returns false and leaves no book open on any error.
+bool book_open(const char* book_path);
+void book_close(void);
+bool book_is_open(void);
+
+// Polyglot key of the position (pieces, side to move, castling rights and en passant).
+uint64_t book_key(const Position* pos);
+
+// Fills moves with the book entries for the position (castling converted from the
+// Polyglot king-takes-rook form) and returns how many there are.
+int book_get_moves(const Position* pos, BookMove* moves, int max_moves);
+
+// Picks one of the position's book moves at random, weighted by the entry weights.
+// Returns false if the position is not in the book.
+bool book_pick_move(const Position* pos, BookMove* move);
+
+#endif // BOOK_H
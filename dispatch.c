@@ -0,0 +1,122 @@
+// Runtime CPU dispatcher for the release build.
+// 'make release' builds every program once per -march variant under build/release/<march>/
+// and installs a copy of this launcher as build/release/<program>. The launcher picks the
+// most capable variant the running CPU supports and exec()s it with the same arguments,
+// so one release directory runs at full speed on new machines and still works on old ones.
+// Set CHESS_ENGINE_ARCH=<march> to force a particular variant.
+#define _DEFAULT_SOURCE // For readlink()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Candidate variants, best first. A variant is used only if the CPU supports it and
+// its binary was actually built.
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_ARCH_VARIANTS 1
+static bool cpu_supports_v2(void) {
+    return __builtin_cpu_supports("sse3") && __builtin_cpu_supports("ssse3") &&
+           __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("sse4.2") &&
+           __builtin_cpu_supports("popcnt");
+}
+
+static bool cpu_supports_v3(void) {
+    return cpu_supports_v2() && __builtin_cpu_supports("avx") && __builtin_cpu_supports("avx2") &&
+           __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+           __builtin_cpu_supports("fma");
+}
+
+static bool cpu_supports_v4(void) {
+    return cpu_supports_v3() && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512dq") &&
+           __builtin_cpu_supports("avx512vl");
+}
+
+static bool cpu_supports_baseline(void) { return true; }
+
+typedef struct {
+    const char* name;
+    bool (*supported)(void);
+} ArchVariant;
+
+static const ArchVariant arch_variants[] = {
+    {"x86-64-v4", cpu_supports_v4},
+    {"x86-64-v3", cpu_supports_v3},
+    {"x86-64-v2", cpu_supports_v2},
+    {"x86-64", cpu_supports_baseline},
+};
+#define NUM_ARCH_VARIANTS ((int)(sizeof(arch_variants) / sizeof(arch_variants[0])))
+#endif
+
+// Directory and file name this launcher was started as (resolving symlinks where possible).
+static bool get_self_path(const char* argv0, char* dir, size_t dir_size, char* name, size_t name_size) {
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0) {
+        path[len] = '\0';
+    } else if (strlen(argv0) < sizeof(path)) {
+        strcpy(path, argv0);
+    } else {
+        return false;
+    }
+
+    // The program name comes from argv[0] so that copies of the launcher named 'bench',
+    // 'epd_bench' etc. start the matching program even if /proc resolved a shared file.
+    const char* base = strrchr(argv0, '/');
+    base = base ? base + 1 : argv0;
+    if (strlen(base) + 1 > name_size) return false;
+    strcpy(name, base);
+
+    char* slash = strrchr(path, '/');
+    if (slash == NULL) {
+        snprintf(dir, dir_size, ".");
+    } else {
+        *slash = '\0';
+        if ((size_t)snprintf(dir, dir_size, "%s", path[0] ? path : "/") >= dir_size) return false;
+    }
+    return true;
+}
+
+static void exec_variant(const char* dir, const char* arch, const char* name, char* argv[]) {
+    char target[PATH_MAX];
+    if ((size_t)snprintf(target, sizeof(target), "%s/%s/%s", dir, arch, name) >= sizeof(target)) return;
+    if (access(target, X_OK) != 0) return;
+    argv[0] = target;
+    execv(target, argv);
+    printf("Could not start %s\n", target); // execv only returns on failure
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    char dir[PATH_MAX];
+    char name[256];
+    if (!get_self_path(argv[0], dir, sizeof(dir), name, sizeof(name))) {
+        printf("Could not determine the launcher location\n");
+        return 1;
+    }
+
+    const char* forced = getenv("CHESS_ENGINE_ARCH");
+    if (forced && forced[0]) {
+        exec_variant(dir, forced, name, argv);
+        printf("Variant '%s' of %s is not available in %s\n", forced, name, dir);
+        return 1;
+    }
+
+#ifdef HAVE_ARCH_VARIANTS
+    __builtin_cpu_init();
+    for (int i = 0; i < NUM_ARCH_VARIANTS; ++i) {
+        if (arch_variants[i].supported()) exec_variant(dir, arch_variants[i].name, name, argv);
+    }
+#endif
+    // Non-x86 hosts (and trees built with MARCH_VARIANTS=native) use a single variant
+    exec_variant(dir, "native", name, argv);
+
+    printf("No build of %s under %s runs on this CPU\n", name, dir);
+    return 1;
+}
@@ -0,0 +1,336 @@
+// Headless EPD test-suite runner.
+// Searches every position of an EPD file with a fixed time/node/depth budget and reports
+// how many best-move ("bm") / avoid-move ("am") records the engine solves, how quickly it
+// settles on the solution, and the depth and NPS it reaches. Positions are spread over
+// worker processes, one search at a time each.
+#define _POSIX_C_SOURCE 200809L // For fork(), pipe(), kill() and sysconf()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "ai.h"
+#include "notation.h"
+#include "tablebase.h"
+#include "nnue.h"
+#include "tablemem.h"
+
+#define MAX_EPD_LINE 4096
+#define MAX_EPD_MOVES 8
+#define MAX_EPD_ID 64
+
+typedef struct {
+    char fen[MAX_FEN_LENGTH];
+    char id[MAX_EPD_ID];
+    char best_moves[MAX_EPD_MOVES][MAX_SAN_LENGTH];
+    int num_best_moves;
+    char avoid_moves[MAX_EPD_MOVES][MAX_SAN_LENGTH];
+    int num_avoid_moves;
+} EpdPosition;
+
+// Sent from a worker to the parent through a pipe; small enough for an atomic write().
+typedef struct {
+    int index;
+    bool valid;       // false if the FEN could not be loaded or there was no legal move
+    bool solved;
+    int solved_at_ms; // Time at which the final, correct answer was first found; -1 if unsolved
+    int depth;
+    long nodes;
+    unsigned int time_ms;
+    char move_san[MAX_SAN_LENGTH];
+} EpdResult;
+
+// --- EPD Parsing ---
+
+// Copies the next operand (a bare token or a quoted string) into out and returns the rest of the line.
+static const char* read_epd_operand(const char* s, char* out, size_t out_size) {
+    size_t n = 0;
+    if (*s == '"') {
+        s++;
+        while (*s && *s != '"') { if (n + 1 < out_size) out[n++] = *s; s++; }
+        if (*s == '"') s++;
+    } else {
+        while (*s && *s != ' ' && *s != '\t' && *s != ';') { if (n + 1 < out_size) out[n++] = *s; s++; }
+    }
+    out[n] = '\0';
+    return s;
+}
+
+static void copy_san(char* dest, const char* src) {
+    size_t len = strlen(src);
+    if (len >= MAX_SAN_LENGTH) len = MAX_SAN_LENGTH - 1; // Longer tokens cannot be SAN anyway
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+static bool parse_epd_line(const char* line, EpdPosition* pos) {
+    memset(pos, 0, sizeof(*pos));
+
+    // The first four fields are the FEN without move counters.
+    const char* s = line;
+    size_t n = 0;
+    for (int field = 0; field < 4; ++field) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '\n') return false;
+        if (field > 0 && n + 1 < sizeof(pos->fen)) pos->fen[n++] = ' ';
+        while (*s && *s != ' ' && *s != '\t' && *s != '\n') {
+            if (n + 1 < sizeof(pos->fen)) pos->fen[n++] = *s;
+            s++;
+        }
+    }
+    pos->fen[n] = '\0';
+
+    // Operations: "opcode operand...;"
+    while (*s) {
+        while (*s == ' ' || *s == '\t' || *s == ';') s++;
+        if (*s == '\0' || *s == '\n' || *s == '\r') break;
+
+        char opcode[16];
+        s = read_epd_operand(s, opcode, sizeof(opcode));
+        while (*s && *s != ';' && *s != '\n') {
+            while (*s == ' ' || *s == '\t') s++;
+            if (*s == ';' || *s == '\n' || *s == '\r' || *s == '\0') break;
+            char operand[MAX_EPD_ID];
+            s = read_epd_operand(s, operand, sizeof(operand));
+            if (strcmp(opcode, "bm") == 0 && pos->num_best_moves < MAX_EPD_MOVES) {
+                copy_san(pos->best_moves[pos->num_best_moves++], operand);
+            } else if (strcmp(opcode, "am") == 0 && pos->num_avoid_moves < MAX_EPD_MOVES) {
+                copy_san(pos->avoid_moves[pos->num_avoid_moves++], operand);
+            } else if (strcmp(opcode, "id") == 0) {
+                snprintf(pos->id, sizeof(pos->id), "%s", operand);
+            }
+        }
+    }
+    return pos->num_best_moves > 0 || pos->num_avoid_moves > 0;
+}
+
+static EpdPosition* load_epd_file(const char* path, int* count) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Could not open EPD file %s\n", path);
+        return NULL;
+    }
+    EpdPosition* positions = NULL;
+    int capacity = 0;
+    *count = 0;
+    char line[MAX_EPD_LINE];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            EpdPosition* grown = realloc(positions, (size_t)capacity * sizeof(EpdPosition));
+            if (grown == NULL) { free(positions); fclose(f); return NULL; }
+            positions = grown;
+        }
+        if (parse_epd_line(line, &positions[*count])) {
+            (*count)++;
+        } else {
+            printf("Skipping line %d: no FEN or no bm/am operation\n", line_number);
+        }
+    }
+    fclose(f);
+    return positions;
+}
+
+// --- Solving ---
+
+static bool is_solution(const EpdPosition* pos, const char* san) {
+    for (int i = 0; i < pos->num_avoid_moves; ++i) {
+        if (san_equal(san, pos->avoid_moves[i])) return false;
+    }
+    if (pos->num_best_moves == 0) return true; // am-only record: anything else is fine
+    for (int i = 0; i < pos->num_best_moves; ++i) {
+        if (san_equal(san, pos->best_moves[i])) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    const EpdPosition* pos;
+    const Position* root;
+    int solved_at_ms;
+} SolveTracker;
+
+// Called after every completed iteration.
+static void track_iteration(const AIIterationInfo* info, void* user_data) {
+    SolveTracker* tracker = user_data;
+    char san[MAX_SAN_LENGTH];
+    move_to_san(tracker->root, &info->best_move, san, sizeof(san));
+    if (is_solution(tracker->pos, san)) {
+        if (tracker->solved_at_ms < 0) tracker->solved_at_ms = (int)info->time_ms;
+    } else {
+        tracker->solved_at_ms = -1;
+    }
+}
+
+static EpdResult solve_position(AIEngine* engine, const EpdPosition* pos, int index, const AISearchLimits* base_limits) {
+    EpdResult result;
+    memset(&result, 0, sizeof(result));
+    result.index = index;
+    result.solved_at_ms = -1;
+
+    static Game game;
+    if (!load_fen(&game, pos->fen)) return result;
+    ai_reset_search_state(engine); // Fresh killer tables so positions do not influence each other
+
+    SolveTracker tracker = {pos, &game.pos, -1};
+    AISearchLimits limits = *base_limits;
+    limits.on_iteration = track_iteration;
+    limits.user_data = &tracker;
+
+    AIMove move;
+    AISearchResult search;
+    if (!ai_search(engine, &game.pos, &limits, &move, &search)) return result;
+
+    result.valid = true;
+    move_to_san(&game.pos, &move, result.move_san, sizeof(result.move_san));
+    result.solved = is_solution(pos, result.move_san);
+    result.solved_at_ms = result.solved ? tracker.solved_at_ms : -1;
+    result.depth = search.depth_completed;
+    result.nodes = search.nodes;
+    result.time_ms = search.time_ms;
+    return result;
+}
+
+static void run_worker(const EpdPosition* positions, int count, int worker, int jobs, const AISearchLimits* limits,
+                       size_t hash_mb, int out_fd) {
+    AIEngine engine;
+    ai_engine_init(&engine, hash_mb);
+    for (int i = worker; i < count; i += jobs) {
+        EpdResult result = solve_position(&engine, &positions[i], i, limits);
+        if (write(out_fd, &result, sizeof(result)) != (ssize_t)sizeof(result)) break;
+    }
+    ai_engine_free(&engine);
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [-t ms] [-n nodes] [-d depth] [-j jobs] [-H MB] [-T dir] [-N net] file.epd\n", program_name);
+    printf("  -t ms      Time per position (default 1000 unless -n or -d is given)\n");
+    printf("  -n nodes   Node budget per position\n");
+    printf("  -d depth   Maximum iterative-deepening depth\n");
+    printf("  -j jobs    Worker processes (default: number of CPUs)\n");
+    printf("  -H MB      Transposition table size per worker (default %d)\n", TT_DEFAULT_SIZE_MB);
+    printf("  -T dir     Endgame tablebase directory (built with tbgen)\n");
+    printf("  -N net     Evaluate with an NNUE network file\n");
+}
+
+int main(int argc, char* argv[]) {
+    AISearchLimits limits = {0};
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long hash_mb = TT_DEFAULT_SIZE_MB;
+    const char* epd_path = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) limits.time_limit_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) limits.node_limit = atol(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) limits.depth_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) hash_mb = atol(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) tb_init(argv[++i]);
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) { if (!nnue_load(argv[++i])) return 1; }
+        else if (argv[i][0] != '-' && epd_path == NULL) epd_path = argv[i];
+        else { print_usage(argv[0]); return 1; }
+    }
+    if (epd_path == NULL || hash_mb < 1) { print_usage(argv[0]); return 1; }
+    tablemem_set_budget_mb((size_t)hash_mb); // Per worker process
+    if (limits.time_limit_ms <= 0 && limits.node_limit <= 0 && limits.depth_limit <= 0) limits.time_limit_ms = 1000;
+    if (jobs < 1) jobs = 1;
+
+    int count = 0;
+    EpdPosition* positions = load_epd_file(epd_path, &count);
+    if (positions == NULL || count == 0) {
+        printf("No positions to run.\n");
+        free(positions);
+        return 1;
+    }
+    if (jobs > count) jobs = count;
+
+    printf("Running %d positions on %d worker(s): time %d ms, nodes %ld, depth %d\n",
+           count, jobs, limits.time_limit_ms, limits.node_limit, limits.depth_limit);
+    fflush(stdout); // Children inherit the stdio buffer
+
+    int result_pipe[2];
+    if (pipe(result_pipe) != 0) {
+        perror("pipe");
+        free(positions);
+        return 1;
+    }
+    pid_t* workers = calloc((size_t)jobs, sizeof(pid_t));
+    if (workers == NULL) {
+        printf("Out of memory\n");
+        free(positions);
+        return 1;
+    }
+    for (int w = 0; w < jobs; ++w) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            // The workers already running stride over the positions by jobs, so with fewer
+            // of them some positions would silently go unsearched
+            perror("fork");
+            for (int started = 0; started < w; ++started) kill(workers[started], SIGTERM);
+            while (wait(NULL) > 0) {}
+            free(workers);
+            free(positions);
+            return 1;
+        }
+        if (pid == 0) {
+            close(result_pipe[0]);
+            run_worker(positions, count, w, jobs, &limits, (size_t)hash_mb, result_pipe[1]);
+            close(result_pipe[1]);
+            _exit(0);
+        }
+        workers[w] = pid;
+    }
+    free(workers);
+    close(result_pipe[1]);
+
+    EpdResult* results = calloc((size_t)count, sizeof(EpdResult));
+    if (results == NULL) {
+        printf("Out of memory\n");
+        close(result_pipe[0]); // Workers fail to write and stop
+        while (wait(NULL) > 0) {}
+        free(positions);
+        return 1;
+    }
+    EpdResult incoming;
+    while (read(result_pipe[0], &incoming, sizeof(incoming)) == (ssize_t)sizeof(incoming)) {
+        if (incoming.index >= 0 && incoming.index < count) results[incoming.index] = incoming;
+    }
+    close(result_pipe[0]);
+    while (wait(NULL) > 0) {}
+
+    int solved = 0, searched = 0;
+    long total_nodes = 0, total_depth = 0, total_solve_ms = 0;
+    unsigned long total_time_ms = 0;
+    printf("\n  #  %-20s %-8s %-8s %8s %6s %12s %10s\n", "id", "result", "move", "ttfc(ms)", "depth", "nodes", "nps");
+    for (int i = 0; i < count; ++i) {
+        const EpdResult* r = &results[i];
+        const char* id = positions[i].id[0] ? positions[i].id : "-";
+        if (!r->valid) {
+            printf("%3d  %-20s %-8s\n", i + 1, id, "invalid");
+            continue;
+        }
+        long nps = r->time_ms > 0 ? (long)(r->nodes * 1000 / r->time_ms) : 0;
+        printf("%3d  %-20s %-8s %-8s %8d %6d %12ld %10ld\n", i + 1, id, r->solved ? "solved" : "failed",
+               r->move_san, r->solved_at_ms, r->depth, r->nodes, nps);
+        searched++;
+        total_nodes += r->nodes;
+        total_depth += r->depth;
+        total_time_ms += r->time_ms;
+        if (r->solved) { solved++; total_solve_ms += r->solved_at_ms; }
+    }
+
+    printf("\nSolved: %d / %d (%.1f%%)\n", solved, searched, searched ? 100.0 * solved / searched : 0.0);
+    if (solved > 0) printf("Average time to solution: %.0f ms\n", (double)total_solve_ms / solved);
+    if (searched > 0) printf("Average depth: %.2f\n", (double)total_depth / searched);
+    printf("Total nodes: %ld\n", total_nodes);
+    printf("NPS per worker: %.0f\n", total_time_ms ? (double)total_nodes * 1000.0 / total_time_ms : 0.0);
+
+    free(results);
+    free(positions);
+    return 0;
+}
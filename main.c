@@ -1,47 +1,60 @@
 #include <stdio.h>
 #include <SDL2/SDL.h>
 #include <stdlib.h>
+#include <string.h>
 #include "board.h"
 #include "sdl_graphics.h"
 #include "rules.h"
 #include "ai.h"
-
-typedef enum {
-    GAME_STATE_PLAYING, GAME_STATE_CHECKMATE_WHITE_WINS, GAME_STATE_CHECKMATE_BLACK_WINS,
-    GAME_STATE_STALEMATE, GAME_STATE_DRAW_INSUFFICIENT_MATERIAL, GAME_STATE_DRAW_50_MOVE_RULE,
-    GAME_STATE_DRAW_THREEFOLD_REPETITION
-} GameState;
-
+#include "book.h"
+#include "tablebase.h"
+#include "nnue.h"
+#include "tablemem.h"
+#include "notation.h"
+#include "pgn.h"
+
+// The game on screen and the engine playing it
+Game game;
+AIEngine ai_engine;
 GameState current_game_state = GAME_STATE_PLAYING;
 SDL_Rect play_again_button_rect;
 
 PieceColor human_player_color = WHITE;
 PieceColor ai_player_color = BLACK;
 
+// Position every new game starts from; START_POSITION_FEN unless --fen was given
+const char* start_fen = START_POSITION_FEN;
+
+// AI clock (--clock, --inc, --movestogo); without --clock the AI thinks a fixed time per move
+#define AI_FIXED_MOVE_TIME_MS 2000
+#define AI_MOVE_OVERHEAD_MS 30
+int ai_clock_base_ms = 0;          // 0 = no clock
+int ai_clock_increment_ms = 0;
+int ai_clock_moves_per_period = 0; // 0 = sudden death
+int ai_clock_left_ms = 0;
+int ai_moves_played = 0;
+
 void check_game_over_conditions() {
     if (current_game_state != GAME_STATE_PLAYING) return;
 
-    bool no_legal_moves = !has_any_legal_moves(game_board, current_player_turn);
-    if (no_legal_moves) {
-        if (is_king_in_check(game_board, current_player_turn)) {
-            current_game_state = (current_player_turn == WHITE) ? GAME_STATE_CHECKMATE_BLACK_WINS : GAME_STATE_CHECKMATE_WHITE_WINS;
-        } else {
-            current_game_state = GAME_STATE_STALEMATE;
-        }
-    } else if (is_draw_by_insufficient_material(game_board)) {
-        current_game_state = GAME_STATE_DRAW_INSUFFICIENT_MATERIAL;
-    } else if (halfmove_clock >= 100) {
-        current_game_state = GAME_STATE_DRAW_50_MOVE_RULE;
-    }
+    current_game_state = get_game_state(&game.pos);
 
     if (current_game_state != GAME_STATE_PLAYING) {
-        printf("Game Over! Result: %d (Current turn was for: %s)\n", current_game_state, current_player_turn == WHITE ? "White" : "Black");
+        printf("Game Over! Result: %d (Current turn was for: %s)\n", current_game_state, game.pos.turn == WHITE ? "White" : "Black");
     }
 }
 
+// Centres the "Play Again" button for the current window size
+void layout_play_again_button() {
+    int button_w = 180, button_h = 50;
+    play_again_button_rect = (SDL_Rect){(SCREEN_WIDTH - button_w) / 2, SCREEN_HEIGHT / 2 + 60, button_w, button_h};
+}
+
 void init_game_elements() {
-    init_board();
+    if (!load_fen(&game, start_fen)) init_board(&game); // start_fen is validated in main, this is only a safety net
     current_game_state = GAME_STATE_PLAYING;
+    ai_clock_left_ms = ai_clock_base_ms;
+    ai_moves_played = 0;
 
     human_player_color = WHITE;
     ai_player_color = BLACK;
@@ -49,52 +62,74 @@ void init_game_elements() {
            human_player_color == WHITE ? "White" : "Black",
            ai_player_color == WHITE ? "White" : "Black");
 
-    int button_w = 180, button_h = 50;
-    play_again_button_rect = (SDL_Rect){(SCREEN_WIDTH - button_w) / 2, SCREEN_HEIGHT / 2 + 60, button_w, button_h};
+    layout_play_again_button();
+    check_game_over_conditions(); // A custom start position may already be finished
 }
 
-void execute_the_move(int from_r, int from_c, int to_r, int to_c, PieceType promotion_piece_type) {
-    Piece piece_to_move_snapshot = game_board[from_r][from_c];
-    Piece piece_at_dest_snapshot = game_board[to_r][to_c];
-    int prev_ep_r = en_passant_target_r;
-    int prev_ep_c = en_passant_target_c;
-    int prev_hm_clk = halfmove_clock;
+void print_usage(const char* program_name) {
+    printf("Usage: %s [--fen \"<FEN>\"] [--stats-json <file>] [--book <file.bin>] [--tb-path <dir>] [--nnue <file>] [--hash <MB>]\n"
+           "       [--clock <seconds> [--inc <seconds>] [--movestogo <moves>]]\n", program_name);
+    printf("  --fen <FEN>          Start the game from the given position instead of the initial one\n");
+    printf("  --stats-json <file>  Append the AI's per-depth search statistics to file as JSON lines\n");
+    printf("  --book <file.bin>    Let the AI play from a Polyglot opening book\n");
+    printf("  --tb-path <dir>      Use the endgame tablebases in dir (built with tbgen)\n");
+    printf("  --nnue <file>        Let the AI evaluate with an NNUE network file\n");
+    printf("  --hash <MB>          Size of the AI's transposition table in MB (default %d)\n", TT_DEFAULT_SIZE_MB);
+    printf("  --clock <seconds>    Give the AI a game clock instead of %d ms per move\n", AI_FIXED_MOVE_TIME_MS);
+    printf("  --inc <seconds>      Increment added to the AI clock after each of its moves\n");
+    printf("  --movestogo <moves>  Moves per time control; the clock is topped up by --clock after each period\n");
+}
 
-    bool is_castling_kingside = false, is_castling_queenside = false;
-    if (piece_to_move_snapshot.type == KING && abs(to_c - from_c) == 2) {
-        if (to_c > from_c) is_castling_kingside = true; else is_castling_queenside = true;
-    }
-    bool is_ep_capture = false; int ep_cap_r = -1, ep_cap_c = -1;
-    if (piece_to_move_snapshot.type == PAWN && to_r == prev_ep_r && to_c == prev_ep_c && piece_at_dest_snapshot.type == EMPTY) {
-        is_ep_capture = true; ep_cap_r = from_r; ep_cap_c = to_c;
+int main(int argc, char* args[]) {
+    FILE* stats_file = NULL;
+    const char* book_path = NULL;
+    long hash_mb = TT_DEFAULT_SIZE_MB;
+    ai_engine_init(&ai_engine, TT_DEFAULT_SIZE_MB); // Before the options, which may set its statistics output
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(args[i], "--fen") == 0 && i + 1 < argc) {
+            start_fen = args[++i];
+        } else if (strncmp(args[i], "--fen=", 6) == 0) {
+            start_fen = args[i] + 6;
+        } else if (strcmp(args[i], "--stats-json") == 0 && i + 1 < argc) {
+            stats_file = fopen(args[++i], "a");
+            if (stats_file == NULL) {
+                printf("Could not open stats file %s\n", args[i]);
+                return 1;
+            }
+            ai_set_stats_output(&ai_engine, stats_file);
+        } else if (strcmp(args[i], "--book") == 0 && i + 1 < argc) {
+            book_path = args[++i];
+        } else if (strcmp(args[i], "--tb-path") == 0 && i + 1 < argc) {
+            tb_init(args[++i]);
+        } else if (strcmp(args[i], "--nnue") == 0 && i + 1 < argc) {
+            if (!nnue_load(args[++i])) return 1;
+        } else if (strcmp(args[i], "--hash") == 0 && i + 1 < argc) {
+            hash_mb = atol(args[++i]);
+        } else if (strcmp(args[i], "--clock") == 0 && i + 1 < argc) {
+            ai_clock_base_ms = (int)(atof(args[++i]) * 1000);
+        } else if (strcmp(args[i], "--inc") == 0 && i + 1 < argc) {
+            ai_clock_increment_ms = (int)(atof(args[++i]) * 1000);
+        } else if (strcmp(args[i], "--movestogo") == 0 && i + 1 < argc) {
+            ai_clock_moves_per_period = atoi(args[++i]);
+        } else {
+            print_usage(args[0]);
+            return 1;
+        }
     }
-
-    record_move(from_r, from_c, to_r, to_c, piece_to_move_snapshot, piece_at_dest_snapshot,
-                promotion_piece_type, is_castling_kingside, is_castling_queenside,
-                is_ep_capture, ep_cap_r, ep_cap_c, prev_ep_r, prev_ep_c, prev_hm_clk);
-
-    if (piece_to_move_snapshot.type == PAWN || piece_at_dest_snapshot.type != EMPTY) halfmove_clock = 0;
-    else halfmove_clock++;
-
-    move_piece_on_board(from_r, from_c, to_r, to_c);
-
-    if (is_castling_kingside) move_piece_on_board(from_r, 7, from_r, 5);
-    else if (is_castling_queenside) move_piece_on_board(from_r, 0, from_r, 3);
-    if (is_ep_capture) game_board[ep_cap_r][ep_cap_c].type = EMPTY;
-
-    if (promotion_piece_type != EMPTY) {
-        game_board[to_r][to_c].type = promotion_piece_type;
-        if(current_move_number > 0) move_history[current_move_number-1].promotion_to = promotion_piece_type;
+    if (!load_fen(&game, start_fen)) {
+        printf("Invalid FEN: %s\n", start_fen);
+        return 1;
     }
-
-    clear_en_passant_target();
-    if (piece_to_move_snapshot.type == PAWN && abs(to_r - from_r) == 2) {
-        set_en_passant_target((piece_to_move_snapshot.color == WHITE) ? to_r + 1 : to_r - 1, to_c);
+    if (book_path && !book_open(book_path)) return 1;
+    if (hash_mb != TT_DEFAULT_SIZE_MB) {
+        if (hash_mb < 1) {
+            printf("Invalid hash size: %ld MB\n", hash_mb);
+            return 1;
+        }
+        tablemem_set_budget_mb((size_t)hash_mb);
+        if (!ai_engine_set_hash(&ai_engine, (size_t)hash_mb)) return 1;
     }
-}
-
-int main(int argc, char* args[]) {
-    (void)argc; (void)args;
+    tablemem_report(stdout);
 
     if (!init_sdl_graphics() || !load_media()) {
         printf("Initialization or media loading failed.\n");
@@ -109,34 +144,42 @@ int main(int argc, char* args[]) {
     bool button_hovered = false;
     SDL_Point mouse_point = {0,0};
 
-    printf("Game started. Human (%s) vs AI (%s). Press 'U' to Undo.\n",
+    printf("Game started. Human (%s) vs AI (%s). Press 'U' to Undo, 'R' to Redo, 'F' to print the FEN, 'P' to print the game as PGN.\n",
            human_player_color == WHITE ? "White" : "Black",
            ai_player_color == WHITE ? "White" : "Black");
 
     while (!quit) {
         button_hovered = false;
 
-        if (current_game_state == GAME_STATE_PLAYING && current_player_turn == ai_player_color) {
+        if (current_game_state == GAME_STATE_PLAYING && game.pos.turn == ai_player_color) {
             AIMove ai_chosen_move;
- int ai_time_limit_ms = 2000;
-             if (ai_select_move(game_board, ai_player_color, &ai_chosen_move, ai_time_limit_ms)) {
-                printf("AI %s moves: [%d,%d] to [%d,%d]",
-                       ai_player_color == WHITE ? "White" : "Black",
-                       ai_chosen_move.from_r, ai_chosen_move.from_c,
-                       ai_chosen_move.to_r, ai_chosen_move.to_c);
-                if (ai_chosen_move.promotion_to != EMPTY) {
-                    printf(" promoting to %s", get_piece_type_string(ai_chosen_move.promotion_to));
-                }
-                printf("\n");
+            bool ai_found_move;
+            if (ai_clock_base_ms > 0) {
+                int moves_to_go = ai_clock_moves_per_period ? ai_clock_moves_per_period - ai_moves_played % ai_clock_moves_per_period : 0;
+                TimeControl clock = {ai_clock_left_ms, ai_clock_increment_ms, moves_to_go, AI_MOVE_OVERHEAD_MS};
+                unsigned int think_start = ai_get_ticks_ms();
+                ai_found_move = ai_select_move_clocked(&ai_engine, &game.pos, &ai_chosen_move, &clock);
+                ai_clock_left_ms -= (int)(ai_get_ticks_ms() - think_start);
+                if (ai_clock_left_ms < 0) printf("AI overstepped its clock by %d ms\n", -ai_clock_left_ms);
+                ai_clock_left_ms += ai_clock_increment_ms;
+                if (ai_clock_moves_per_period && ++ai_moves_played % ai_clock_moves_per_period == 0) ai_clock_left_ms += ai_clock_base_ms;
+                printf("AI clock: %.1fs\n", ai_clock_left_ms / 1000.0);
+            } else {
+                ai_found_move = ai_select_move(&ai_engine, &game.pos, &ai_chosen_move, AI_FIXED_MOVE_TIME_MS);
+            }
+            if (ai_found_move) {
+                char san[MAX_SAN_LENGTH];
+                move_to_full_san(&game.pos, &ai_chosen_move, san, sizeof(san));
+                printf("AI %s moves: %s\n", ai_player_color == WHITE ? "White" : "Black", san);
 
-                execute_the_move(ai_chosen_move.from_r, ai_chosen_move.from_c,
+                execute_move(&game, ai_chosen_move.from_r, ai_chosen_move.from_c,
                                ai_chosen_move.to_r, ai_chosen_move.to_c,
                                ai_chosen_move.promotion_to);
 
-                switch_player_turn();
+                switch_player_turn(&game.pos);
                 printf("Turn: Human (%s)", human_player_color == WHITE ? "W":"B");
-                if (is_king_in_check(game_board, current_player_turn)) printf(" - Human is in CHECK!");
-                printf(" | Moves: %d | HM Clock: %d\n", current_move_number, halfmove_clock);
+                if (is_king_in_check(game.pos.board, game.pos.turn)) printf(" - Human is in CHECK!");
+                printf(" | Moves: %d | HM Clock: %d\n", game.move_count, game.pos.halfmove_clock);
                 check_game_over_conditions();
             } else {
                 printf("AI has no moves. Game should be over. State: %d\n", current_game_state);
@@ -145,16 +188,19 @@ int main(int argc, char* args[]) {
 
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT) quit = 1;
-            else if (e.type == SDL_MOUSEMOTION) {
+            else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                handle_window_resize(e.window.data1, e.window.data2);
+                layout_play_again_button();
+            } else if (e.type == SDL_MOUSEMOTION) {
                 mouse_point.x = e.motion.x; mouse_point.y = e.motion.y;
                 if (current_game_state != GAME_STATE_PLAYING && SDL_PointInRect(&mouse_point, &play_again_button_rect)) {
                     button_hovered = true;
                 }
             } else if (e.type == SDL_KEYDOWN) {
                 if (e.key.keysym.sym == SDLK_u) {
-                    if (current_move_number > 0) {
-                        if (undo_last_move()) {
-                            printf("Undo successful. Player to move: %s\n", current_player_turn == WHITE ? "W" : "B");
+                    if (game.move_count > 0) {
+                        if (undo_last_move(&game)) {
+                            printf("Undo successful. Player to move: %s\n", game.pos.turn == WHITE ? "W" : "B");
                             piece_is_selected = 0; selected_piece_r = -1; selected_piece_c = -1;
                             current_game_state = GAME_STATE_PLAYING;
                             check_game_over_conditions();
@@ -162,6 +208,23 @@ int main(int argc, char* args[]) {
                     } else {
                         printf("No moves to undo.\n");
                     }
+                } else if (e.key.keysym.sym == SDLK_r) {
+                    if (redo_move(&game)) {
+                        printf("Redo successful. Player to move: %s\n", game.pos.turn == WHITE ? "W" : "B");
+                        piece_is_selected = 0; selected_piece_r = -1; selected_piece_c = -1;
+                        check_game_over_conditions();
+                    } else {
+                        printf("No moves to redo.\n");
+                    }
+                } else if (e.key.keysym.sym == SDLK_f) {
+                    char fen[MAX_FEN_LENGTH];
+                    get_fen(&game, fen, sizeof(fen));
+                    printf("FEN: %s\n", fen);
+                } else if (e.key.keysym.sym == SDLK_p) {
+                    PGNTag tags[2] = {{"White", ""}, {"Black", ""}};
+                    snprintf(tags[0].value, sizeof(tags[0].value), "%s", human_player_color == WHITE ? "Human" : "AI");
+                    snprintf(tags[1].value, sizeof(tags[1].value), "%s", human_player_color == BLACK ? "Human" : "AI");
+                    pgn_write_game(stdout, &game, tags, 2, pgn_result_string(current_game_state));
                 }
             } else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
                 mouse_point.x = e.button.x; mouse_point.y = e.button.y;
@@ -177,14 +240,14 @@ int main(int argc, char* args[]) {
                     continue;
                 }
 
-                if (current_player_turn == human_player_color) {
+                if (game.pos.turn == human_player_color) {
                     int clicked_c = mouse_point.x / SQUARE_SIZE;
                     int clicked_r = mouse_point.y / SQUARE_SIZE;
 
                     if (is_square_on_board(clicked_r, clicked_c)) {
                         if (!piece_is_selected) {
-                            if (game_board[clicked_r][clicked_c].type != EMPTY &&
-                                game_board[clicked_r][clicked_c].color == human_player_color) {
+                            if (game.pos.board[clicked_r][clicked_c].type != EMPTY &&
+                                game.pos.board[clicked_r][clicked_c].color == human_player_color) {
                                 piece_is_selected = 1;
                                 selected_piece_r = clicked_r; selected_piece_c = clicked_c;
                             }
@@ -195,8 +258,8 @@ int main(int argc, char* args[]) {
                             if (selected_piece_r == dest_r && selected_piece_c == dest_c) {
                                 piece_is_selected = 0; selected_piece_r = -1; selected_piece_c = -1;
                             } else {
-                                Piece piece_to_move = game_board[selected_piece_r][selected_piece_c];
-                                Piece target_piece = game_board[dest_r][dest_c];
+                                Piece piece_to_move = game.pos.board[selected_piece_r][selected_piece_c];
+                                Piece target_piece = game.pos.board[dest_r][dest_c];
 
                                 if (target_piece.type != EMPTY && target_piece.color == human_player_color) {
                                     selected_piece_r = dest_r; selected_piece_c = dest_c;
@@ -205,14 +268,14 @@ int main(int argc, char* args[]) {
                                     if (piece_to_move.type == PAWN &&
                                         ((piece_to_move.color == WHITE && dest_r == 0) ||
                                          (piece_to_move.color == BLACK && dest_r == 7))) {
-                                        if(is_move_legal(game_board, selected_piece_r, selected_piece_c, dest_r, dest_c, human_player_color)){
+                                        if(is_move_legal(&game.pos, selected_piece_r, selected_piece_c, dest_r, dest_c, human_player_color)){
                                             human_promo_choice = QUEEN;
                                             printf("Human pawn promoting to Queen.\n");
                                         }
                                     }
 
-                                    if (is_move_legal(game_board, selected_piece_r, selected_piece_c, dest_r, dest_c, human_player_color)) {
-                                        execute_the_move(selected_piece_r, selected_piece_c, dest_r, dest_c, human_promo_choice);
+                                    if (is_move_legal(&game.pos, selected_piece_r, selected_piece_c, dest_r, dest_c, human_player_color)) {
+                                        execute_move(&game, selected_piece_r, selected_piece_c, dest_r, dest_c, human_promo_choice);
                                         move_made_by_human = true;
                                     } else {
                                         printf("Human: Illegal move attempt.\n");
@@ -222,10 +285,10 @@ int main(int argc, char* args[]) {
                             }
 
                             if (move_made_by_human) {
-                                switch_player_turn();
+                                switch_player_turn(&game.pos);
                                 printf("Turn: AI (%s)", ai_player_color == WHITE ? "W":"B");
-                                if (is_king_in_check(game_board, current_player_turn)) printf(" - AI is in CHECK!");
-                                printf(" | Moves:%d | HM Clock: %d\n", current_move_number, halfmove_clock);
+                                if (is_king_in_check(game.pos.board, game.pos.turn)) printf(" - AI is in CHECK!");
+                                printf(" | Moves:%d | HM Clock: %d\n", game.move_count, game.pos.halfmove_clock);
                                 check_game_over_conditions();
                             }
                         }
@@ -240,10 +303,10 @@ int main(int argc, char* args[]) {
         SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND); // Enable blending for transparency
 
         render_board_squares();
-        if (piece_is_selected && selected_piece_r != -1 && current_game_state == GAME_STATE_PLAYING && current_player_turn == human_player_color) {
+        if (piece_is_selected && selected_piece_r != -1 && current_game_state == GAME_STATE_PLAYING && game.pos.turn == human_player_color) {
             render_square_highlight(selected_piece_r, selected_piece_c, 255, 255, 0, 100);
         }
-        render_pieces();
+        render_pieces(game.pos.board);
 
         if (current_game_state != GAME_STATE_PLAYING) {
             // Draw semi-transparent background
@@ -284,5 +347,8 @@ int main(int argc, char* args[]) {
     }
 
     close_sdl_graphics();
+    ai_engine_free(&ai_engine);
+    game_free(&game);
+    if (stats_file) fclose(stats_file);
     return 0;
 }
\ No newline at end of file
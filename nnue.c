@@ -0,0 +1,294 @@
+#define _POSIX_C_SOURCE 200809L // For mmap() and fstat()
+#include "nnue.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(NNUE_NO_SIMD)
+#define NNUE_KERNEL "scalar"
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NNUE_KERNEL "sse2"
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define NNUE_KERNEL "neon"
+#else
+#define NNUE_KERNEL "scalar"
+#endif
+
+#define NNUE_FILE_SIZE (NNUE_HEADER_SIZE + \
+    NNUE_L1 * 2 + (size_t)NNUE_INPUTS * NNUE_L1 * 2 + \
+    NNUE_L2 * 4 + NNUE_L2 * 2 * NNUE_L1 + \
+    NNUE_L3 * 4 + NNUE_L3 * NNUE_L2 + \
+    4 + NNUE_L3)
+
+// Views into the mapped file; every array starts at a multiple of its element size
+static struct {
+    void* mapping; // NULL: no network loaded
+    size_t size;
+    const int16_t* feature_biases;
+    const int16_t* feature_weights; // [NNUE_INPUTS][NNUE_L1]
+    const int32_t* biases1;
+    const int8_t* weights1;         // [NNUE_L2][2 * NNUE_L1]
+    const int32_t* biases2;
+    const int8_t* weights2;         // [NNUE_L3][NNUE_L2]
+    const int32_t* output_bias;
+    const int8_t* output_weights;   // [NNUE_L3]
+} net;
+
+static uint32_t read_u32_le(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool nnue_load(const char* path) {
+    nnue_unload();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open network file %s\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != NNUE_FILE_SIZE) {
+        printf("Network file %s does not have the expected size (%zu bytes)\n", path, (size_t)NNUE_FILE_SIZE);
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, NNUE_FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (data == MAP_FAILED) {
+        printf("Could not map network file %s\n", path);
+        return false;
+    }
+    const unsigned char* header = data;
+    if (memcmp(header, NNUE_FILE_MAGIC, 8) != 0 || read_u32_le(header + 8) != NNUE_INPUTS || read_u32_le(header + 12) != NNUE_L1 ||
+        read_u32_le(header + 16) != NNUE_L2 || read_u32_le(header + 20) != NNUE_L3) {
+        printf("Network file %s is not a %d-%dx2-%d-%d-1 network\n", path, NNUE_INPUTS, NNUE_L1, NNUE_L2, NNUE_L3);
+        munmap(data, NNUE_FILE_SIZE);
+        return false;
+    }
+
+    const unsigned char* p = header + NNUE_HEADER_SIZE;
+    net.feature_biases = (const int16_t*)p;  p += NNUE_L1 * 2;
+    net.feature_weights = (const int16_t*)p; p += (size_t)NNUE_INPUTS * NNUE_L1 * 2;
+    net.biases1 = (const int32_t*)p;         p += NNUE_L2 * 4;
+    net.weights1 = (const int8_t*)p;         p += NNUE_L2 * 2 * NNUE_L1;
+    net.biases2 = (const int32_t*)p;         p += NNUE_L3 * 4;
+    net.weights2 = (const int8_t*)p;         p += NNUE_L3 * NNUE_L2;
+    net.output_bias = (const int32_t*)p;     p += 4;
+    net.output_weights = (const int8_t*)p;
+    net.mapping = data;
+    net.size = NNUE_FILE_SIZE;
+    return true;
+}
+
+void nnue_unload(void) {
+    if (net.mapping) munmap(net.mapping, net.size);
+    memset(&net, 0, sizeof(net));
+}
+
+bool nnue_is_loaded(void) {
+    return net.mapping != NULL;
+}
+
+const char* nnue_kernel_name(void) {
+    return NNUE_KERNEL;
+}
+
+// --- Kernels ---
+
+// acc += row (sign 1) or acc -= row (sign -1), NNUE_L1 values
+static void add_feature_row(int16_t* acc, const int16_t* row, int sign) {
+#if defined(NNUE_NO_SIMD)
+    for (int i = 0; i < NNUE_L1; ++i) acc[i] = (int16_t)(acc[i] + sign * row[i]);
+#elif defined(__AVX2__)
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w = _mm256_loadu_si256((const __m256i*)(row + i));
+        a = (sign > 0) ? _mm256_add_epi16(a, w) : _mm256_sub_epi16(a, w);
+        _mm256_store_si256((__m256i*)(acc + i), a);
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_L1; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w = _mm_loadu_si128((const __m128i*)(row + i));
+        a = (sign > 0) ? _mm_add_epi16(a, w) : _mm_sub_epi16(a, w);
+        _mm_store_si128((__m128i*)(acc + i), a);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (int i = 0; i < NNUE_L1; i += 8) {
+        int16x8_t a = vld1q_s16(acc + i), w = vld1q_s16(row + i);
+        vst1q_s16(acc + i, (sign > 0) ? vaddq_s16(a, w) : vsubq_s16(a, w));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; ++i) acc[i] = (int16_t)(acc[i] + sign * row[i]);
+#endif
+}
+
+// out[i] = clamp(in[i], 0, 127) for NNUE_L1 values
+static void clipped_relu_accumulator(const int16_t* in, uint8_t* out) {
+#if defined(NNUE_NO_SIMD)
+    for (int i = 0; i < NNUE_L1; ++i) out[i] = (uint8_t)(in[i] < 0 ? 0 : in[i] > 127 ? 127 : in[i]);
+#elif defined(__AVX2__)
+    const __m256i max_value = _mm256_set1_epi8(127);
+    for (int i = 0; i < NNUE_L1; i += 32) {
+        __m256i packed = _mm256_packus_epi16(_mm256_load_si256((const __m256i*)(in + i)), _mm256_load_si256((const __m256i*)(in + i + 16)));
+        packed = _mm256_permute4x64_epi64(_mm256_min_epu8(packed, max_value), 0xD8); // Undo the per-lane interleave of packus
+        _mm256_storeu_si256((__m256i*)(out + i), packed);
+    }
+#elif defined(__SSE2__)
+    const __m128i max_value = _mm_set1_epi8(127);
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m128i packed = _mm_packus_epi16(_mm_load_si128((const __m128i*)(in + i)), _mm_load_si128((const __m128i*)(in + i + 8)));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_min_epu8(packed, max_value));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t max_value = vdupq_n_u8(127);
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        uint8x16_t packed = vcombine_u8(vqmovun_s16(vld1q_s16(in + i)), vqmovun_s16(vld1q_s16(in + i + 8)));
+        vst1q_u8(out + i, vminq_u8(packed, max_value));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; ++i) out[i] = (uint8_t)(in[i] < 0 ? 0 : in[i] > 127 ? 127 : in[i]);
+#endif
+}
+
+// out[o] = biases[o] + sum of in[i] * weights[o][i]; num_inputs is a multiple of 32 and the
+// inputs are at most 127, so pairs of products fit in int16
+static void affine(const uint8_t* in, int num_inputs, const int8_t* weights, const int32_t* biases, int32_t* out, int num_outputs) {
+    for (int o = 0; o < num_outputs; ++o) {
+        const int8_t* row = weights + (size_t)o * num_inputs;
+#if defined(NNUE_NO_SIMD)
+        int32_t sum = biases[o];
+        for (int i = 0; i < num_inputs; ++i) sum += in[i] * row[i];
+#elif defined(__AVX2__)
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i acc = _mm256_setzero_si256();
+        for (int i = 0; i < num_inputs; i += 32) {
+            __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(in + i)), _mm256_loadu_si256((const __m256i*)(row + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(products, ones));
+        }
+        __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+        int32_t sum = biases[o] + _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (int i = 0; i < num_inputs; i += 16) { // Widen to int16: SSE2 has no u8 x i8 multiply
+            __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i w = _mm_loadu_si128((const __m128i*)(row + i));
+            __m128i w_lo = _mm_srai_epi16(_mm_unpacklo_epi8(w, w), 8), w_hi = _mm_srai_epi16(_mm_unpackhi_epi8(w, w), 8);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), w_lo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), w_hi));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+        int32_t sum = biases[o] + _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        int32x4_t acc = vdupq_n_s32(0);
+        for (int i = 0; i < num_inputs; i += 16) {
+            int8x16_t x = vreinterpretq_s8_u8(vld1q_u8(in + i)), w = vld1q_s8(row + i);
+            int16x8_t products = vmull_s8(vget_low_s8(x), vget_low_s8(w));
+            products = vmlal_s8(products, vget_high_s8(x), vget_high_s8(w));
+            acc = vpadalq_s16(acc, products);
+        }
+        int32_t sum = biases[o] + vaddvq_s32(acc);
+#else
+        int32_t sum = biases[o];
+        for (int i = 0; i < num_inputs; ++i) sum += in[i] * row[i];
+#endif
+        out[o] = sum;
+    }
+}
+
+static void clipped_relu_layer(const int32_t* in, uint8_t* out, int n) {
+    for (int i = 0; i < n; ++i) {
+        int32_t v = in[i] >> NNUE_WEIGHT_SHIFT;
+        out[i] = (uint8_t)(v < 0 ? 0 : v > 127 ? 127 : v);
+    }
+}
+
+// --- Features ---
+
+static int perspective_index(PieceColor color) {
+    return color == WHITE ? 0 : 1;
+}
+
+// Square index as seen from perspective: Black's side is flipped so its pieces start on
+// the same squares as White's. Row 0 is rank 8, as on the board.
+static int oriented_square(PieceColor perspective, int r, int c) {
+    return (perspective == WHITE ? r : 7 - r) * 8 + c;
+}
+
+static const int16_t* feature_row(PieceColor perspective, int king_square, Piece p, int r, int c) {
+    int kind = (p.type - PAWN) * 2 + (p.color == perspective ? 0 : 1);
+    size_t feature = ((size_t)king_square * NNUE_PIECE_KINDS + kind) * 64 + oriented_square(perspective, r, c);
+    return net.feature_weights + feature * NNUE_L1;
+}
+
+static bool is_feature_piece(Piece p) {
+    return p.type != EMPTY && p.type != KING;
+}
+
+static int king_square(const Position* pos, PieceColor perspective) {
+    for (int r = 0; r < 8; ++r)
+        for (int c = 0; c < 8; ++c)
+            if (pos->board[r][c].type == KING && pos->board[r][c].color == perspective) return oriented_square(perspective, r, c);
+    return 0; // Only in positions the search never produces
+}
+
+static void refresh_perspective(int16_t* acc, const Position* pos, PieceColor perspective) {
+    memcpy(acc, net.feature_biases, NNUE_L1 * sizeof(int16_t));
+    int king = king_square(pos, perspective);
+    for (int r = 0; r < 8; ++r)
+        for (int c = 0; c < 8; ++c)
+            if (is_feature_piece(pos->board[r][c])) add_feature_row(acc, feature_row(perspective, king, pos->board[r][c], r, c), 1);
+}
+
+void nnue_refresh(NNUEAccumulator* acc, const Position* pos) {
+    refresh_perspective(acc->values[0], pos, WHITE);
+    refresh_perspective(acc->values[1], pos, BLACK);
+}
+
+void nnue_update(NNUEAccumulator* child, const NNUEAccumulator* parent, const Position* before, const Position* after) {
+    static const PieceColor perspectives[2] = {WHITE, BLACK};
+    for (int i = 0; i < 2; ++i) {
+        PieceColor perspective = perspectives[i];
+        int16_t* acc = child->values[i];
+        int king = king_square(after, perspective);
+        if (king != king_square(before, perspective)) {
+            refresh_perspective(acc, after, perspective);
+            continue;
+        }
+        memcpy(acc, parent->values[i], NNUE_L1 * sizeof(int16_t));
+        for (int r = 0; r < 8; ++r) {
+            for (int c = 0; c < 8; ++c) {
+                Piece old_piece = before->board[r][c], new_piece = after->board[r][c];
+                if (old_piece.type == new_piece.type && old_piece.color == new_piece.color) continue;
+                if (is_feature_piece(old_piece)) add_feature_row(acc, feature_row(perspective, king, old_piece, r, c), -1);
+                if (is_feature_piece(new_piece)) add_feature_row(acc, feature_row(perspective, king, new_piece, r, c), 1);
+            }
+        }
+    }
+}
+
+int nnue_evaluate(const NNUEAccumulator* acc, PieceColor side_to_move) {
+    _Alignas(64) uint8_t input[2 * NNUE_L1];
+    int32_t sums[NNUE_L2 > NNUE_L3 ? NNUE_L2 : NNUE_L3];
+    _Alignas(64) uint8_t hidden1[NNUE_L2], hidden2[NNUE_L3];
+    clipped_relu_accumulator(acc->values[perspective_index(side_to_move)], input);
+    clipped_relu_accumulator(acc->values[1 - perspective_index(side_to_move)], input + NNUE_L1);
+    affine(input, 2 * NNUE_L1, net.weights1, net.biases1, sums, NNUE_L2);
+    clipped_relu_layer(sums, hidden1, NNUE_L2);
+    affine(hidden1, NNUE_L2, net.weights2, net.biases2, sums, NNUE_L3);
+    clipped_relu_layer(sums, hidden2, NNUE_L3);
+    int32_t output;
+    affine(hidden2, NNUE_L3, net.output_weights, net.output_bias, &output, 1);
+    return output / NNUE_OUTPUT_SCALE;
+}
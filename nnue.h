@@ -0,0 +1,58 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+
+// --- NNUE Evaluation ---
+// Optional neural network evaluation, used instead of the material + piece-square score
+// while a network is loaded. The inputs are HalfKP features: for each side (perspective),
+// one per (own king square, non-king piece, square), seen from that side so both halves
+// share weights. The first layer's output for a position (the accumulator) only changes
+// in the few inputs a move touches, so the search updates it per move instead of
+// recomputing it; three small int8 layers turn it into a score. Kernels are chosen at
+// compile time (AVX2, SSE2, NEON, or scalar with -DNNUE_NO_SIMD or elsewhere); the release
+// build's per -march variants pick the best one for the running CPU.
+//
+// The network file is memory-mapped read-only and shared by every engine and thread of the
+// process: a 64-byte header (NNUE_FILE_MAGIC, then the four layer sizes as little-endian
+// uint32, zero padded), followed by the little-endian parameters in this order:
+//   int16 feature biases[NNUE_L1], int16 feature weights[NNUE_INPUTS][NNUE_L1],
+//   int32 biases[NNUE_L2], int8 weights[NNUE_L2][2 * NNUE_L1],
+//   int32 biases[NNUE_L3], int8 weights[NNUE_L3][NNUE_L2],
+//   int32 output bias, int8 output weights[NNUE_L3]
+// Hidden layer outputs are (sum >> NNUE_WEIGHT_SHIFT) clipped to 0..127, the first one's
+// inputs the accumulator clipped to 0..127 (side to move first); the output divided by
+// NNUE_OUTPUT_SCALE is the score in centipawns for the side to move.
+
+#define NNUE_FILE_MAGIC "CENNUE01" // 8 bytes, no terminator in the file
+#define NNUE_HEADER_SIZE 64
+#define NNUE_PIECE_KINDS 10 // Pawn to queen, own and enemy
+#define NNUE_INPUTS (64 * NNUE_PIECE_KINDS * 64)
+#define NNUE_L1 256 // Accumulator size per perspective
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_WEIGHT_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+typedef struct {
+    _Alignas(64) int16_t values[2][NNUE_L1]; // [0] from White's side, [1] from Black's
+} NNUEAccumulator;
+
+// Maps and checks the network file. Returns false and leaves no network loaded on any
+// error. nnue_load and nnue_unload may not overlap searches.
+bool nnue_load(const char* path);
+void nnue_unload(void);
+bool nnue_is_loaded(void);
+const char* nnue_kernel_name(void); // "avx2", "sse2", "neon" or "scalar"
+
+// Computes the accumulator of pos from scratch.
+void nnue_refresh(NNUEAccumulator* acc, const Position* pos);
+// The accumulator of after, one move from before (whose accumulator is parent). Only the
+// changed squares are applied; a perspective whose own king moved is refreshed.
+void nnue_update(NNUEAccumulator* child, const NNUEAccumulator* parent, const Position* before, const Position* after);
+// Score of the position in centipawns for side_to_move.
+int nnue_evaluate(const NNUEAccumulator* acc, PieceColor side_to_move);
+
+#endif // NNUE_H
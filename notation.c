@@ -0,0 +1,185 @@
+#include "notation.h"
+#include <stdio.h>
+#include <stdlib.h> // For abs()
+#include <string.h>
+#include "rules.h"
+
+static char piece_letter(PieceType type) {
+    switch (type) {
+        case KNIGHT: return 'N'; case BISHOP: return 'B'; case ROOK: return 'R';
+        case QUEEN:  return 'Q'; case KING:   return 'K'; default:     return '\0';
+    }
+}
+
+void square_to_string(int r, int c, char* out) {
+    out[0] = (char)('a' + c);
+    out[1] = (char)('8' - r);
+    out[2] = '\0';
+}
+
+void move_to_coordinate(const AIMove* move, char* out) {
+    square_to_string(move->from_r, move->from_c, out);
+    square_to_string(move->to_r, move->to_c, out + 2);
+    if (move->promotion_to != EMPTY) {
+        out[4] = (char)(piece_letter(move->promotion_to) - 'A' + 'a');
+        out[5] = '\0';
+    }
+}
+
+void pv_to_coordinates(const AIPrincipalVariation* pv, char* out) {
+    size_t n = 0;
+    out[0] = '\0';
+    for (int i = 0; i < pv->length; ++i) {
+        if (i > 0) out[n++] = ' ';
+        move_to_coordinate(&pv->moves[i], out + n);
+        n += strlen(out + n);
+    }
+}
+
+void move_to_san(const Position* pos, const AIMove* move, char* out, size_t out_size) {
+    const Piece (*board)[8] = pos->board;
+    PieceColor side = pos->turn;
+    Piece mover = board[move->from_r][move->from_c];
+    char san[MAX_SAN_LENGTH];
+    int n = 0;
+    char to_sq[3];
+    square_to_string(move->to_r, move->to_c, to_sq);
+
+    if (mover.type == KING && abs(move->to_c - move->from_c) == 2) {
+        snprintf(out, out_size, "%s", (move->to_c > move->from_c) ? "O-O" : "O-O-O");
+        return;
+    }
+
+    bool is_capture = board[move->to_r][move->to_c].type != EMPTY ||
+                      (mover.type == PAWN && move->from_c != move->to_c); // Diagonal pawn move to an empty square is en passant
+
+    if (mover.type == PAWN) {
+        if (is_capture) {
+            san[n++] = (char)('a' + move->from_c);
+            san[n++] = 'x';
+        }
+        san[n++] = to_sq[0]; san[n++] = to_sq[1];
+        if (move->promotion_to != EMPTY) {
+            san[n++] = '=';
+            san[n++] = piece_letter(move->promotion_to);
+        }
+    } else {
+        san[n++] = piece_letter(mover.type);
+
+        // Disambiguate against other pieces of the same kind that can also reach the target
+        bool ambiguous = false, same_file = false, same_rank = false;
+        for (int r = 0; r < 8; ++r) {
+            for (int c = 0; c < 8; ++c) {
+                if (r == move->from_r && c == move->from_c) continue;
+                if (board[r][c].type != mover.type || board[r][c].color != side) continue;
+                if (!is_move_legal(pos, r, c, move->to_r, move->to_c, side)) continue;
+                ambiguous = true;
+                if (c == move->from_c) same_file = true;
+                if (r == move->from_r) same_rank = true;
+            }
+        }
+        if (ambiguous) {
+            if (!same_file) {
+                san[n++] = (char)('a' + move->from_c);
+            } else if (!same_rank) {
+                san[n++] = (char)('8' - move->from_r);
+            } else {
+                san[n++] = (char)('a' + move->from_c);
+                san[n++] = (char)('8' - move->from_r);
+            }
+        }
+        if (is_capture) san[n++] = 'x';
+        san[n++] = to_sq[0]; san[n++] = to_sq[1];
+    }
+    san[n] = '\0';
+    snprintf(out, out_size, "%s", san);
+}
+
+static PieceType piece_from_letter(char letter) {
+    switch (letter) {
+        case 'N': return KNIGHT; case 'B': return BISHOP; case 'R': return ROOK;
+        case 'Q': return QUEEN;  case 'K': return KING;   default:  return EMPTY;
+    }
+}
+
+void move_to_full_san(const Position* pos, const AIMove* move, char* out, size_t out_size) {
+    char san[MAX_SAN_LENGTH];
+    move_to_san(pos, move, san, sizeof(san));
+    Position after = *pos;
+    position_execute_move(&after, move->from_r, move->from_c, move->to_r, move->to_c, move->promotion_to);
+    switch_player_turn(&after);
+    const char* suffix = "";
+    if (is_king_in_check(after.board, after.turn)) suffix = has_any_legal_moves(&after, after.turn) ? "+" : "#";
+    snprintf(out, out_size, "%s%s", san, suffix);
+}
+
+static bool is_san_annotation(char ch) {
+    return ch == '+' || ch == '#' || ch == '!' || ch == '?';
+}
+
+bool san_to_move(const Position* pos, const char* san, AIMove* move) {
+    char text[MAX_SAN_LENGTH];
+    size_t n = strlen(san);
+    while (n > 0 && is_san_annotation(san[n - 1])) n--;
+    if (n == 0 || n >= sizeof(text)) return false;
+    for (size_t i = 0; i < n; ++i) text[i] = (san[i] == '0') ? 'O' : san[i]; // "0-0" castling
+    text[n] = '\0';
+
+    PieceColor side = pos->turn;
+    if (strcmp(text, "O-O") == 0 || strcmp(text, "O-O-O") == 0) {
+        int home = (side == WHITE) ? 7 : 0;
+        *move = (AIMove){home, 4, home, (n == 3) ? 6 : 2, EMPTY, 0};
+        return pos->board[home][4].type == KING && pos->board[home][4].color == side &&
+               is_move_legal(pos, home, 4, move->to_r, move->to_c, side);
+    }
+
+    const char* s = text;
+    PieceType type = PAWN;
+    if (piece_from_letter(*s) != EMPTY) type = piece_from_letter(*s++);
+    n = strlen(s);
+    PieceType promotion = EMPTY;
+    if (type == PAWN && n >= 3 && s[n - 2] == '=') {
+        promotion = piece_from_letter(s[n - 1]);
+        n -= 2;
+    } else if (type == PAWN && n >= 3 && piece_from_letter(s[n - 1]) != EMPTY) {
+        promotion = piece_from_letter(s[n - 1]);
+        n -= 1;
+    }
+    if (promotion == KING || n < 2) return false;
+
+    // The target square ends the move; before it come optional origin file and rank and 'x'
+    int to_c = s[n - 2] - 'a', to_r = '8' - s[n - 1];
+    if (!is_square_on_board(to_r, to_c)) return false;
+    int from_r = -1, from_c = -1;
+    for (size_t i = 0; i + 2 < n; ++i) {
+        if (s[i] >= 'a' && s[i] <= 'h' && from_c < 0) from_c = s[i] - 'a';
+        else if (s[i] >= '1' && s[i] <= '8' && from_r < 0) from_r = '8' - s[i];
+        else if (s[i] != 'x' && s[i] != '-') return false;
+    }
+
+    int matches = 0;
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            if ((from_r >= 0 && r != from_r) || (from_c >= 0 && c != from_c)) continue;
+            if (pos->board[r][c].type != type || pos->board[r][c].color != side) continue;
+            if (!is_move_legal(pos, r, c, to_r, to_c, side)) continue;
+            *move = (AIMove){r, c, to_r, to_c, promotion, 0};
+            matches++;
+        }
+    }
+    bool promotes = type == PAWN && (to_r == 0 || to_r == 7);
+    return matches == 1 && promotes == (promotion != EMPTY);
+}
+
+bool san_equal(const char* a, const char* b) {
+    size_t len_a = strlen(a), len_b = strlen(b);
+    while (len_a > 0 && is_san_annotation(a[len_a - 1])) len_a--;
+    while (len_b > 0 && is_san_annotation(b[len_b - 1])) len_b--;
+    if (len_a != len_b) return false;
+    for (size_t i = 0; i < len_a; ++i) {
+        char ca = (a[i] == '0') ? 'O' : a[i]; // Accept "0-0" for "O-O"
+        char cb = (b[i] == '0') ? 'O' : b[i];
+        if (ca != cb) return false;
+    }
+    return true;
+}
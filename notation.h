@@ -0,0 +1,37 @@
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include <stddef.h>
+#include "board.h"
+#include "ai.h"
+
+#define MAX_SAN_LENGTH 16 // e.g. "Qh4xe1=Q+" plus terminator, with room to spare
+#define MAX_PV_TEXT_LENGTH (AI_MAX_DEPTH * 6) // AI_MAX_DEPTH moves of up to 5 characters, separated
+
+// Writes the algebraic name of square [r][c] ("e4") into out (at least 3 bytes).
+void square_to_string(int r, int c, char* out);
+
+// Writes a move in coordinate notation ("e2e4", "e7e8q") into out (at least 6 bytes).
+void move_to_coordinate(const AIMove* move, char* out);
+
+// Writes a principal variation as space-separated coordinate moves ("e2e4 e7e5 g1f3") into
+// out (at least MAX_PV_TEXT_LENGTH bytes).
+void pv_to_coordinates(const AIPrincipalVariation* pv, char* out);
+
+// Writes the Standard Algebraic Notation of a legal move for the side to move in pos,
+// without the check/mate suffix.
+void move_to_san(const Position* pos, const AIMove* move, char* out, size_t out_size);
+
+// move_to_san plus "+" when the move gives check or "#" when it mates, as in PGN movetext.
+void move_to_full_san(const Position* pos, const AIMove* move, char* out, size_t out_size);
+
+// Parses a SAN move for the side to move in pos. Check/mate markers, annotations, "0-0"
+// castling, long forms ("Ng1f3", "Ng1-f3") and promotions without "=" are accepted.
+// Returns false unless it names exactly one legal move.
+bool san_to_move(const Position* pos, const char* san, AIMove* move);
+
+// Compares two SAN strings, ignoring check/mate markers and annotations ("+", "#", "!", "?")
+// and accepting zeros for castling ("0-0").
+bool san_equal(const char* a, const char* b);
+
+#endif // NOTATION_H
@@ -0,0 +1,445 @@
+#define _POSIX_C_SOURCE 200809L // For sysconf()
+#include "pgn.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "notation.h"
+
+struct PGNReader {
+    FILE* file;
+    bool close_file;            // False for stdin
+    long lines_read;            // Complete lines consumed
+    bool at_line_start;         // The next piece read from the file starts a line
+    char pending[PGN_MAX_LINE]; // First line of the next game, read ahead
+    long pending_line;
+    bool have_pending;
+    PGNGameText text;           // For pgn_next_game
+};
+
+static const char* const roster_tags[] = {"Event", "Site", "Date", "Round", "White", "Black", "Result"};
+#define NUM_ROSTER_TAGS 7
+
+static const char* find_tag(const PGNTag* tags, int num_tags, const char* name) {
+    for (int i = 0; i < num_tags; ++i) {
+        if (strcmp(tags[i].name, name) == 0) return tags[i].value;
+    }
+    return NULL;
+}
+
+static bool is_result(const char* token) {
+    return strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0 || strcmp(token, "*") == 0;
+}
+
+// --- Export ---
+
+static void write_tag(FILE* out, const char* name, const char* value) {
+    fprintf(out, "[%s \"", name);
+    for (const char* p = value; *p; ++p) {
+        if (*p == '"' || *p == '\\') fputc('\\', out);
+        fputc(*p, out);
+    }
+    fprintf(out, "\"]\n");
+}
+
+// Adds token to the movetext line being built, writing the line out first if it would get too long.
+static void append_token(FILE* out, char* line, size_t* length, const char* token) {
+    size_t n = strlen(token);
+    if (*length > 0 && *length + 1 + n >= PGN_LINE_WIDTH) {
+        fprintf(out, "%s\n", line);
+        *length = 0;
+    }
+    if (*length > 0) line[(*length)++] = ' ';
+    memcpy(line + *length, token, n + 1);
+    *length += n;
+}
+
+bool pgn_write_game(FILE* out, const Game* game, const PGNTag* tags, int num_tags, const char* result) {
+    for (int i = 0; i < NUM_ROSTER_TAGS - 1; ++i) {
+        const char* value = find_tag(tags, num_tags, roster_tags[i]);
+        write_tag(out, roster_tags[i], value ? value : (strcmp(roster_tags[i], "Date") == 0 ? "????.??.??" : "?"));
+    }
+    write_tag(out, "Result", result);
+    for (int i = 0; i < num_tags; ++i) {
+        bool known = strcmp(tags[i].name, "SetUp") == 0 || strcmp(tags[i].name, "FEN") == 0;
+        for (int j = 0; j < NUM_ROSTER_TAGS; ++j) known = known || strcmp(tags[i].name, roster_tags[j]) == 0;
+        if (!known) write_tag(out, tags[i].name, tags[i].value);
+    }
+    Game start = {0}; // Just the start position, for its FEN
+    start.pos = game->start;
+    start.start_fullmove_number = game->start_fullmove_number;
+    start.start_turn = game->start_turn;
+    char fen[MAX_FEN_LENGTH];
+    get_fen(&start, fen, sizeof(fen));
+    if (strcmp(fen, START_POSITION_FEN) != 0) {
+        write_tag(out, "SetUp", "1");
+        write_tag(out, "FEN", fen);
+    }
+    fputc('\n', out);
+
+    char line[PGN_LINE_WIDTH + 2 * MAX_SAN_LENGTH];
+    size_t length = 0;
+    line[0] = '\0';
+    Position pos = game->start;
+    int number = game->start_fullmove_number;
+    for (int ply = 0; ply < game->move_count; ++ply) {
+        GameMove m;
+        if (!game_get_move(game, ply, &m)) break;
+        AIMove move = {m.from_r, m.from_c, m.to_r, m.to_c, m.promotion, 0};
+        char san[MAX_SAN_LENGTH], token[MAX_SAN_LENGTH + 16];
+        move_to_full_san(&pos, &move, san, sizeof(san));
+        if (pos.turn == WHITE) snprintf(token, sizeof(token), "%d. %s", number, san);
+        else if (ply == 0) snprintf(token, sizeof(token), "%d... %s", number, san);
+        else snprintf(token, sizeof(token), "%s", san);
+        append_token(out, line, &length, token);
+
+        position_execute_move(&pos, m.from_r, m.from_c, m.to_r, m.to_c, m.promotion);
+        if (pos.turn == BLACK) number++;
+        switch_player_turn(&pos);
+    }
+    append_token(out, line, &length, result);
+    fprintf(out, "%s\n\n", line);
+    return !ferror(out);
+}
+
+const char* pgn_result_string(GameState state) {
+    switch (state) {
+        case GAME_STATE_PLAYING:              return "*";
+        case GAME_STATE_CHECKMATE_WHITE_WINS: return "1-0";
+        case GAME_STATE_CHECKMATE_BLACK_WINS: return "0-1";
+        default:                              return "1/2-1/2";
+    }
+}
+
+// --- Streaming Reader ---
+
+PGNReader* pgn_reader_open(const char* path) {
+    PGNReader* reader = calloc(1, sizeof(PGNReader));
+    if (reader == NULL) {
+        printf("Out of memory opening %s\n", path);
+        return NULL;
+    }
+    bool use_stdin = strcmp(path, "-") == 0;
+    reader->file = use_stdin ? stdin : fopen(path, "r");
+    if (reader->file == NULL) {
+        printf("Could not open PGN file %s\n", path);
+        free(reader);
+        return NULL;
+    }
+    reader->close_file = !use_stdin;
+    reader->at_line_start = true;
+    return reader;
+}
+
+void pgn_reader_close(PGNReader* reader) {
+    if (reader == NULL) return;
+    if (reader->close_file) fclose(reader->file);
+    free(reader);
+}
+
+// Reads the next line into chunk (PGN_MAX_LINE bytes), or the next piece of a longer one.
+static bool read_chunk(PGNReader* reader, char* chunk, bool* line_start, long* line) {
+    if (reader->have_pending) {
+        memcpy(chunk, reader->pending, PGN_MAX_LINE);
+        *line_start = true;
+        *line = reader->pending_line;
+        reader->have_pending = false;
+        return true;
+    }
+    *line_start = reader->at_line_start;
+    *line = reader->lines_read + 1;
+    if (fgets(chunk, PGN_MAX_LINE, reader->file) == NULL) return false;
+    size_t n = strlen(chunk);
+    reader->at_line_start = n > 0 && chunk[n - 1] == '\n';
+    if (reader->at_line_start) reader->lines_read++;
+    return true;
+}
+
+bool pgn_read_game_text(PGNReader* reader, PGNGameText* text) {
+    char chunk[PGN_MAX_LINE];
+    bool line_start, started = false, in_movetext = false, in_comment = false, in_tag = false;
+    long line;
+    text->length = 0;
+    text->line = 0;
+    text->truncated = false;
+    while (read_chunk(reader, chunk, &line_start, &line)) {
+        if (line_start) in_tag = chunk[0] == '[' && !in_comment;
+        if (in_tag && line_start && in_movetext) { // The next game's first tag
+            memcpy(reader->pending, chunk, PGN_MAX_LINE);
+            reader->pending_line = line;
+            reader->have_pending = true;
+            break;
+        }
+        if (!started) {
+            const char* p = chunk;
+            while (isspace((unsigned char)*p)) p++;
+            if (*p == '\0') continue; // Blank lines between games
+            started = true;
+            text->line = line;
+        }
+        if (!in_tag && !(line_start && chunk[0] == '%')) {
+            for (const char* p = chunk; *p; ++p) {
+                if (in_comment) in_comment = *p != '}';
+                else if (*p == '{') in_comment = true;
+                else if (*p == ';') break;
+                else if (!isspace((unsigned char)*p)) in_movetext = true;
+            }
+        }
+        size_t n = strlen(chunk);
+        if (text->length + n < PGN_MAX_GAME_TEXT) {
+            memcpy(text->text + text->length, chunk, n);
+            text->length += n;
+        } else {
+            text->truncated = true;
+        }
+    }
+    text->text[text->length] = '\0';
+    return started;
+}
+
+static const char* skip_line(const char* s) {
+    while (*s && *s != '\n') s++;
+    return s;
+}
+
+// Reads a [Name "Value"] tag pair at s into game; returns where the text continues.
+static const char* parse_tag(const char* s, PGNGame* game) {
+    char name[PGN_MAX_TAG_NAME], value[PGN_MAX_TAG_VALUE];
+    size_t n = 0, v = 0;
+    for (s++; *s == ' ' || *s == '\t'; s++) {}
+    for (; isalnum((unsigned char)*s) || *s == '_'; s++) {
+        if (n + 1 < sizeof(name)) name[n++] = *s;
+    }
+    name[n] = '\0';
+    for (; *s == ' ' || *s == '\t'; s++) {}
+    if (*s != '"') return skip_line(s);
+    for (s++; *s && *s != '"' && *s != '\n'; s++) {
+        if (*s == '\\' && (s[1] == '"' || s[1] == '\\')) s++;
+        if (v + 1 < sizeof(value)) value[v++] = *s;
+    }
+    value[v] = '\0';
+    while (*s && *s != ']' && *s != '\n') s++;
+    if (*s == ']') s++;
+    if (n > 0 && game->num_tags < PGN_MAX_TAGS) {
+        PGNTag* tag = &game->tags[game->num_tags++];
+        memcpy(tag->name, name, n + 1);
+        memcpy(tag->value, value, v + 1);
+    }
+    return s;
+}
+
+bool pgn_parse_game(const PGNGameText* text, PGNGame* game) {
+    game->num_tags = 0;
+    game->error[0] = '\0';
+    game->line = text->line;
+    strcpy(game->result, "*");
+
+    const char* s = text->text;
+    for (;;) {
+        while (isspace((unsigned char)*s)) s++;
+        if (*s == '%') s = skip_line(s);
+        else if (*s == '[') s = parse_tag(s, game);
+        else break;
+    }
+    const char* fen = pgn_tag(game, "FEN");
+    if (fen == NULL) {
+        init_board(&game->game);
+    } else if (!load_fen(&game->game, fen)) {
+        init_board(&game->game);
+        snprintf(game->error, sizeof(game->error), "Invalid FEN tag: %.80s", fen);
+        return false;
+    }
+    const char* tag_result = pgn_tag(game, "Result");
+    if (tag_result != NULL && is_result(tag_result)) memcpy(game->result, tag_result, strlen(tag_result) + 1);
+
+    int variation_depth = 0; // Variations are skipped
+    char token[2 * MAX_SAN_LENGTH];
+    while (*s) {
+        if (isspace((unsigned char)*s)) { s++; continue; }
+        if (*s == '{') {
+            const char* end = strchr(s, '}');
+            s = end ? end + 1 : s + strlen(s);
+            continue;
+        }
+        if (*s == ';' || (*s == '%' && s > text->text && s[-1] == '\n')) { s = skip_line(s); continue; }
+        if (*s == '(') { variation_depth++; s++; continue; }
+        if (*s == ')') { if (variation_depth > 0) variation_depth--; s++; continue; }
+        if (*s == '[') break; // Tags after the movetext belong to no game
+
+        size_t n = 0;
+        while (s[n] && !isspace((unsigned char)s[n]) && strchr("{}();[]", s[n]) == NULL) n++;
+        size_t copied = n < sizeof(token) ? n : sizeof(token) - 1;
+        memcpy(token, s, copied);
+        token[copied] = '\0';
+        s += n;
+        if (n == 0) { s++; continue; } // A stray ']'
+        if (variation_depth > 0 || token[0] == '$') continue;
+        if (is_result(token)) {
+            memcpy(game->result, token, strlen(token) + 1);
+            break;
+        }
+
+        // Move numbers ("12.", "12...", or run into the move as in "12.e4")
+        const char* san = token;
+        if (isdigit((unsigned char)san[0]) && strncmp(san, "0-0", 3) != 0) {
+            while (isdigit((unsigned char)*san)) san++;
+        }
+        while (*san == '.') san++;
+        if (*san == '\0') continue;
+
+        AIMove move = {0}; // san_to_move fills it whenever it succeeds, which the optimizer cannot always see
+        if (copied < n || !san_to_move(&game->game.pos, san, &move)) {
+            snprintf(game->error, sizeof(game->error), "Illegal or ambiguous move \"%s\" at ply %d", san, game->game.move_count + 1);
+            return false;
+        }
+        execute_move(&game->game, move.from_r, move.from_c, move.to_r, move.to_c, move.promotion_to);
+        switch_player_turn(&game->game.pos);
+    }
+    if (text->truncated) {
+        snprintf(game->error, sizeof(game->error), "Game text longer than %d bytes", PGN_MAX_GAME_TEXT);
+        return false;
+    }
+    return true;
+}
+
+bool pgn_next_game(PGNReader* reader, PGNGame* game) {
+    if (!pgn_read_game_text(reader, &reader->text)) return false;
+    pgn_parse_game(&reader->text, game);
+    return true;
+}
+
+const char* pgn_tag(const PGNGame* game, const char* name) {
+    return find_tag(game->tags, game->num_tags, name);
+}
+
+void pgn_game_free(PGNGame* game) {
+    game_free(&game->game);
+}
+
+// --- Parallel Replay ---
+// The calling thread reads game texts into free slots and queues them; workers take queued
+// slots, parse and replay them into their own PGNGame and hand the slot back.
+
+typedef struct {
+    PGNGameText* slots;
+    int num_slots;
+    int* free_slots; // Stack of num_free slot indices
+    int num_free;
+    int* ready;      // Ring of num_ready slot indices from ready_head
+    int ready_head, num_ready;
+    bool done;       // No more games will be queued
+    pthread_mutex_t lock;
+    pthread_cond_t slot_freed, game_queued;
+    PGNGameCallback callback;
+    void* user_data;
+    PGNReplayStats stats;
+} ReplayQueue;
+
+typedef struct {
+    ReplayQueue* queue;
+    PGNGame game;
+    pthread_t thread;
+} ReplayWorker;
+
+static void* replay_worker(void* arg) {
+    ReplayWorker* worker = arg;
+    ReplayQueue* queue = worker->queue;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->num_ready == 0 && !queue->done) pthread_cond_wait(&queue->game_queued, &queue->lock);
+        if (queue->num_ready == 0) {
+            pthread_mutex_unlock(&queue->lock);
+            return NULL;
+        }
+        int slot = queue->ready[queue->ready_head];
+        queue->ready_head = (queue->ready_head + 1) % queue->num_slots;
+        queue->num_ready--;
+        pthread_mutex_unlock(&queue->lock);
+
+        bool parsed = pgn_parse_game(&queue->slots[slot], &worker->game);
+        queue->callback(&worker->game, queue->user_data);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->stats.games++;
+        if (!parsed) queue->stats.errors++;
+        queue->free_slots[queue->num_free++] = slot;
+        pthread_cond_signal(&queue->slot_freed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+bool pgn_replay_file(const char* path, int threads, PGNGameCallback callback, void* user_data, PGNReplayStats* stats) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    PGNReader* reader = pgn_reader_open(path);
+    if (reader == NULL) return false;
+
+    ReplayQueue queue = {0};
+    queue.num_slots = 2 * threads; // One being replayed and one waiting per worker
+    queue.slots = malloc(sizeof(PGNGameText) * (size_t)queue.num_slots);
+    queue.free_slots = malloc(sizeof(int) * (size_t)queue.num_slots);
+    queue.ready = malloc(sizeof(int) * (size_t)queue.num_slots);
+    ReplayWorker* workers = calloc((size_t)threads, sizeof(ReplayWorker));
+    if (queue.slots == NULL || queue.free_slots == NULL || queue.ready == NULL || workers == NULL) {
+        printf("Out of memory reading %s\n", path);
+        free(queue.slots); free(queue.free_slots); free(queue.ready); free(workers);
+        pgn_reader_close(reader);
+        return false;
+    }
+    for (int i = 0; i < queue.num_slots; ++i) queue.free_slots[i] = i;
+    queue.num_free = queue.num_slots;
+    queue.callback = callback;
+    queue.user_data = user_data;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.slot_freed, NULL);
+    pthread_cond_init(&queue.game_queued, NULL);
+
+    int started = 0;
+    for (int i = 0; i < threads; ++i) {
+        workers[started].queue = &queue;
+        if (pthread_create(&workers[started].thread, NULL, replay_worker, &workers[started]) == 0) started++;
+    }
+    bool ok = started > 0;
+    if (!ok) printf("Could not start threads to replay %s\n", path);
+
+    while (ok) {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.num_free == 0) pthread_cond_wait(&queue.slot_freed, &queue.lock);
+        int slot = queue.free_slots[--queue.num_free];
+        pthread_mutex_unlock(&queue.lock);
+
+        bool have_game = pgn_read_game_text(reader, &queue.slots[slot]);
+        pthread_mutex_lock(&queue.lock);
+        if (have_game) {
+            queue.ready[(queue.ready_head + queue.num_ready) % queue.num_slots] = slot;
+            queue.num_ready++;
+            pthread_cond_signal(&queue.game_queued);
+        } else {
+            queue.free_slots[queue.num_free++] = slot;
+        }
+        pthread_mutex_unlock(&queue.lock);
+        if (!have_game) break;
+    }
+    if (ok && ferror(reader->file)) {
+        printf("Error reading %s\n", path);
+        ok = false;
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.done = true;
+    pthread_cond_broadcast(&queue.game_queued);
+    pthread_mutex_unlock(&queue.lock);
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        pgn_game_free(&workers[i].game);
+    }
+    if (stats != NULL) *stats = queue.stats;
+
+    pthread_cond_destroy(&queue.game_queued);
+    pthread_cond_destroy(&queue.slot_freed);
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.slots); free(queue.free_slots); free(queue.ready); free(workers);
+    pgn_reader_close(reader);
+    return ok;
+}
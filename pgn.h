@@ -0,0 +1,93 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "board.h"
+#include "rules.h"
+
+// --- PGN Import/Export ---
+// Games in Portable Game Notation. Export writes a game record with its tags. The reader
+// streams a database of any size: it holds one game's text at a time, and the caller pulls
+// games one by one (pgn_next_game). pgn_replay_file spreads the expensive part (parsing SAN
+// and replaying the moves) over worker threads while the calling thread reads; memory stays
+// a few buffers per thread.
+//
+// A game is its tag pairs followed by its movetext, and a tag pair after movetext starts
+// the next game. Comments ({...} and ; to the end of the line), variations, NAGs ($n), move
+// numbers and '%' escape lines are skipped. A FEN tag sets the start position. A game whose
+// text exceeds PGN_MAX_GAME_TEXT is kept only up to that size and reported as an error.
+
+#define PGN_MAX_GAME_TEXT (64 * 1024)
+#define PGN_MAX_LINE 4096 // Longer lines are read in pieces
+#define PGN_MAX_TAGS 32   // Further tags are ignored
+#define PGN_MAX_TAG_NAME 32
+#define PGN_MAX_TAG_VALUE 256
+#define PGN_MAX_ERROR 128
+#define PGN_LINE_WIDTH 80 // Movetext lines are wrapped before this
+
+typedef struct {
+    char name[PGN_MAX_TAG_NAME];
+    char value[PGN_MAX_TAG_VALUE];
+} PGNTag;
+
+// The raw text of one game, as the reader hands it out.
+typedef struct {
+    char text[PGN_MAX_GAME_TEXT];
+    size_t length;
+    long line;      // Line of the file the game starts on
+    bool truncated; // The game was longer than the buffer
+} PGNGameText;
+
+// A parsed game. Must start zeroed; pgn_game_free releases it.
+typedef struct {
+    PGNTag tags[PGN_MAX_TAGS];
+    int num_tags;
+    Game game;                 // From the start position through the last move replayed
+    char result[8];            // "1-0", "0-1", "1/2-1/2" or "*"
+    long line;                 // Line of the file the game starts on
+    char error[PGN_MAX_ERROR]; // Why replaying stopped early; empty when the whole game was read
+} PGNGame;
+
+typedef struct PGNReader PGNReader;
+
+// --- Export ---
+// Writes the game from its start position up to its current ply: the seven tag roster
+// (Event, Site, Date, Round, White, Black from tags, "?" where missing, and result), the
+// other tags, SetUp and FEN when the game did not start from the initial position, then the
+// movetext. Returns false on a write error.
+bool pgn_write_game(FILE* out, const Game* game, const PGNTag* tags, int num_tags, const char* result);
+// The PGN result of a game in the given state: "1-0", "0-1", "1/2-1/2", or "*" while it is playing.
+const char* pgn_result_string(GameState state);
+
+// --- Streaming Reader ---
+PGNReader* pgn_reader_open(const char* path); // "-" reads stdin; NULL (with a message) on failure
+void pgn_reader_close(PGNReader* reader);
+// Reads the next game's text. False at the end of the file.
+bool pgn_read_game_text(PGNReader* reader, PGNGameText* text);
+// Parses the tags and replays the movetext of text into game. Returns false, with
+// game->error set, if a move is illegal, ambiguous or malformed (game then holds the moves
+// before it) or the text was truncated.
+bool pgn_parse_game(const PGNGameText* text, PGNGame* game);
+// Pull API: reads and parses the next game into game. False at the end of the file;
+// true for every game read, even one that did not parse (see game->error).
+bool pgn_next_game(PGNReader* reader, PGNGame* game);
+const char* pgn_tag(const PGNGame* game, const char* name); // The tag's value, or NULL
+void pgn_game_free(PGNGame* game);
+
+// --- Parallel Replay ---
+// Called for every game of the file, on a worker thread and in no particular order;
+// game->error tells whether it parsed. The game is only valid during the call.
+typedef void (*PGNGameCallback)(const PGNGame* game, void* user_data);
+
+typedef struct {
+    long games;
+    long errors; // Games that did not parse completely
+} PGNReplayStats;
+
+// Reads path on the calling thread and parses and replays its games on `threads` workers
+// (0: one per CPU). Returns false if the file cannot be read.
+bool pgn_replay_file(const char* path, int threads, PGNGameCallback callback, void* user_data, PGNReplayStats* stats);
+
+#endif // PGN_H
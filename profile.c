@@ -0,0 +1,49 @@
+#include "profile.h"
+
+#ifdef ENGINE_INSTRUMENT
+
+#include <stdatomic.h>
+#include <string.h>
+
+_Thread_local ProfileCounters profile_thread_counters;
+
+static _Atomic uint64_t total_ticks[PROF_NUM_SECTIONS];
+static _Atomic uint64_t total_calls[PROF_NUM_SECTIONS];
+
+static const char* section_names[PROF_NUM_SECTIONS] = {
+    "movegen", "make move", "board copy", "eval", "quiescence", "is_move_legal", "is_square_attacked"
+};
+
+void profile_flush_thread(void) {
+    for (int i = 0; i < PROF_NUM_SECTIONS; ++i) {
+        atomic_fetch_add(&total_ticks[i], profile_thread_counters.ticks[i]);
+        atomic_fetch_add(&total_calls[i], profile_thread_counters.calls[i]);
+        profile_thread_counters.ticks[i] = 0;
+        profile_thread_counters.calls[i] = 0;
+    }
+}
+
+void profile_report(FILE* out) {
+    profile_flush_thread();
+    fprintf(out, "%-20s %14s %18s %12s\n", "section", "calls", PROFILE_TICK_UNIT, PROFILE_TICK_UNIT "/call");
+    for (int i = 0; i < PROF_NUM_SECTIONS; ++i) {
+        uint64_t calls = atomic_load(&total_calls[i]);
+        uint64_t ticks = atomic_load(&total_ticks[i]);
+        fprintf(out, "%-20s %14llu %18llu %12.1f\n", section_names[i], (unsigned long long)calls,
+                (unsigned long long)ticks, calls ? (double)ticks / (double)calls : 0.0);
+    }
+}
+
+void profile_reset(void) {
+    for (int i = 0; i < PROF_NUM_SECTIONS; ++i) {
+        atomic_store(&total_ticks[i], 0);
+        atomic_store(&total_calls[i], 0);
+    }
+}
+
+#else
+
+// ISO C forbids an empty translation unit
+typedef int profile_disabled_translation_unit;
+
+#endif // ENGINE_INSTRUMENT
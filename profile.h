@@ -0,0 +1,93 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// --- Hot-Path Profiling Hooks ---
+// Scoped tick counters around the engine's hot sections. Build with -DENGINE_INSTRUMENT
+// (make INSTRUMENT=1, or the 'make profile' variant) to enable them; otherwise every
+// macro below expands to nothing and the functions are empty inlines.
+//
+// Usage: put PROFILE_SCOPE(PROF_EVAL); at the top of a block. The elapsed ticks are
+// added when the block is left by any path (GCC/Clang cleanup attribute). Recursive
+// sections such as quiescence only time their outermost entry, so totals are inclusive
+// wall time per section, while the call count includes every entry.
+
+#include <stdio.h>
+
+typedef enum {
+    PROF_MOVEGEN,         // Legal move generation (find_all_legal_ai_moves, capture scans)
+    PROF_MAKE_UNMAKE,     // make_search_move (nothing is unmade: each ply plays on its own copy)
+    PROF_BOARD_COPY,      // copy_position: the Position copy before each make
+    PROF_EVAL,            // search_evaluation (PST or NNUE) and the PST batch in order_moves
+    PROF_QUIESCENCE,      // quiescence_search (outermost entry)
+    PROF_LEGALITY,        // is_move_legal
+    PROF_SQUARE_ATTACKED, // is_square_attacked
+    PROF_NUM_SECTIONS
+} ProfileSection;
+
+#ifdef ENGINE_INSTRUMENT
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profile_ticks(void) { return __rdtsc(); }
+#define PROFILE_TICK_UNIT "cycles"
+#else
+#include <time.h>
+static inline uint64_t profile_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#define PROFILE_TICK_UNIT "ns"
+#endif
+
+typedef struct {
+    uint64_t ticks[PROF_NUM_SECTIONS];
+    uint64_t calls[PROF_NUM_SECTIONS];
+    int active[PROF_NUM_SECTIONS]; // Nesting depth, so recursion is timed once
+} ProfileCounters;
+
+extern _Thread_local ProfileCounters profile_thread_counters;
+
+typedef struct {
+    ProfileSection section;
+    uint64_t start;
+} ProfileScope;
+
+static inline ProfileScope profile_scope_begin(ProfileSection section) {
+    profile_thread_counters.calls[section]++;
+    ProfileScope scope = {section, 0};
+    if (profile_thread_counters.active[section]++ == 0) scope.start = profile_ticks();
+    return scope;
+}
+
+static inline void profile_scope_end(ProfileScope* scope) {
+    if (--profile_thread_counters.active[scope->section] == 0) {
+        profile_thread_counters.ticks[scope->section] += profile_ticks() - scope->start;
+    }
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(section) \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__) __attribute__((cleanup(profile_scope_end))) = profile_scope_begin(section)
+
+// Adds this thread's counters to the process-wide totals and clears them.
+// Called at the end of every search.
+void profile_flush_thread(void);
+// Prints the process-wide totals per section.
+void profile_report(FILE* out);
+// Clears the process-wide totals.
+void profile_reset(void);
+
+#else // !ENGINE_INSTRUMENT
+
+#define PROFILE_SCOPE(section) ((void)0)
+static inline void profile_flush_thread(void) {}
+static inline void profile_report(FILE* out) { (void)out; }
+static inline void profile_reset(void) {}
+
+#endif // ENGINE_INSTRUMENT
+
+#endif // PROFILE_H
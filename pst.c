@@ -0,0 +1,121 @@
+#include "pst.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if !defined(PST_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PST_HAVE_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+// Piece-square tables: a bonus or penalty for a piece being on a specific square
+static const int pawn_pst_white[8][8] = PAWN_PST;
+static const int knight_pst_white[8][8] = KNIGHT_PST;
+static const int bishop_pst_white[8][8] = BISHOP_PST;
+static const int rook_pst_white[8][8] = ROOK_PST;
+static const int queen_pst_white[8][8] = QUEEN_PST;
+static const int king_pst_white_midgame[8][8] = KING_PST;
+
+// Combined table: index (piece * 64 + r * 8 + c), piece 0 for an empty square (all zero),
+// 1-6 White pawn to king, 7-12 Black pawn to king. Built once from the tables above.
+#define PST_PIECE_INDICES 13
+static int32_t pst_table[PST_PIECE_INDICES * 64];
+static void (*batch_kernel)(PSTBatch* batch);
+static const char* batch_kernel_name;
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static int piece_index(Piece p) {
+    if (p.type == EMPTY) return 0;
+    return (p.color == WHITE ? 0 : 6) + p.type;
+}
+
+static int table_index(Piece p, int r, int c) {
+    return piece_index(p) * 64 + r * 8 + c;
+}
+
+static void evaluate_batch_scalar(PSTBatch* batch) {
+    for (int i = 0; i < batch->count; ++i) {
+        batch->scores[i] = batch->base + pst_table[batch->added[0][i]] + pst_table[batch->added[1][i]]
+                         - pst_table[batch->removed[0][i]] - pst_table[batch->removed[1][i]];
+    }
+}
+
+#ifdef PST_HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+static void evaluate_batch_avx2(PSTBatch* batch) {
+    const __m256i base = _mm256_set1_epi32(batch->base);
+    for (int i = 0; i < batch->count; i += PST_BATCH_LANES) { // Columns are zero-padded to whole lanes
+        __m256i sum = _mm256_add_epi32(base, _mm256_i32gather_epi32(pst_table, _mm256_loadu_si256((const __m256i*)&batch->added[0][i]), 4));
+        sum = _mm256_add_epi32(sum, _mm256_i32gather_epi32(pst_table, _mm256_loadu_si256((const __m256i*)&batch->added[1][i]), 4));
+        sum = _mm256_sub_epi32(sum, _mm256_i32gather_epi32(pst_table, _mm256_loadu_si256((const __m256i*)&batch->removed[0][i]), 4));
+        sum = _mm256_sub_epi32(sum, _mm256_i32gather_epi32(pst_table, _mm256_loadu_si256((const __m256i*)&batch->removed[1][i]), 4));
+        _mm256_storeu_si256((__m256i*)&batch->scores[i], sum);
+    }
+}
+#endif
+
+static void init_table(void) {
+    static const int values[KING + 1] = {0, PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, 0};
+    const int (*tables[KING + 1])[8] = {NULL, pawn_pst_white, knight_pst_white, bishop_pst_white, rook_pst_white, queen_pst_white, king_pst_white_midgame};
+    for (int type = PAWN; type <= KING; ++type) {
+        for (int r = 0; r < 8; ++r) {
+            for (int c = 0; c < 8; ++c) {
+                pst_table[table_index((Piece){type, WHITE}, r, c)] = values[type] + tables[type][r][c];
+                pst_table[table_index((Piece){type, BLACK}, r, c)] = -(values[type] + tables[type][7 - r][c]);
+            }
+        }
+    }
+    batch_kernel = evaluate_batch_scalar;
+    batch_kernel_name = "scalar";
+#ifdef PST_HAVE_AVX2_KERNEL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        batch_kernel = evaluate_batch_avx2;
+        batch_kernel_name = "avx2";
+    }
+#endif
+}
+
+int pst_evaluate(const Position* pos, PieceColor perspective) {
+    pthread_once(&table_once, init_table);
+    int32_t score = 0;
+    const Piece* squares = &pos->board[0][0];
+    for (int sq = 0; sq < 64; ++sq) score += pst_table[piece_index(squares[sq]) * 64 + sq];
+    return perspective == WHITE ? score : -score;
+}
+
+void pst_batch_init(PSTBatch* batch, const Position* pos) {
+    batch->count = 0;
+    batch->base = pst_evaluate(pos, WHITE);
+}
+
+void pst_batch_add_move(PSTBatch* batch, const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceType promotion) {
+    int i = batch->count++;
+    Piece mover = pos->board[from_r][from_c];
+    Piece placed = mover;
+    if (promotion != EMPTY) placed.type = promotion;
+    batch->removed[0][i] = table_index(mover, from_r, from_c);
+    batch->added[0][i] = table_index(placed, to_r, to_c);
+    batch->removed[1][i] = table_index(pos->board[to_r][to_c], to_r, to_c); // The victim, or the zero entry
+    batch->added[1][i] = 0;
+    if (mover.type == PAWN && from_c != to_c && pos->board[to_r][to_c].type == EMPTY) { // En passant
+        batch->removed[1][i] = table_index(pos->board[from_r][to_c], from_r, to_c);
+    } else if (mover.type == KING && abs(to_c - from_c) == 2) { // Castling: the rook jumps over the king
+        int rook_from_c = (to_c > from_c) ? 7 : 0, rook_to_c = (to_c > from_c) ? to_c - 1 : to_c + 1;
+        batch->removed[1][i] = table_index(pos->board[from_r][rook_from_c], from_r, rook_from_c);
+        batch->added[1][i] = table_index(pos->board[from_r][rook_from_c], from_r, rook_to_c);
+    }
+}
+
+void pst_batch_evaluate(PSTBatch* batch) {
+    pthread_once(&table_once, init_table);
+    for (int i = batch->count; i % PST_BATCH_LANES != 0; ++i) { // Pad the last lanes with zero entries
+        batch->removed[0][i] = batch->removed[1][i] = batch->added[0][i] = batch->added[1][i] = 0;
+    }
+    batch_kernel(batch);
+}
+
+const char* pst_batch_kernel_name(void) {
+    pthread_once(&table_once, init_table);
+    return batch_kernel_name;
+}
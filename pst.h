@@ -0,0 +1,41 @@
+#ifndef PST_H
+#define PST_H
+
+#include <stdint.h>
+#include "board.h"
+#include "pst_params.h" // PAWN_VALUE to QUEEN_VALUE and the tables, written by ./tune
+
+// --- Material and Piece-Square Evaluation ---
+// The hand-written evaluation (or its ./tune fit): piece values plus a bonus per piece and
+// square. Both are folded into one table of (piece, square) entries from White's point of
+// view, so a position scores the sum of its squares' entries and a move only changes the
+// entries of the squares it touches.
+
+// Score of pos for perspective (material plus piece-square bonuses, no mate detection).
+int pst_evaluate(const Position* pos, PieceColor perspective);
+
+// --- Batch Evaluation ---
+// Scores every child of one position at once. A move takes at most two entries off the
+// board and puts at most two on (castling moves the rook too, a capture removes the
+// victim, a promotion puts down another piece), stored as structure-of-arrays columns of
+// table indices so a kernel can gather and sum PST_BATCH_LANES children per instruction.
+// The kernel is picked at run time: AVX2 gathers where the CPU has them, scalar otherwise.
+
+#define PST_BATCH_MAX 256 // More than the legal moves of any position
+#define PST_BATCH_LANES 8
+
+typedef struct {
+    int count;
+    int32_t base;                      // Score of the parent position for White
+    int32_t removed[2][PST_BATCH_MAX]; // Table indices; 0 is an always-zero entry
+    int32_t added[2][PST_BATCH_MAX];
+    int32_t scores[PST_BATCH_MAX];     // Output: score of each child for White
+} PSTBatch;
+
+void pst_batch_init(PSTBatch* batch, const Position* pos);
+// Adds the child reached by a legal move of the side to move; promotion is EMPTY for none.
+void pst_batch_add_move(PSTBatch* batch, const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceType promotion);
+void pst_batch_evaluate(PSTBatch* batch);
+const char* pst_batch_kernel_name(void); // "avx2" or "scalar"
+
+#endif // PST_H
@@ -0,0 +1,80 @@
+#ifndef PST_PARAMS_H
+#define PST_PARAMS_H
+
+// --- Evaluation Parameters ---
+// Piece values and piece-square tables (from White's side, row 0 = rank 8; mirrored for
+// Black). Hand-set; ./tune rewrites this file with values fitted to a dataset of games.
+
+#define PAWN_VALUE   100
+#define KNIGHT_VALUE 320
+#define BISHOP_VALUE 330
+#define ROOK_VALUE   500
+#define QUEEN_VALUE  900
+
+#define PAWN_PST { \
+    {  0,   0,   0,   0,   0,   0,   0,   0}, \
+    { 50,  50,  50,  50,  50,  50,  50,  50}, \
+    { 10,  10,  20,  30,  30,  20,  10,  10}, \
+    {  5,   5,  10,  25,  25,  10,   5,   5}, \
+    {  0,   0,   0,  20,  20,   0,   0,   0}, \
+    {  5,  -5, -10,   0,   0, -10,  -5,   5}, \
+    {  5,  10,  10, -20, -20,  10,  10,   5}, \
+    {  0,   0,   0,   0,   0,   0,   0,   0} \
+}
+
+#define KNIGHT_PST { \
+    {-50, -40, -30, -30, -30, -30, -40, -50}, \
+    {-40, -20,   0,   0,   0,   0, -20, -40}, \
+    {-30,   0,  10,  15,  15,  10,   0, -30}, \
+    {-30,   5,  15,  20,  20,  15,   5, -30}, \
+    {-30,   0,  15,  20,  20,  15,   0, -30}, \
+    {-30,   5,  10,  15,  15,  10,   5, -30}, \
+    {-40, -20,   0,   5,   5,   0, -20, -40}, \
+    {-50, -40, -30, -30, -30, -30, -40, -50} \
+}
+
+#define BISHOP_PST { \
+    {-20, -10, -10, -10, -10, -10, -10, -20}, \
+    {-10,   0,   0,   0,   0,   0,   0, -10}, \
+    {-10,   0,   5,  10,  10,   5,   0, -10}, \
+    {-10,   5,   5,  10,  10,   5,   5, -10}, \
+    {-10,   0,  10,  10,  10,  10,   0, -10}, \
+    {-10,  10,  10,  10,  10,  10,  10, -10}, \
+    {-10,   5,   0,   0,   0,   0,   5, -10}, \
+    {-20, -10, -10, -10, -10, -10, -10, -20} \
+}
+
+#define ROOK_PST { \
+    {  0,   0,   0,   0,   0,   0,   0,   0}, \
+    {  5,  10,  10,  10,  10,  10,  10,   5}, \
+    { -5,   0,   0,   0,   0,   0,   0,  -5}, \
+    { -5,   0,   0,   0,   0,   0,   0,  -5}, \
+    { -5,   0,   0,   0,   0,   0,   0,  -5}, \
+    { -5,   0,   0,   0,   0,   0,   0,  -5}, \
+    { -5,   0,   0,   0,   0,   0,   0,  -5}, \
+    {  0,   0,   0,   5,   5,   0,   0,   0} \
+}
+
+#define QUEEN_PST { \
+    {-20, -10, -10,  -5,  -5, -10, -10, -20}, \
+    {-10,   0,   0,   0,   0,   0,   0, -10}, \
+    {-10,   0,   5,   5,   5,   5,   0, -10}, \
+    { -5,   0,   5,   5,   5,   5,   0,  -5}, \
+    {  0,   0,   5,   5,   5,   5,   0,  -5}, \
+    {-10,   5,   5,   5,   5,   5,   0, -10}, \
+    {-10,   0,   5,   0,   0,   0,   0, -10}, \
+    {-20, -10, -10,  -5,  -5, -10, -10, -20} \
+}
+
+#define KING_PST { \
+    {-30, -40, -40, -50, -50, -40, -40, -30}, \
+    {-30, -40, -40, -50, -50, -40, -40, -30}, \
+    {-30, -40, -40, -50, -50, -40, -40, -30}, \
+    {-30, -40, -40, -50, -50, -40, -40, -30}, \
+    {-20, -30, -30, -40, -40, -30, -30, -20}, \
+    {-10, -20, -20, -20, -20, -20, -20, -10}, \
+    { 20,  20,   0,   0,   0,   0,  20,  20}, \
+    { 20,  30,  10,   0,   0,  10,  30,  20} \
+}
+
+#endif // PST_PARAMS_H
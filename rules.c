@@ -1,4 +1,5 @@
 #include "rules.h"
+#include "profile.h"
 #include <stdlib.h> // For abs()
 #include <stdio.h>  // For debugging prints (optional)
 #include <string.h> // For memcpy
@@ -29,6 +30,7 @@ static bool is_path_clear(const Piece board[8][8], int from_r, int from_c, int t
 
 // Checks if the square (target_r, target_c) is attacked by any piece of attacker_color
 bool is_square_attacked(const Piece board[8][8], int target_r, int target_c, PieceColor attacker_color) {
+    PROFILE_SCOPE(PROF_SQUARE_ATTACKED);
     for (int r_scan = 0; r_scan < 8; ++r_scan) {
         for (int c_scan = 0; c_scan < 8; ++c_scan) {
             Piece p = board[r_scan][c_scan];
@@ -125,7 +127,8 @@ bool is_king_in_check(const Piece board[8][8], PieceColor king_color) {
 }
 
 // NEW: Checks if the player of 'player_color' has any legal moves on the current board
-bool has_any_legal_moves(const Piece board[8][8], PieceColor player_color) {
+bool has_any_legal_moves(const Position* pos, PieceColor player_color) {
+    const Piece (*board)[8] = pos->board;
     // Iterate over all squares on the board
     for (int r_from = 0; r_from < 8; ++r_from) {
         for (int c_from = 0; c_from < 8; ++c_from) {
@@ -134,23 +137,9 @@ bool has_any_legal_moves(const Piece board[8][8], PieceColor player_color) {
                 // Try to move this piece to every other square on the board
                 for (int r_to = 0; r_to < 8; ++r_to) {
                     for (int c_to = 0; c_to < 8; ++c_to) {
-                        // Store current en_passant_target_r/c because is_move_legal might modify it temporarily
-                        // or rely on it. For has_any_legal_moves, we assume the current EP state is correct.
-                        int current_ep_r = en_passant_target_r;
-                        int current_ep_c = en_passant_target_c;
-
-                        if (is_move_legal(board, r_from, c_from, r_to, c_to, player_color)) {
-                            // Restore EP state if it was changed by is_move_legal for this test
-                            // Though is_move_legal itself should be careful about global state changes
-                            // when used in a "testing" context like this.
-                            // For now, we assume is_move_legal is robust enough for this.
-                            en_passant_target_r = current_ep_r;
-                            en_passant_target_c = current_ep_c;
+                        if (is_move_legal(pos, r_from, c_from, r_to, c_to, player_color)) {
                             return true; // Found at least one legal move
                         }
-                        // Restore EP state if is_move_legal modified it.
-                        en_passant_target_r = current_ep_r;
-                        en_passant_target_c = current_ep_c;
                     }
                 }
             }
@@ -253,7 +242,8 @@ bool is_draw_by_insufficient_material(const Piece board[8][8]) {
 // These now primarily check if the move follows the piece's basic movement pattern.
 // The check for leaving the king in check is handled by the main is_move_legal function.
 
-bool is_pawn_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color) {
+bool is_pawn_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor piece_color) {
+    const Piece (*board)[8] = pos->board;
     int dr = to_r - from_r;
     int dc = to_c - from_c;
 
@@ -266,10 +256,10 @@ bool is_pawn_move_legal(const Piece board[8][8], int from_r, int from_c, int to_
         if (abs(dc) == 1 && dr == -1 && board[to_r][to_c].type != EMPTY && board[to_r][to_c].color == BLACK) return true;
         // En Passant Capture for White
         if (abs(dc) == 1 && dr == -1 &&
-            to_r == en_passant_target_r && to_c == en_passant_target_c &&
+            to_r == pos->en_passant_r && to_c == pos->en_passant_c &&
             from_r == 3 ) { // White pawn must be on rank 3 (0-indexed) to perform EP
             // We also need to ensure the pawn to be captured by EP exists, which is implicitly handled
-            // if en_passant_target_r/c are correctly set after a black 2-square move.
+            // if the en passant square is correctly set after a black 2-square move.
             // The target square for EP must be empty.
             if (board[to_r][to_c].type == EMPTY) return true;
         }
@@ -282,7 +272,7 @@ bool is_pawn_move_legal(const Piece board[8][8], int from_r, int from_c, int to_
         if (abs(dc) == 1 && dr == 1 && board[to_r][to_c].type != EMPTY && board[to_r][to_c].color == WHITE) return true;
         // En Passant Capture for Black
         if (abs(dc) == 1 && dr == 1 &&
-            to_r == en_passant_target_r && to_c == en_passant_target_c &&
+            to_r == pos->en_passant_r && to_c == pos->en_passant_c &&
             from_r == 4 ) { // Black pawn must be on rank 4
             if (board[to_r][to_c].type == EMPTY) return true;
         }
@@ -326,7 +316,8 @@ bool is_queen_move_legal(const Piece board[8][8], int from_r, int from_c, int to
 
 // For king, castling safety checks (not in check, not through check, not to check) are included here.
 // General self-check for normal king moves is handled by the simulation in the main is_move_legal.
-bool is_king_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color, bool check_castling_safety_and_normal_move) {
+bool is_king_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor piece_color, bool check_castling_safety_and_normal_move) {
+    const Piece (*board)[8] = pos->board;
     int dr_signed = to_r - from_r;
     int dc_signed = to_c - from_c;
     int dr_abs = abs(dr_signed);
@@ -338,17 +329,19 @@ bool is_king_move_legal(const Piece board[8][8], int from_r, int from_c, int to_
     }
 
     // Castling logic (only if called for primary move validation, not recursively for attack checks)
-    if (check_castling_safety_and_normal_move && !board[from_r][from_c].has_moved && dr_signed == 0) {
+    if (check_castling_safety_and_normal_move && dr_signed == 0) {
         // King must be on its original rank and e-file for standard castling
         int expected_king_r = (piece_color == WHITE) ? 7 : 0;
         if (from_r != expected_king_r || from_c != 4) return false;
 
         PieceColor opponent_color = (piece_color == WHITE) ? BLACK : WHITE;
+        int kingside_right = (piece_color == WHITE) ? CASTLE_WHITE_KINGSIDE : CASTLE_BLACK_KINGSIDE;
+        int queenside_right = (piece_color == WHITE) ? CASTLE_WHITE_QUEENSIDE : CASTLE_BLACK_QUEENSIDE;
 
         // King-side castling (O-O): King e1->g1 (or e8->g8)
-        if (dc_signed == 2 && to_c == 6) {
-            // Check rook: h1/h8, same row, not moved
-            if (board[from_r][7].type == ROOK && board[from_r][7].color == piece_color && !board[from_r][7].has_moved) {
+        if (dc_signed == 2 && to_c == 6 && (pos->castling_rights & kingside_right)) {
+            // Check rook: h1/h8, same row (the right is dropped as soon as it moves or is captured)
+            if (board[from_r][7].type == ROOK && board[from_r][7].color == piece_color) {
                 // Path clear: f1/f8, g1/g8
                 if (board[from_r][5].type == EMPTY && board[from_r][6].type == EMPTY) {
                     // King not in check, not through attacked square, not to attacked square
@@ -361,9 +354,9 @@ bool is_king_move_legal(const Piece board[8][8], int from_r, int from_c, int to_
             }
         }
         // Queen-side castling (O-O-O): King e1->c1 (or e8->c8)
-        else if (dc_signed == -2 && to_c == 2) {
-             // Check rook: a1/a8, same row, not moved
-            if (board[from_r][0].type == ROOK && board[from_r][0].color == piece_color && !board[from_r][0].has_moved) {
+        else if (dc_signed == -2 && to_c == 2 && (pos->castling_rights & queenside_right)) {
+             // Check rook: a1/a8, same row
+            if (board[from_r][0].type == ROOK && board[from_r][0].color == piece_color) {
                 // Path clear: d1/d8, c1/c8, b1/b8
                 if (board[from_r][3].type == EMPTY &&
                     board[from_r][2].type == EMPTY &&
@@ -383,7 +376,9 @@ bool is_king_move_legal(const Piece board[8][8], int from_r, int from_c, int to_
 
 // MODIFIED: Main move legality function
 // Combines pseudo-legal checks (piece movement rules) with self-check prevention.
-bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor player_turn) {
+bool is_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor player_turn) {
+    PROFILE_SCOPE(PROF_LEGALITY);
+    const Piece (*original_board)[8] = pos->board;
     // Step 0: Basic pre-checks
     if (!is_square_on_board(from_r, from_c) || !is_square_on_board(to_r, to_c)) return false;
 
@@ -399,12 +394,12 @@ bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int
     // Step 1: Basic piece movement rule validation (pseudo-legality)
     bool pseudo_legal = false;
     switch (moving_piece_original.type) {
-        case PAWN:   pseudo_legal = is_pawn_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn); break;
+        case PAWN:   pseudo_legal = is_pawn_move_legal(pos, from_r, from_c, to_r, to_c, player_turn); break;
         case ROOK:   pseudo_legal = is_rook_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn); break;
         case KNIGHT: pseudo_legal = is_knight_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn); break;
         case BISHOP: pseudo_legal = is_bishop_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn); break;
         case QUEEN:  pseudo_legal = is_queen_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn); break;
-        case KING:   pseudo_legal = is_king_move_legal(original_board, from_r, from_c, to_r, to_c, player_turn, true); break;
+        case KING:   pseudo_legal = is_king_move_legal(pos, from_r, from_c, to_r, to_c, player_turn, true); break;
         default:     return false; // Unknown piece type
     }
 
@@ -420,7 +415,7 @@ bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int
     // --- Simulate Special Move Aspects on Temp Board (if applicable) ---
     // En Passant: If the pseudo-legal move was an EP capture, remove the captured pawn on the temp_board.
     if (moving_piece_original.type == PAWN && to_c != from_c && temp_board[to_r][to_c].type == EMPTY) { // Diagonal move to an empty square
-        if (to_r == en_passant_target_r && to_c == en_passant_target_c) { // And it's the EP target square
+        if (to_r == pos->en_passant_r && to_c == pos->en_passant_c) { // And it's the EP target square
             int captured_pawn_actual_r = (player_turn == WHITE) ? to_r + 1 : to_r - 1; // Row of the pawn being captured
             if (is_square_on_board(captured_pawn_actual_r, to_c) &&
                 temp_board[captured_pawn_actual_r][to_c].type == PAWN &&
@@ -428,17 +423,14 @@ bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int
                 // Remove the captured pawn from the temporary board
                 temp_board[captured_pawn_actual_r][to_c].type = EMPTY;
                 temp_board[captured_pawn_actual_r][to_c].color = NO_COLOR;
-                // temp_board[captured_pawn_actual_r][to_c].has_moved does not matter for empty
             }
         }
     }
 
     // --- Perform the main piece move on the temporary board ---
     temp_board[to_r][to_c] = temp_board[from_r][from_c]; // Move the piece
-    temp_board[to_r][to_c].has_moved = true;             // Update has_moved on temp board
     temp_board[from_r][from_c].type = EMPTY;             // Empty original square
     temp_board[from_r][from_c].color = NO_COLOR;
-    // temp_board[from_r][from_c].has_moved = false; // Not strictly necessary for empty
 
     // Castling: If the pseudo-legal move was castling, also move the rook on the temp_board.
     if (moving_piece_original.type == KING && abs(to_c - from_c) == 2) { // King moved two squares horizontally
@@ -456,7 +448,6 @@ bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int
         // The rook on temp_board at original_board[from_r][rook_original_col]
         if(original_board[from_r][rook_original_col].type == ROOK && original_board[from_r][rook_original_col].color == player_turn){
             temp_board[from_r][rook_dest_col] = original_board[from_r][rook_original_col]; // Move rook data
-            temp_board[from_r][rook_dest_col].has_moved = true;
             temp_board[from_r][rook_original_col].type = EMPTY;
             temp_board[from_r][rook_original_col].color = NO_COLOR;
         } else {
@@ -474,3 +465,14 @@ bool is_move_legal(const Piece original_board[8][8], int from_r, int from_c, int
     return true; // Move is fully legal
 }
 
+GameState get_game_state(const Position* pos) {
+    if (!has_any_legal_moves(pos, pos->turn)) {
+        if (is_king_in_check(pos->board, pos->turn)) {
+            return (pos->turn == WHITE) ? GAME_STATE_CHECKMATE_BLACK_WINS : GAME_STATE_CHECKMATE_WHITE_WINS;
+        }
+        return GAME_STATE_STALEMATE;
+    }
+    if (is_draw_by_insufficient_material(pos->board)) return GAME_STATE_DRAW_INSUFFICIENT_MATERIAL;
+    if (pos->halfmove_clock >= 100) return GAME_STATE_DRAW_50_MOVE_RULE;
+    return GAME_STATE_PLAYING;
+}
@@ -4,13 +4,19 @@
 #include "board.h"
 #include <stdbool.h>
 
+typedef enum {
+    GAME_STATE_PLAYING, GAME_STATE_CHECKMATE_WHITE_WINS, GAME_STATE_CHECKMATE_BLACK_WINS,
+    GAME_STATE_STALEMATE, GAME_STATE_DRAW_INSUFFICIENT_MATERIAL, GAME_STATE_DRAW_50_MOVE_RULE,
+    GAME_STATE_DRAW_THREEFOLD_REPETITION
+} GameState;
+
 bool is_square_on_board(int r, int c);
 
 // NEW: Checks if the square (r, c) is attacked by any piece of attacker_color
 bool is_square_attacked(const Piece board[8][8], int r, int c, PieceColor attacker_color);
 
-// NEW: Checks if the player of 'player_color' has any legal moves on the current board
-bool has_any_legal_moves(const Piece board[8][8], PieceColor player_color);
+// NEW: Checks if the player of 'player_color' has any legal moves in the position
+bool has_any_legal_moves(const Position* pos, PieceColor player_color);
 
 // NEW: Checks for draw by insufficient material
 bool is_draw_by_insufficient_material(const Piece board[8][8]);
@@ -18,13 +24,19 @@ bool is_draw_by_insufficient_material(const Piece board[8][8]);
 // NEW: Checks if the king of 'king_color' is currently in check on the given board
 bool is_king_in_check(const Piece board[8][8], PieceColor king_color);
 
-bool is_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor player_turn);
+// Checkmate, stalemate, insufficient material or fifty-move draw for the side to move in
+// pos; repetition is not tracked here.
+GameState get_game_state(const Position* pos);
+
+// The en passant square and castling rights are taken from pos, so any copy of a game
+// position (e.g. one ply deep in the search) is checked against its own state.
+bool is_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor player_turn);
 
 // Piece-specific validation functions - existing ones will be updated
-bool is_pawn_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
+bool is_pawn_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
 bool is_rook_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
 bool is_knight_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
 bool is_bishop_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
 bool is_queen_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color);
-bool is_king_move_legal(const Piece board[8][8], int from_r, int from_c, int to_r, int to_c, PieceColor piece_color, bool check_castling_safety_and_normal_move);
+bool is_king_move_legal(const Position* pos, int from_r, int from_c, int to_r, int to_c, PieceColor piece_color, bool check_castling_safety_and_normal_move);
 #endif // RULES_H
\ No newline at end of file
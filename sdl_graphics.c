@@ -1,12 +1,27 @@
 #include "sdl_graphics.h"
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
+#include <stdint.h>
 
 // Define global SDL variables
 SDL_Window* g_window = NULL;
 SDL_Renderer* g_renderer = NULL;
 TTF_Font* g_font = NULL; // Define global font
-SDL_Texture* g_piece_textures[KING + 1][BLACK + 1];
+SDL_Texture* g_piece_atlas = NULL;
+
+int g_screen_width = DEFAULT_SCREEN_SIZE;
+int g_screen_height = DEFAULT_SCREEN_SIZE;
+int g_square_size = DEFAULT_SCREEN_SIZE / 8;
+
+#define ATLAS_COLUMNS KING // PAWN..KING
+#define ATLAS_ROWS 2       // WHITE, BLACK
+
+// Raw SVG sources, read from images/ once and kept in memory so a resize can
+// re-rasterize the atlas without touching the files again.
+static void* g_piece_svg_data[KING + 1][BLACK + 1];
+static size_t g_piece_svg_size[KING + 1][BLACK + 1];
+static uint32_t g_piece_svg_hash = 0; // Identifies the SVG set in the atlas cache file name
+static int g_atlas_square_size = 0;   // Square size the current atlas was rasterized at
 
 int init_sdl_graphics() {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -15,12 +30,13 @@ int init_sdl_graphics() {
     }
 
     g_window = SDL_CreateWindow("C Chess Engine", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                              SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+                              SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
     if (g_window == NULL) {
         printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
         SDL_Quit();
         return 0;
     }
+    SDL_SetWindowMinimumSize(g_window, MIN_SCREEN_SIZE, MIN_SCREEN_SIZE);
 
     g_renderer = SDL_CreateRenderer(g_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (g_renderer == NULL) {
@@ -51,7 +67,8 @@ int init_sdl_graphics() {
     
     for (int i = 0; i <= KING; ++i) {
         for (int j = 0; j <= BLACK; ++j) {
-            g_piece_textures[i][j] = NULL;
+            g_piece_svg_data[i][j] = NULL;
+            g_piece_svg_size[i][j] = 0;
         }
     }
 
@@ -70,32 +87,135 @@ int load_font(const char* path, int size) {
     return 1;
 }
 
-int load_media() {
+// Reads the twelve piece SVGs into memory. Returns false if any file is missing.
+static bool load_piece_svgs() {
     char filepath[100];
-    bool textures_loaded_ok = true;
+    bool all_loaded = true;
+    uint32_t hash = 2166136261u; // FNV-1a over every SVG, so edited sprites invalidate the atlas cache
 
     for (PieceType type = PAWN; type <= KING; ++type) {
         for (PieceColor color = WHITE; color <= BLACK; ++color) {
-            const char* type_str = get_piece_type_string(type);
-            const char* color_str = get_piece_color_string(color);
-
-            if (type_str && color_str) {
-                snprintf(filepath, sizeof(filepath), "images/%s-%s.svg", type_str, color_str);
-                SDL_Surface* loaded_surface = IMG_Load(filepath);
-                if (loaded_surface == NULL) {
-                    printf("Unable to load image %s! SDL_image Error: %s\n", filepath, IMG_GetError());
-                    textures_loaded_ok = false;
-                } else {
-                    g_piece_textures[type][color] = SDL_CreateTextureFromSurface(g_renderer, loaded_surface);
-                    if (g_piece_textures[type][color] == NULL) {
-                        printf("Unable to create texture from %s! SDL Error: %s\n", filepath, SDL_GetError());
-                        textures_loaded_ok = false;
-                    }
-                    SDL_FreeSurface(loaded_surface);
-                }
+            snprintf(filepath, sizeof(filepath), "images/%s-%s.svg", get_piece_type_string(type), get_piece_color_string(color));
+            g_piece_svg_data[type][color] = SDL_LoadFile(filepath, &g_piece_svg_size[type][color]);
+            if (g_piece_svg_data[type][color] == NULL) {
+                printf("Unable to read image %s! SDL Error: %s\n", filepath, SDL_GetError());
+                all_loaded = false;
+                continue;
+            }
+            const unsigned char* bytes = g_piece_svg_data[type][color];
+            for (size_t i = 0; i < g_piece_svg_size[type][color]; ++i) {
+                hash = (hash ^ bytes[i]) * 16777619u;
             }
         }
     }
+    g_piece_svg_hash = hash;
+    return all_loaded;
+}
+
+// Rasterizes one in-memory SVG to a size x size surface.
+static SDL_Surface* rasterize_piece(PieceType type, PieceColor color, int size) {
+    if (g_piece_svg_data[type][color] == NULL) return NULL;
+
+    SDL_RWops* rw = SDL_RWFromConstMem(g_piece_svg_data[type][color], (int)g_piece_svg_size[type][color]);
+    if (rw == NULL) return NULL;
+
+#if SDL_IMAGE_VERSION_ATLEAST(2, 6, 0)
+    // Render the vector data directly at the target resolution for crisp edges.
+    SDL_Surface* surface = IMG_LoadSizedSVG_RW(rw, size, size);
+    SDL_RWclose(rw);
+    return surface;
+#else
+    // Older SDL_image can only rasterize at the SVG's native size; scale afterwards.
+    SDL_Surface* native = IMG_Load_RW(rw, 1);
+    if (native == NULL) return NULL;
+    SDL_Surface* scaled = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGBA32);
+    if (scaled != NULL) {
+        SDL_Rect dest = {0, 0, size, size};
+        SDL_SetSurfaceBlendMode(native, SDL_BLENDMODE_NONE);
+        SDL_BlitScaled(native, NULL, scaled, &dest);
+    }
+    SDL_FreeSurface(native);
+    return scaled;
+#endif
+}
+
+static void get_atlas_cache_path(char* path, size_t path_size, int square_size) {
+    snprintf(path, path_size, "images/atlas-%d-%08x.bmp", square_size, (unsigned)g_piece_svg_hash);
+}
+
+// Builds the atlas surface for the given square size, either from the on-disk
+// cache or by rasterizing every SVG and then writing the cache.
+static SDL_Surface* build_atlas_surface(int square_size) {
+    char cache_path[100];
+    get_atlas_cache_path(cache_path, sizeof(cache_path), square_size);
+
+    SDL_Surface* cached = SDL_LoadBMP(cache_path);
+    if (cached != NULL) {
+        if (cached->w == ATLAS_COLUMNS * square_size && cached->h == ATLAS_ROWS * square_size) {
+            return cached;
+        }
+        SDL_FreeSurface(cached); // Stale or truncated cache, rebuild below
+    }
+
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_COLUMNS * square_size, ATLAS_ROWS * square_size, 32, SDL_PIXELFORMAT_RGBA32);
+    if (atlas == NULL) {
+        printf("Unable to create piece atlas surface! SDL Error: %s\n", SDL_GetError());
+        return NULL;
+    }
+    SDL_FillRect(atlas, NULL, 0); // Fully transparent background
+
+    for (PieceType type = PAWN; type <= KING; ++type) {
+        for (PieceColor color = WHITE; color <= BLACK; ++color) {
+            SDL_Surface* sprite = rasterize_piece(type, color, square_size);
+            if (sprite == NULL) {
+                printf("Unable to rasterize %s-%s! SDL_image Error: %s\n", get_piece_type_string(type), get_piece_color_string(color), IMG_GetError());
+                continue;
+            }
+            SDL_Rect cell = {(type - PAWN) * square_size, (color - WHITE) * square_size, square_size, square_size};
+            SDL_SetSurfaceBlendMode(sprite, SDL_BLENDMODE_NONE); // Copy alpha as-is instead of blending onto the atlas
+            SDL_BlitSurface(sprite, NULL, atlas, &cell);
+            SDL_FreeSurface(sprite);
+        }
+    }
+
+    if (SDL_SaveBMP(atlas, cache_path) != 0) {
+        printf("Could not write atlas cache %s: %s\n", cache_path, SDL_GetError());
+    }
+    return atlas;
+}
+
+// (Re)creates g_piece_atlas for the current SQUARE_SIZE. Cheap when the size is unchanged.
+static bool rebuild_piece_atlas() {
+    if (g_piece_atlas != NULL && g_atlas_square_size == SQUARE_SIZE) return true;
+
+    SDL_Surface* atlas_surface = build_atlas_surface(SQUARE_SIZE);
+    if (atlas_surface == NULL) return false;
+
+    SDL_Texture* atlas_texture = SDL_CreateTextureFromSurface(g_renderer, atlas_surface);
+    SDL_FreeSurface(atlas_surface);
+    if (atlas_texture == NULL) {
+        printf("Unable to create piece atlas texture! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas_texture, SDL_BLENDMODE_BLEND);
+
+    if (g_piece_atlas != NULL) SDL_DestroyTexture(g_piece_atlas);
+    g_piece_atlas = atlas_texture;
+    g_atlas_square_size = SQUARE_SIZE;
+    return true;
+}
+
+void handle_window_resize(int width, int height) {
+    g_screen_width = width;
+    g_screen_height = height;
+    g_square_size = ((width < height) ? width : height) / 8;
+    if (g_square_size < 1) g_square_size = 1;
+    rebuild_piece_atlas();
+}
+
+int load_media() {
+    bool textures_loaded_ok = load_piece_svgs();
+    if (!rebuild_piece_atlas()) textures_loaded_ok = false;
 
     // Load font - IMPORTANT: Make sure "font.ttf" exists in your execution directory or specify a correct path.
     if (!load_font("font.ttf", 24)) { // Using font size 24
@@ -133,24 +253,40 @@ void render_board_squares() {
     }
 }
 
-void render_pieces() {
-    SDL_Rect dest_rect;
-    dest_rect.w = SQUARE_SIZE;
-    dest_rect.h = SQUARE_SIZE;
+void render_pieces(const Piece board[8][8]) {
+    if (g_piece_atlas == NULL) return;
+
+    // Every piece is a textured quad from the same atlas, submitted in one draw call.
+    SDL_Vertex vertices[64 * 4];
+    int indices[64 * 6];
+    int num_vertices = 0, num_indices = 0;
+    const float cell_u = 1.0f / ATLAS_COLUMNS;
+    const float cell_v = 1.0f / ATLAS_ROWS;
+    const SDL_Color tint = {255, 255, 255, 255};
 
     for (int r = 0; r < 8; ++r) {
         for (int c = 0; c < 8; ++c) {
-            Piece current_piece = game_board[r][c];
-            if (current_piece.type != EMPTY) {
-                SDL_Texture* piece_texture = g_piece_textures[current_piece.type][current_piece.color];
-                if (piece_texture) {
-                    dest_rect.x = c * SQUARE_SIZE;
-                    dest_rect.y = r * SQUARE_SIZE;
-                    SDL_RenderCopy(g_renderer, piece_texture, NULL, &dest_rect);
-                }
-            }
+            Piece current_piece = board[r][c];
+            if (current_piece.type == EMPTY) continue;
+
+            float x0 = (float)(c * SQUARE_SIZE), y0 = (float)(r * SQUARE_SIZE);
+            float x1 = x0 + SQUARE_SIZE, y1 = y0 + SQUARE_SIZE;
+            float u0 = (current_piece.type - PAWN) * cell_u, v0 = (current_piece.color - WHITE) * cell_v;
+            float u1 = u0 + cell_u, v1 = v0 + cell_v;
+
+            int base = num_vertices;
+            vertices[num_vertices++] = (SDL_Vertex){{x0, y0}, tint, {u0, v0}};
+            vertices[num_vertices++] = (SDL_Vertex){{x1, y0}, tint, {u1, v0}};
+            vertices[num_vertices++] = (SDL_Vertex){{x1, y1}, tint, {u1, v1}};
+            vertices[num_vertices++] = (SDL_Vertex){{x0, y1}, tint, {u0, v1}};
+            indices[num_indices++] = base;     indices[num_indices++] = base + 1; indices[num_indices++] = base + 2;
+            indices[num_indices++] = base;     indices[num_indices++] = base + 2; indices[num_indices++] = base + 3;
         }
     }
+
+    if (num_indices > 0) {
+        SDL_RenderGeometry(g_renderer, g_piece_atlas, vertices, num_vertices, indices, num_indices);
+    }
 }
 
 void render_square_highlight(int r, int c, Uint8 R, Uint8 G, Uint8 B, Uint8 A) {
@@ -219,11 +355,15 @@ bool render_button(const char* text, SDL_Rect button_rect, SDL_Color bg_color, S
 
 
 void close_sdl_graphics() {
+    if (g_piece_atlas != NULL) {
+        SDL_DestroyTexture(g_piece_atlas);
+        g_piece_atlas = NULL;
+    }
     for (int type = PAWN; type <= KING; ++type) {
         for (int color = WHITE; color <= BLACK; ++color) {
-            if (g_piece_textures[type][color] != NULL) {
-                SDL_DestroyTexture(g_piece_textures[type][color]);
-                g_piece_textures[type][color] = NULL;
+            if (g_piece_svg_data[type][color] != NULL) {
+                SDL_free(g_piece_svg_data[type][color]);
+                g_piece_svg_data[type][color] = NULL;
             }
         }
     }
@@ -5,24 +5,37 @@
 #include <SDL2/SDL_ttf.h> // Include SDL_ttf header
 #include "board.h"       // For Piece definition
 
-#define SCREEN_WIDTH 480
-#define SCREEN_HEIGHT 480
-#define SQUARE_SIZE (SCREEN_WIDTH / 8)
+#define DEFAULT_SCREEN_SIZE 480
+#define MIN_SCREEN_SIZE 240
+
+// The window is resizable, so the layout is tracked at runtime.
+// The board is always square and sized to the smaller window dimension.
+extern int g_screen_width;
+extern int g_screen_height;
+extern int g_square_size;
+
+#define SCREEN_WIDTH g_screen_width
+#define SCREEN_HEIGHT g_screen_height
+#define SQUARE_SIZE g_square_size
 
 // Global SDL variables (managed by sdl_graphics.c)
 extern SDL_Window* g_window;
 extern SDL_Renderer* g_renderer;
 extern TTF_Font* g_font; // Global font
 
-// Texture array for pieces
-extern SDL_Texture* g_piece_textures[KING + 1][BLACK + 1];
+// All twelve piece sprites rasterized once at SQUARE_SIZE into a single texture.
+// Layout: one column per PieceType (PAWN..KING), row 0 = white, row 1 = black.
+extern SDL_Texture* g_piece_atlas;
 
 // Initializes SDL, creates window and renderer, initializes SDL_ttf
 int init_sdl_graphics();
 
-// Loads all piece textures and the font
+// Loads the piece SVGs into memory, builds the piece atlas and loads the font
 int load_media();
 
+// Rebuilds the piece atlas at the new square size after the window was resized
+void handle_window_resize(int width, int height);
+
 // Renders the chessboard squares
 void render_board_squares();
 
@@ -30,7 +43,7 @@ void render_board_squares();
 void render_square_highlight(int r, int c, Uint8 R, Uint8 G, Uint8 B, Uint8 A);
 
 // Renders the pieces on the board
-void render_pieces();
+void render_pieces(const Piece board[8][8]);
 
 // Renders text at a given position with a given color
 void render_text(const char* text, int x, int y, SDL_Color color, bool centered);
@@ -0,0 +1,692 @@
+// Headless self-play match runner.
+// Plays engine A against engine B from a set of openings (each opening twice, colours
+// swapped) at a fixed time control, with games spread over worker processes, and reports
+// the score, an Elo estimate and a sequential probability ratio test (SPRT) that stops the
+// match as soon as one hypothesis is accepted. An engine is either "self" (this build,
+// searched in-process) or the path of another build of this program, which is started as
+// '<path> --engine' and driven over pipes with a subset of the UCI protocol; that mode is
+// also how two builds of the engine are compared:
+//   ./selfplay -g 2000 -tc 10+0.1 build/release/selfplay ./selfplay
+#define _POSIX_C_SOURCE 200809L // For fork(), pipe(), poll(), kill() and sysconf()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "rules.h"
+#include "ai.h"
+#include "notation.h"
+#include "tablebase.h"
+#include "nnue.h"
+
+#define MAX_GAME_PLIES 400      // Adjudicated as a draw beyond this
+#define MAX_OPENINGS 1024
+#define MAX_PROTOCOL_LINE 8192  // "position ... moves" with MAX_GAME_PLIES moves fits easily
+#define MOVE_OVERHEAD_MS 10
+#define ENGINE_GRACE_MS 1000    // Extra wait for an external engine before it loses on time
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Built-in openings as moves from the start position, roughly balanced and varied.
+static const char* const builtin_openings[] = {
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",        // Ruy Lopez
+    "e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",        // Italian
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4",        // Sicilian
+    "e2e4 c7c5 b1c3 b8c6 g2g3 g7g6",        // Closed Sicilian
+    "e2e4 e7e6 d2d4 d7d5 b1c3 g8f6",        // French
+    "e2e4 c7c6 d2d4 d7d5 e4e5 c8f5",        // Caro-Kann
+    "e2e4 d7d6 d2d4 g8f6 b1c3 g7g6",        // Pirc
+    "e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",        // Scandinavian
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",        // Queen's Gambit Declined
+    "d2d4 d7d5 c2c4 c7c6 g1f3 g8f6",        // Slav
+    "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7",        // King's Indian
+    "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",        // Nimzo-Indian
+    "d2d4 g8f6 c2c4 c7c5 d4d5 e7e6",        // Benoni
+    "d2d4 f7f5 g2g3 g8f6 f1g2 e7e6",        // Dutch
+    "c2c4 e7e5 b1c3 g8f6 g2g3 d7d5",        // English
+    "g1f3 d7d5 g2g3 g8f6 f1g2 e7e6",        // Reti
+};
+#define NUM_BUILTIN_OPENINGS ((int)(sizeof(builtin_openings) / sizeof(builtin_openings[0])))
+
+typedef enum {
+    END_CHECKMATE, END_STALEMATE, END_INSUFFICIENT_MATERIAL, END_FIFTY_MOVES, END_REPETITION,
+    END_MOVE_LIMIT, END_TIME_FORFEIT, END_ILLEGAL_MOVE, END_NO_MOVE, NUM_END_REASONS
+} GameEndReason;
+
+static const char* const end_reason_names[NUM_END_REASONS] = {
+    "checkmate", "stalemate", "insufficient material", "fifty-move rule", "repetition",
+    "move limit", "time forfeit", "illegal move", "no move"
+};
+
+// Sent from a worker to the parent through a pipe; small enough for an atomic write().
+typedef struct {
+    int index;
+    int score_a; // Engine A's result in half points: 2 win, 1 draw, 0 loss
+    GameEndReason reason;
+    int plies;
+} GameResult;
+
+typedef struct {
+    int base_ms;     // 0 with movetime_ms > 0 for a fixed time per move
+    int increment_ms;
+    int movetime_ms;
+} MatchTimeControl;
+
+// One side of the match. External engines are started once per worker; "self" searches
+// with its own AIEngine, so two in-process sides never share search state.
+typedef struct {
+    const char* path; // NULL for "self"
+    AIEngine search;
+    pid_t pid;
+    FILE* to_engine;
+    int from_engine_fd;
+    char buffer[MAX_PROTOCOL_LINE];
+    size_t buffered;
+} Engine;
+
+// --- Moves in coordinate notation ---
+
+static bool parse_coordinate_move(const char* s, AIMove* move) {
+    if (s[0] < 'a' || s[0] > 'h' || s[1] < '1' || s[1] > '8' ||
+        s[2] < 'a' || s[2] > 'h' || s[3] < '1' || s[3] > '8') {
+        return false;
+    }
+    memset(move, 0, sizeof(*move));
+    move->from_c = s[0] - 'a';
+    move->from_r = '8' - s[1];
+    move->to_c = s[2] - 'a';
+    move->to_r = '8' - s[3];
+    switch (s[4]) {
+        case 'q': move->promotion_to = QUEEN; break;
+        case 'r': move->promotion_to = ROOK; break;
+        case 'b': move->promotion_to = BISHOP; break;
+        case 'n': move->promotion_to = KNIGHT; break;
+        default: move->promotion_to = EMPTY; break;
+    }
+    return true;
+}
+
+// Plays move for the side to move if it is legal; a promotion without a piece becomes a queen.
+static bool play_move(Game* game, const AIMove* move) {
+    Position* pos = &game->pos;
+    if (!is_move_legal(pos, move->from_r, move->from_c, move->to_r, move->to_c, pos->turn)) return false;
+    PieceType promotion = EMPTY;
+    if (pos->board[move->from_r][move->from_c].type == PAWN && (move->to_r == 0 || move->to_r == 7)) {
+        promotion = move->promotion_to != EMPTY ? move->promotion_to : QUEEN;
+    }
+    execute_move(game, move->from_r, move->from_c, move->to_r, move->to_c, promotion);
+    switch_player_turn(pos);
+    return true;
+}
+
+// Loads fen and plays the space-separated coordinate moves after it.
+static bool setup_position(Game* game, const char* fen, const char* moves) {
+    if (!load_fen(game, fen)) return false;
+    while (moves != NULL && *moves) {
+        while (*moves == ' ') moves++;
+        if (*moves == '\0' || *moves == '\n' || *moves == '\r') break;
+        AIMove move;
+        if (!parse_coordinate_move(moves, &move) || !play_move(game, &move)) return false;
+        while (*moves && *moves != ' ') moves++;
+    }
+    return true;
+}
+
+// The FEN without the move counters identifies a position for repetition detection.
+static void position_key(const Game* game, char* out) {
+    get_fen(game, out, MAX_FEN_LENGTH);
+    int spaces = 0;
+    for (char* p = out; *p; ++p) {
+        if (*p == ' ' && ++spaces == 4) { *p = '\0'; break; }
+    }
+}
+
+// --- Engine server (--engine) ---
+// Answers uci/isready/setoption (Hash)/ucinewgame/position/go/quit on stdin and stdout, one
+// search at a time.
+
+static void engine_go(AIEngine* engine, const Position* pos, const char* args) {
+    AISearchLimits limits = {0};
+    int wtime = 0, btime = 0, winc = 0, binc = 0;
+    const char* s = args;
+    while (*s) {
+        char token[32];
+        int value = 0, used = 0;
+        if (sscanf(s, "%31s %d%n", token, &value, &used) < 2) break;
+        if (strcmp(token, "wtime") == 0) wtime = value;
+        else if (strcmp(token, "btime") == 0) btime = value;
+        else if (strcmp(token, "winc") == 0) winc = value;
+        else if (strcmp(token, "binc") == 0) binc = value;
+        else if (strcmp(token, "movestogo") == 0) limits.clock.moves_to_go = value;
+        else if (strcmp(token, "movetime") == 0) limits.time_limit_ms = value;
+        else if (strcmp(token, "depth") == 0) limits.depth_limit = value;
+        else if (strcmp(token, "nodes") == 0) limits.node_limit = value;
+        s += used;
+    }
+    if (limits.time_limit_ms == 0) {
+        limits.clock.time_left_ms = pos->turn == WHITE ? wtime : btime;
+        limits.clock.increment_ms = pos->turn == WHITE ? winc : binc;
+        limits.clock.move_overhead_ms = MOVE_OVERHEAD_MS;
+    }
+
+    AIMove move;
+    char text[8] = "0000";
+    if (ai_search(engine, pos, &limits, &move, NULL)) move_to_coordinate(&move, text);
+    printf("bestmove %s\n", text);
+    fflush(stdout);
+}
+
+static int run_engine_server(void) {
+    static Game game;
+    AIEngine engine;
+    char line[MAX_PROTOCOL_LINE];
+    init_board(&game);
+    ai_engine_init(&engine, TT_DEFAULT_SIZE_MB);
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "uci") == 0) {
+            printf("id name chess-engine\noption name Hash type spin default %d min 1 max 1048576\nuciok\n", TT_DEFAULT_SIZE_MB);
+        } else if (strcmp(line, "isready") == 0) {
+            printf("readyok\n");
+        } else if (strncmp(line, "setoption name Hash value ", 26) == 0) {
+            long hash_mb = atol(line + 26);
+            if (hash_mb < 1 || !ai_engine_set_hash(&engine, (size_t)hash_mb)) printf("info string invalid hash size: %s\n", line);
+        } else if (strcmp(line, "ucinewgame") == 0) {
+            ai_reset_search_state(&engine); // Clears the transposition table in parallel when it is large
+        } else if (strncmp(line, "position ", 9) == 0) {
+            const char* s = line + 9;
+            char fen[MAX_FEN_LENGTH] = START_FEN;
+            if (strncmp(s, "fen ", 4) == 0) {
+                s += 4;
+                size_t len = strcspn(s, "m"); // Up to "moves"; FENs contain no 'm'
+                if (len >= sizeof(fen)) len = sizeof(fen) - 1;
+                memcpy(fen, s, len);
+                fen[len] = '\0';
+            }
+            const char* moves = strstr(s, "moves");
+            if (!setup_position(&game, fen, moves ? moves + 5 : NULL)) printf("info string invalid position: %s\n", line);
+        } else if (strncmp(line, "go", 2) == 0) {
+            engine_go(&engine, &game.pos, line + 2);
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        }
+        fflush(stdout);
+    }
+    ai_engine_free(&engine);
+    return 0;
+}
+
+// --- External engines ---
+
+static bool engine_start(Engine* engine) {
+    int to_child[2], from_child[2];
+    if (pipe(to_child) != 0) { perror("pipe"); return false; }
+    if (pipe(from_child) != 0) { perror("pipe"); close(to_child[0]); close(to_child[1]); return false; }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(to_child[0]); close(to_child[1]); close(from_child[0]); close(from_child[1]);
+        return false;
+    }
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]); close(to_child[1]); close(from_child[0]); close(from_child[1]);
+        execl(engine->path, engine->path, "--engine", (char*)NULL);
+        perror(engine->path);
+        _exit(127);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    engine->pid = pid;
+    engine->to_engine = fdopen(to_child[1], "w");
+    engine->from_engine_fd = from_child[0];
+    engine->buffered = 0;
+    return engine->to_engine != NULL;
+}
+
+static void engine_stop(Engine* engine) {
+    if (engine->path == NULL || engine->pid <= 0) return;
+    fprintf(engine->to_engine, "quit\n");
+    fclose(engine->to_engine);
+    close(engine->from_engine_fd);
+    kill(engine->pid, SIGTERM); // Harmless if it already quit; stops one that is still searching
+    waitpid(engine->pid, NULL, 0);
+    engine->pid = 0;
+}
+
+// Reads lines until one starts with prefix and copies it into out. False on EOF or timeout.
+static bool engine_wait_for(Engine* engine, const char* prefix, char* out, size_t out_size, int timeout_ms) {
+    unsigned int deadline = ai_get_ticks_ms() + (unsigned int)timeout_ms;
+    for (;;) {
+        char* newline;
+        while ((newline = memchr(engine->buffer, '\n', engine->buffered)) != NULL) {
+            *newline = '\0';
+            size_t line_length = (size_t)(newline - engine->buffer) + 1;
+            bool match = strncmp(engine->buffer, prefix, strlen(prefix)) == 0;
+            if (match) {
+                size_t n = line_length - 1 < out_size - 1 ? line_length - 1 : out_size - 1;
+                memcpy(out, engine->buffer, n);
+                out[n] = '\0';
+            }
+            memmove(engine->buffer, newline + 1, engine->buffered - line_length);
+            engine->buffered -= line_length;
+            if (match) return true;
+        }
+        if (engine->buffered == sizeof(engine->buffer)) engine->buffered = 0; // Overlong line: drop it
+
+        int remaining = (int)(deadline - ai_get_ticks_ms());
+        if (remaining <= 0) return false;
+        struct pollfd pfd = {engine->from_engine_fd, POLLIN, 0};
+        if (poll(&pfd, 1, remaining) <= 0) return false;
+        ssize_t n = read(engine->from_engine_fd, engine->buffer + engine->buffered, sizeof(engine->buffer) - engine->buffered);
+        if (n <= 0) return false;
+        engine->buffered += (size_t)n;
+    }
+}
+
+// --- Playing games ---
+
+typedef struct {
+    const char* fen;
+    const char* moves; // Opening moves after fen (may be NULL)
+} Opening;
+
+// Asks engine for a move in the game's current position (given as fen + moves_played to
+// external engines). Returns false if it failed to answer in time.
+static bool request_move(Engine* engine, const Game* game, const char* fen, const char* moves_played,
+                         const MatchTimeControl* tc, const int clock_ms[2], AIMove* move, bool* legal) {
+    *legal = true;
+    if (engine->path == NULL) {
+        AISearchLimits limits = {0};
+        if (tc->movetime_ms > 0) {
+            limits.time_limit_ms = tc->movetime_ms;
+        } else {
+            limits.clock.time_left_ms = clock_ms[game->pos.turn == WHITE ? 0 : 1];
+            limits.clock.increment_ms = tc->increment_ms;
+            limits.clock.move_overhead_ms = MOVE_OVERHEAD_MS;
+        }
+        return ai_search(&engine->search, &game->pos, &limits, move, NULL);
+    }
+
+    fprintf(engine->to_engine, "position fen %s moves%s\n", fen, moves_played);
+    int budget_ms;
+    if (tc->movetime_ms > 0) {
+        fprintf(engine->to_engine, "go movetime %d\n", tc->movetime_ms);
+        budget_ms = tc->movetime_ms;
+    } else {
+        fprintf(engine->to_engine, "go wtime %d btime %d winc %d binc %d\n",
+                clock_ms[0], clock_ms[1], tc->increment_ms, tc->increment_ms);
+        budget_ms = clock_ms[game->pos.turn == WHITE ? 0 : 1];
+    }
+    fflush(engine->to_engine);
+
+    char line[64];
+    if (!engine_wait_for(engine, "bestmove ", line, sizeof(line), budget_ms + ENGINE_GRACE_MS)) return false;
+    *legal = parse_coordinate_move(line + 9, move);
+    return true;
+}
+
+// Plays one game; engines[0] has White. Returns White's score in half points.
+static int play_game(Game* game, Engine* engines[2], const Opening* opening, const MatchTimeControl* tc,
+                     GameEndReason* reason, int* plies) {
+    static char keys[MAX_GAME_PLIES + 1][MAX_FEN_LENGTH];
+    static char moves_played[MAX_GAME_PLIES * 6 + 1];
+    char start_fen[MAX_FEN_LENGTH];
+
+    setup_position(game, opening->fen, opening->moves);
+    get_fen(game, start_fen, sizeof(start_fen)); // External engines get the position after the opening
+    load_fen(game, start_fen);                   // and the game record starts there
+    moves_played[0] = '\0';
+    position_key(game, keys[0]);
+    for (int i = 0; i < 2; ++i) {
+        if (engines[i]->path == NULL) {
+            ai_reset_search_state(&engines[i]->search);
+        } else {
+            fprintf(engines[i]->to_engine, "ucinewgame\n");
+            fflush(engines[i]->to_engine);
+        }
+    }
+
+    int clock_ms[2] = {tc->base_ms, tc->base_ms}; // White, Black
+    for (*plies = 0; *plies < MAX_GAME_PLIES; ) {
+        int side = game->pos.turn == WHITE ? 0 : 1;
+        int loser_score = side == 0 ? 0 : 2; // White's score if the side to move loses
+        Engine* engine = engines[side];
+
+        AIMove move;
+        bool legal;
+        unsigned int start = ai_get_ticks_ms();
+        bool answered = request_move(engine, game, start_fen, moves_played, tc, clock_ms, &move, &legal);
+        int elapsed = (int)(ai_get_ticks_ms() - start);
+        if (!answered) {
+            if (engine->path == NULL) { *reason = END_NO_MOVE; return loser_score; }
+            // An engine that does not answer is restarted for the next game
+            engine_stop(engine);
+            engine_start(engine);
+            *reason = END_TIME_FORFEIT;
+            return loser_score;
+        }
+        if (tc->movetime_ms == 0) {
+            clock_ms[side] -= elapsed;
+            if (clock_ms[side] < 0) { *reason = END_TIME_FORFEIT; return loser_score; }
+            clock_ms[side] += tc->increment_ms;
+        }
+        char text[8];
+        move_to_coordinate(&move, text);
+        if (!legal || !play_move(game, &move)) { *reason = END_ILLEGAL_MOVE; return loser_score; }
+        strcat(moves_played, " ");
+        strcat(moves_played, text);
+        ++*plies;
+
+        // Same adjudication as the GUI's check_game_over_conditions, plus repetition
+        switch (get_game_state(&game->pos)) {
+            case GAME_STATE_CHECKMATE_WHITE_WINS: *reason = END_CHECKMATE; return 2;
+            case GAME_STATE_CHECKMATE_BLACK_WINS: *reason = END_CHECKMATE; return 0;
+            case GAME_STATE_STALEMATE: *reason = END_STALEMATE; return 1;
+            case GAME_STATE_DRAW_INSUFFICIENT_MATERIAL: *reason = END_INSUFFICIENT_MATERIAL; return 1;
+            case GAME_STATE_DRAW_50_MOVE_RULE: *reason = END_FIFTY_MOVES; return 1;
+            default: break;
+        }
+        position_key(game, keys[*plies]);
+        int repetitions = 1;
+        for (int i = *plies - 2; i >= 0 && i >= *plies - game->pos.halfmove_clock; i -= 2) {
+            if (strcmp(keys[i], keys[*plies]) == 0) ++repetitions;
+        }
+        if (repetitions >= 3) { *reason = END_REPETITION; return 1; }
+    }
+    *reason = END_MOVE_LIMIT;
+    return 1;
+}
+
+// Game index i plays opening i / 2, with engine A as White for even i.
+static void run_worker(const Opening* openings, int num_openings, int num_games, int worker, int jobs,
+                       const char* engine_paths[2], const MatchTimeControl* tc, size_t hash_mb, int out_fd) {
+    static Game game;
+    static Engine engines[2];
+    for (int e = 0; e < 2; ++e) {
+        engines[e].path = engine_paths[e];
+        if (engines[e].path == NULL) {
+            ai_engine_init(&engines[e].search, hash_mb);
+            continue;
+        }
+        if (!engine_start(&engines[e])) return;
+        fprintf(engines[e].to_engine, "setoption name Hash value %zu\n", hash_mb);
+        fflush(engines[e].to_engine);
+    }
+
+    for (int i = worker; i < num_games; i += jobs) {
+        bool a_is_white = (i % 2) == 0;
+        Engine* players[2] = {a_is_white ? &engines[0] : &engines[1], a_is_white ? &engines[1] : &engines[0]};
+        GameResult result = {0};
+        result.index = i;
+        int white_score = play_game(&game, players, &openings[(i / 2) % num_openings], tc, &result.reason, &result.plies);
+        result.score_a = a_is_white ? white_score : 2 - white_score;
+        if (write(out_fd, &result, sizeof(result)) != (ssize_t)sizeof(result)) break;
+    }
+    for (int e = 0; e < 2; ++e) {
+        if (engines[e].path == NULL) ai_engine_free(&engines[e].search);
+        else engine_stop(&engines[e]);
+    }
+}
+
+// --- Statistics ---
+
+static double elo_to_score(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+static double score_to_elo(double score) {
+    if (score <= 0.0) return -INFINITY;
+    if (score >= 1.0) return INFINITY;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+typedef struct {
+    int wins, draws, losses; // From engine A's point of view
+} MatchScore;
+
+// Mean score and per-game variance of the results.
+static void score_moments(const MatchScore* m, double* mean, double* variance) {
+    int n = m->wins + m->draws + m->losses;
+    *mean = (m->wins + 0.5 * m->draws) / n;
+    *variance = (m->wins * pow(1.0 - *mean, 2) + m->draws * pow(0.5 - *mean, 2) + m->losses * pow(*mean, 2)) / n;
+}
+
+// Log-likelihood ratio of elo1 against elo0 under the normal approximation of the
+// trinomial (win/draw/loss) model.
+static double sprt_llr(const MatchScore* m, double elo0, double elo1) {
+    int n = m->wins + m->draws + m->losses;
+    if (n == 0 || m->wins + m->losses == 0) return 0.0;
+    double mean, variance;
+    score_moments(m, &mean, &variance);
+    if (variance <= 0.0) return 0.0;
+    double s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
+    return n * (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance);
+}
+
+static void print_elo(const MatchScore* m) {
+    int n = m->wins + m->draws + m->losses;
+    double mean, variance;
+    score_moments(m, &mean, &variance);
+    double margin = 1.96 * sqrt(variance / n); // 95% interval of the mean score
+    double elo = score_to_elo(mean);
+    double low = score_to_elo(mean - margin), high = score_to_elo(mean + margin);
+    printf("Score of A vs B: %d - %d - %d [%.3f] %d games\n", m->wins, m->losses, m->draws, mean, n);
+    if (variance <= 0.0 && isfinite(elo)) { // Only when every game was drawn
+        printf("Elo difference: 0.0 (every game drawn, no interval)\n");
+    } else if (isfinite(low) && isfinite(high)) {
+        printf("Elo difference: %.1f +/- %.1f (95%%)\n", elo, (high - low) / 2.0);
+    } else if (isfinite(elo)) {
+        printf("Elo difference: %.1f (too few games for an interval)\n", elo);
+    } else {
+        printf("Elo difference: %s (no game was won by the other side)\n", elo > 0 ? "+inf" : "-inf");
+    }
+}
+
+// --- Openings ---
+
+static int load_openings(const char* path, Opening* openings, char (*storage)[MAX_FEN_LENGTH]) {
+    static Game game;
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Could not open opening file %s\n", path);
+        return 0;
+    }
+    int count = 0;
+    char line[MAX_PROTOCOL_LINE];
+    while (count < MAX_OPENINGS && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+        if (!load_fen(&game, line)) {
+            printf("Skipping invalid FEN: %s\n", line);
+            continue;
+        }
+        get_fen(&game, storage[count], MAX_FEN_LENGTH); // EPD lines without move counters become full FENs
+        openings[count].fen = storage[count];
+        openings[count].moves = NULL;
+        ++count;
+    }
+    fclose(f);
+    return count;
+}
+
+static bool parse_time_control(const char* s, MatchTimeControl* tc) {
+    double base, increment = 0.0;
+    int fields = sscanf(s, "%lf+%lf", &base, &increment);
+    if (fields < 1 || base <= 0.0 || increment < 0.0) return false;
+    tc->base_ms = (int)(base * 1000.0);
+    tc->increment_ms = (int)(increment * 1000.0);
+    tc->movetime_ms = 0;
+    return true;
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [options] [engineA [engineB]]\n", program_name);
+    printf("       %s --engine\n", program_name);
+    printf("  engineA/B   'self' (default) or the path of another build of this program\n");
+    printf("  -g games    Number of games (default 100; rounded up to an even number)\n");
+    printf("  -j jobs     Games played at the same time (default: number of CPUs)\n");
+    printf("  -tc s+inc   Clock per game in seconds plus increment per move (default 10+0.1)\n");
+    printf("  -m ms       Fixed time per move instead of a clock\n");
+    printf("  -H MB       Transposition table size of each engine (default %d)\n", TT_DEFAULT_SIZE_MB);
+    printf("  -o file     Openings, one FEN or EPD per line (default: %d built-in openings)\n", NUM_BUILTIN_OPENINGS);
+    printf("  -sprt e0 e1 SPRT hypotheses in Elo (default 0 5)\n");
+    printf("  -alpha a    SPRT type I error (default 0.05)\n");
+    printf("  -beta b     SPRT type II error (default 0.05)\n");
+    printf("  -T dir      Endgame tablebase directory for 'self' (built with tbgen)\n");
+    printf("  -N net      NNUE network file for 'self'\n");
+    printf("  --engine    Serve this build as an engine on stdin/stdout (used for engineA/B)\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && strcmp(argv[1], "--engine") == 0) return run_engine_server();
+
+    int num_games = 100;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long hash_mb = TT_DEFAULT_SIZE_MB;
+    MatchTimeControl tc = {10000, 100, 0};
+    double elo0 = 0.0, elo1 = 5.0, alpha = 0.05, beta = 0.05;
+    const char* openings_path = NULL;
+    const char* engine_paths[2] = {NULL, NULL};
+    int num_engines = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) num_games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-tc") == 0 && i + 1 < argc) {
+            if (!parse_time_control(argv[++i], &tc)) { print_usage(argv[0]); return 1; }
+        }
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) tc.movetime_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) hash_mb = atol(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) openings_path = argv[++i];
+        else if (strcmp(argv[i], "-sprt") == 0 && i + 2 < argc) { elo0 = atof(argv[++i]); elo1 = atof(argv[++i]); }
+        else if (strcmp(argv[i], "-alpha") == 0 && i + 1 < argc) alpha = atof(argv[++i]);
+        else if (strcmp(argv[i], "-beta") == 0 && i + 1 < argc) beta = atof(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) tb_init(argv[++i]);
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) { if (!nnue_load(argv[++i])) return 1; }
+        else if (argv[i][0] != '-' && num_engines < 2) {
+            engine_paths[num_engines++] = strcmp(argv[i], "self") == 0 ? NULL : argv[i];
+        }
+        else { print_usage(argv[0]); return 1; }
+    }
+    if (num_games < 2 || hash_mb < 1 || elo1 <= elo0 || alpha <= 0.0 || alpha >= 0.5 || beta <= 0.0 || beta >= 0.5) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    num_games += num_games % 2; // Every opening is played with both colours
+    if (jobs < 1) jobs = 1;
+    if (jobs > num_games) jobs = num_games;
+
+    static Opening openings[MAX_OPENINGS];
+    static char opening_fens[MAX_OPENINGS][MAX_FEN_LENGTH];
+    int num_openings;
+    if (openings_path != NULL) {
+        num_openings = load_openings(openings_path, openings, opening_fens);
+        if (num_openings == 0) { printf("No openings to play.\n"); return 1; }
+    } else {
+        num_openings = NUM_BUILTIN_OPENINGS;
+        for (int i = 0; i < num_openings; ++i) {
+            openings[i].fen = START_FEN;
+            openings[i].moves = builtin_openings[i];
+        }
+    }
+
+    double lower_bound = log(beta / (1.0 - alpha));
+    double upper_bound = log((1.0 - beta) / alpha);
+    if (tc.movetime_ms > 0) printf("Playing %d games on %d worker(s), %d ms per move\n", num_games, jobs, tc.movetime_ms);
+    else printf("Playing %d games on %d worker(s), %.1f+%.2f s\n", num_games, jobs, tc.base_ms / 1000.0, tc.increment_ms / 1000.0);
+    printf("A: %s, B: %s, %d openings\n", engine_paths[0] ? engine_paths[0] : "self",
+           engine_paths[1] ? engine_paths[1] : "self", num_openings);
+    printf("SPRT: elo0 %.1f, elo1 %.1f, alpha %.3f, beta %.3f, LLR bounds [%.2f, %.2f]\n\n",
+           elo0, elo1, alpha, beta, lower_bound, upper_bound);
+    fflush(stdout); // Children inherit the stdio buffer
+
+    int result_pipe[2];
+    if (pipe(result_pipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t* workers = calloc((size_t)jobs, sizeof(pid_t));
+    if (workers == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int w = 0; w < jobs; ++w) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            // The workers already running stride over the games by jobs, so with fewer of
+            // them some games would silently never be played
+            perror("fork");
+            for (int started = 0; started < w; ++started) kill(workers[started], SIGTERM);
+            while (wait(NULL) > 0) {}
+            free(workers);
+            return 1;
+        }
+        if (pid == 0) {
+            close(result_pipe[0]);
+            ai_init_random();
+            run_worker(openings, num_openings, num_games, w, jobs, engine_paths, &tc, (size_t)hash_mb, result_pipe[1]);
+            close(result_pipe[1]);
+            _exit(0);
+        }
+        workers[w] = pid;
+    }
+    close(result_pipe[1]);
+
+    MatchScore score = {0, 0, 0};
+    int reasons[NUM_END_REASONS] = {0};
+    long total_plies = 0;
+    double llr = 0.0;
+    const char* verdict = NULL;
+    GameResult incoming;
+    while (read(result_pipe[0], &incoming, sizeof(incoming)) == (ssize_t)sizeof(incoming)) {
+        if (incoming.score_a == 2) score.wins++;
+        else if (incoming.score_a == 1) score.draws++;
+        else score.losses++;
+        if (incoming.reason >= 0 && incoming.reason < NUM_END_REASONS) reasons[incoming.reason]++;
+        total_plies += incoming.plies;
+        llr = sprt_llr(&score, elo0, elo1);
+
+        int played = score.wins + score.draws + score.losses;
+        printf("Game %4d/%d (opening %d, A %s): %s by %s, %d plies  [+%d =%d -%d]  LLR %.2f\n",
+               played, num_games, incoming.index / 2 % num_openings + 1, incoming.index % 2 == 0 ? "White" : "Black",
+               incoming.score_a == 2 ? "A wins" : (incoming.score_a == 1 ? "draw" : "B wins"),
+               end_reason_names[incoming.reason], incoming.plies, score.wins, score.draws, score.losses, llr);
+        fflush(stdout);
+
+        if (llr >= upper_bound) verdict = "H1 accepted: A is stronger by at least elo1";
+        else if (llr <= lower_bound) verdict = "H0 accepted: A is not stronger by elo1";
+        if (verdict != NULL) {
+            for (int w = 0; w < jobs; ++w) kill(workers[w], SIGTERM); // Their engines see EOF and quit
+            break;
+        }
+    }
+    close(result_pipe[0]);
+    while (wait(NULL) > 0) {}
+    free(workers);
+
+    int played = score.wins + score.draws + score.losses;
+    if (played == 0) {
+        printf("No games were played.\n");
+        return 1;
+    }
+    printf("\n");
+    print_elo(&score);
+    printf("SPRT: LLR %.2f [%.2f, %.2f] - %s\n", llr, lower_bound, upper_bound,
+           verdict ? verdict : "inconclusive, play more games");
+    printf("Average game length: %.1f plies\n", (double)total_plies / played);
+    printf("Game endings:");
+    const char* separator = " ";
+    for (int r = 0; r < NUM_END_REASONS; ++r) {
+        if (reasons[r] == 0) continue;
+        printf("%s%s %d", separator, end_reason_names[r], reasons[r]);
+        separator = ", ";
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,526 @@
+#define _POSIX_C_SOURCE 200809L // For mmap() and fstat()
+#include "tablebase.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// File layout: 8-byte header ("CETB", version, piece count, 2 reserved bytes), then one
+// byte per position in index order.
+#define TB_MAGIC "CETB"
+#define TB_VERSION 1
+#define TB_HEADER_SIZE 8
+#define TB_MAX_TABLES 128
+#define TB_MAX_PATH 1024
+
+static TBTable tables[TB_MAX_TABLES];
+static int num_tables = 0;
+static char tb_directory[TB_MAX_PATH];
+static bool tb_enabled = false;
+// Tables are mapped on first use, so probes from several search threads (analysis_server)
+// add to the table list concurrently; the mapped data itself is read-only.
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Pieces inside one side of a signature, strongest first
+static const char signature_letters[] = "QRBNP";
+static const PieceType signature_types[] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+static const int signature_values[] = {9, 5, 3, 3, 1};
+
+void tb_init(const char* directory) {
+    tb_free();
+    snprintf(tb_directory, sizeof(tb_directory), "%s", directory);
+    tb_enabled = true;
+}
+
+void tb_free(void) {
+    for (int i = 0; i < num_tables; ++i) {
+        if (tables[i].data) munmap((void*)(tables[i].data - TB_HEADER_SIZE), tables[i].map_size);
+    }
+    num_tables = 0;
+    tb_enabled = false;
+}
+
+bool tb_is_enabled(void) {
+    return tb_enabled;
+}
+
+// --- Signatures ---
+
+bool tb_parse_signature(const char* name, TBTable* table) {
+    memset(table, 0, sizeof(*table));
+    const char* v = strchr(name, 'v');
+    if (v == NULL || name[0] != 'K' || v[1] != 'K' || strlen(name) >= TB_MAX_NAME) return false;
+
+    int n = 0;
+    table->type[n] = KING; table->color[n++] = WHITE;
+    table->type[n] = KING; table->color[n++] = BLACK;
+    for (const char* p = name + 1; *p; ++p) {
+        if (p == v || p == v + 1) continue;
+        const char* letter = strchr(signature_letters, *p);
+        if (letter == NULL || n == TB_MAX_PIECES) return false;
+        table->type[n] = signature_types[letter - signature_letters];
+        table->color[n] = (p < v) ? WHITE : BLACK;
+        if (table->type[n] == PAWN) table->has_pawns = true;
+        ++n;
+    }
+    table->num_pieces = n;
+    snprintf(table->name, sizeof(table->name), "%s", name);
+
+    size_t king_squares = table->has_pawns ? 32 : 10;
+    table->size = 2 * king_squares;
+    for (int i = 1; i < n; ++i) table->size *= 64;
+    return true;
+}
+
+static void side_signature(const TBPosition* pos, PieceColor color, char* out, int* value) {
+    int count = 0;
+    *value = 0;
+    out[count++] = 'K';
+    for (int rank = 0; rank < 5; ++rank) {
+        for (int i = 0; i < pos->num_pieces; ++i) {
+            if (pos->color[i] == color && pos->type[i] == signature_types[rank]) {
+                out[count++] = signature_letters[rank];
+                *value += signature_values[rank];
+            }
+        }
+    }
+    out[count] = '\0';
+}
+
+void tb_signature_of(const TBPosition* pos, char* name, bool* flipped) {
+    char white[TB_MAX_NAME], black[TB_MAX_NAME];
+    int white_value, black_value;
+    side_signature(pos, WHITE, white, &white_value);
+    side_signature(pos, BLACK, black, &black_value);
+
+    // Stronger side first: more material, then more pieces, then the later name
+    int white_len = (int)strlen(white), black_len = (int)strlen(black);
+    if (white_value != black_value) *flipped = black_value > white_value;
+    else if (white_len != black_len) *flipped = black_len > white_len;
+    else *flipped = strcmp(black, white) > 0;
+    snprintf(name, TB_MAX_NAME, "%sv%s", *flipped ? black : white, *flipped ? white : black);
+}
+
+void tb_flip_position(TBPosition* pos) {
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        pos->sq[i] = (7 - pos->sq[i] / 8) * 8 + pos->sq[i] % 8;
+        pos->color[i] = (pos->color[i] == WHITE) ? BLACK : WHITE;
+    }
+    pos->side_to_move = (pos->side_to_move == WHITE) ? BLACK : WHITE;
+}
+
+// --- Indexing ---
+// The white king is mapped by symmetry into files a-d (tables with pawns) or into the
+// a8-d8-d5 triangle (pawnless tables, which are symmetric under all 8 board symmetries).
+
+static const int triangle_row[10] = {0, 1, 1, 2, 2, 2, 3, 3, 3, 3};
+static const int triangle_col[10] = {0, 0, 1, 0, 1, 2, 0, 1, 2, 3};
+
+// Index of a placement already mapped into the king's region. Identical pieces are
+// sorted so every position has exactly one index.
+static size_t placement_index(const TBTable* table, int r[], int c[], PieceColor side_to_move) {
+    int sq[TB_MAX_PIECES];
+    int n = table->num_pieces;
+    for (int i = 0; i < n; ++i) sq[i] = r[i] * 8 + c[i];
+    for (int i = 2; i < n; ++i) {
+        for (int j = i; j > 2 && table->type[j - 1] == table->type[j] && table->color[j - 1] == table->color[j] && sq[j - 1] > sq[j]; --j) {
+            int t = sq[j]; sq[j] = sq[j - 1]; sq[j - 1] = t;
+        }
+    }
+    int king_index = table->has_pawns ? r[0] * 4 + c[0] : r[0] * (r[0] + 1) / 2 + c[0];
+    size_t index = (side_to_move == WHITE ? 0 : 1) * (table->has_pawns ? 32 : 10) + (size_t)king_index;
+    for (int i = 1; i < n; ++i) index = index * 64 + (size_t)sq[i];
+    return index;
+}
+
+size_t tb_index_of(const TBTable* table, const TBPosition* pos) {
+    int r[TB_MAX_PIECES] = {0}, c[TB_MAX_PIECES] = {0}; // A piece missing from pos counts as on a8
+    bool used[TB_MAX_PIECES] = {false};
+    for (int slot = 0; slot < table->num_pieces; ++slot) {
+        for (int i = 0; i < pos->num_pieces; ++i) {
+            if (!used[i] && pos->type[i] == table->type[slot] && pos->color[i] == table->color[slot]) {
+                used[i] = true;
+                r[slot] = pos->sq[i] / 8;
+                c[slot] = pos->sq[i] % 8;
+                break;
+            }
+        }
+    }
+
+    int n = table->num_pieces;
+    if (c[0] > 3) for (int i = 0; i < n; ++i) c[i] = 7 - c[i];
+    if (table->has_pawns) return placement_index(table, r, c, pos->side_to_move);
+
+    if (r[0] > 3) for (int i = 0; i < n; ++i) r[i] = 7 - r[i];
+    if (c[0] > r[0]) for (int i = 0; i < n; ++i) { int t = r[i]; r[i] = c[i]; c[i] = t; }
+    size_t index = placement_index(table, r, c, pos->side_to_move);
+    if (r[0] == c[0]) {
+        // King on the diagonal: the position and its mirror image both fit, take the smaller index
+        size_t mirrored = placement_index(table, c, r, pos->side_to_move);
+        if (mirrored < index) index = mirrored;
+    }
+    return index;
+}
+
+bool tb_decode(const TBTable* table, size_t index, TBPosition* pos) {
+    int n = table->num_pieces;
+    pos->num_pieces = n;
+    size_t rest = index;
+    for (int i = n - 1; i >= 1; --i) {
+        pos->sq[i] = (int)(rest % 64);
+        rest /= 64;
+    }
+    size_t king_squares = table->has_pawns ? 32 : 10;
+    int king_index = (int)(rest % king_squares);
+    pos->side_to_move = (rest / king_squares == 0) ? WHITE : BLACK;
+    pos->sq[0] = table->has_pawns ? (king_index / 4) * 8 + king_index % 4
+                                  : triangle_row[king_index] * 8 + triangle_col[king_index];
+    for (int i = 0; i < n; ++i) {
+        pos->type[i] = table->type[i];
+        pos->color[i] = table->color[i];
+    }
+
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 1; j < n; ++j) if (pos->sq[i] == pos->sq[j]) return false;
+        int row = pos->sq[i] / 8;
+        if (pos->type[i] == PAWN && (row == 0 || row == 7)) return false;
+    }
+    // Side not to move in check also covers adjacent kings. Positions stored under another
+    // index (a symmetric or reordered twin) are left out so each position is solved once.
+    return !tb_in_check(pos, pos->side_to_move == WHITE ? BLACK : WHITE) && tb_index_of(table, pos) == index;
+}
+
+// --- Move Generation ---
+
+static const int king_steps[8][2] = {{-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1}};
+static const int knight_jumps[8][2] = {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}};
+
+static int piece_at(const TBPosition* pos, int sq) {
+    for (int i = 0; i < pos->num_pieces; ++i) if (pos->sq[i] == sq) return i;
+    return -1;
+}
+
+static bool path_is_clear(const TBPosition* pos, int from, int to) {
+    int dr = (to / 8 > from / 8) - (to / 8 < from / 8);
+    int dc = (to % 8 > from % 8) - (to % 8 < from % 8);
+    for (int sq = from + dr * 8 + dc; sq != to; sq += dr * 8 + dc) {
+        if (piece_at(pos, sq) >= 0) return false;
+    }
+    return true;
+}
+
+bool tb_square_attacked(const TBPosition* pos, int sq, PieceColor attacker) {
+    int tr = sq / 8, tc = sq % 8;
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->color[i] != attacker || pos->sq[i] == sq) continue;
+        int dr = tr - pos->sq[i] / 8, dc = tc - pos->sq[i] % 8;
+        int adr = abs(dr), adc = abs(dc);
+        switch (pos->type[i]) {
+            case PAWN:
+                if (adc == 1 && dr == (attacker == WHITE ? -1 : 1)) return true;
+                break;
+            case KNIGHT:
+                if ((adr == 1 && adc == 2) || (adr == 2 && adc == 1)) return true;
+                break;
+            case KING:
+                if (adr <= 1 && adc <= 1) return true;
+                break;
+            case BISHOP:
+                if (adr == adc && path_is_clear(pos, pos->sq[i], sq)) return true;
+                break;
+            case ROOK:
+                if ((dr == 0 || dc == 0) && path_is_clear(pos, pos->sq[i], sq)) return true;
+                break;
+            case QUEEN:
+                if ((adr == adc || dr == 0 || dc == 0) && path_is_clear(pos, pos->sq[i], sq)) return true;
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+bool tb_in_check(const TBPosition* pos, PieceColor color) {
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->type[i] == KING && pos->color[i] == color) {
+            return tb_square_attacked(pos, pos->sq[i], color == WHITE ? BLACK : WHITE);
+        }
+    }
+    return false;
+}
+
+// Moves piece i to sq (capturing whatever is there) and hands the move to the other side.
+// Returns false if the move leaves the mover's king in check.
+static bool make_child(const TBPosition* pos, int i, int sq, PieceType promotion, TBPosition* child, bool* captured) {
+    *child = *pos;
+    int victim = piece_at(pos, sq);
+    *captured = victim >= 0;
+    child->sq[i] = sq;
+    if (promotion != EMPTY) child->type[i] = promotion;
+    if (victim >= 0) {
+        child->num_pieces--;
+        child->sq[victim] = child->sq[child->num_pieces];
+        child->type[victim] = child->type[child->num_pieces];
+        child->color[victim] = child->color[child->num_pieces];
+    }
+    child->side_to_move = (pos->side_to_move == WHITE) ? BLACK : WHITE;
+    return !tb_in_check(child, pos->side_to_move);
+}
+
+static int add_child(const TBPosition* pos, int i, int sq, TBPosition children[], bool conversion[], int count) {
+    static const PieceType promotions[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+    int row = sq / 8;
+    bool promotes = pos->type[i] == PAWN && (row == 0 || row == 7);
+    for (int p = 0; p < (promotes ? 4 : 1); ++p) {
+        bool captured;
+        if (make_child(pos, i, sq, promotes ? promotions[p] : EMPTY, &children[count], &captured)) {
+            conversion[count++] = captured || promotes;
+        }
+    }
+    return count;
+}
+
+int tb_generate_moves(const TBPosition* pos, TBPosition children[], bool conversion[]) {
+    int count = 0;
+    PieceColor us = pos->side_to_move;
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->color[i] != us) continue;
+        int r = pos->sq[i] / 8, c = pos->sq[i] % 8;
+        switch (pos->type[i]) {
+            case PAWN: {
+                int dir = (us == WHITE) ? -1 : 1;
+                int start_row = (us == WHITE) ? 6 : 1;
+                int one = (r + dir) * 8 + c;
+                if (piece_at(pos, one) < 0) {
+                    count = add_child(pos, i, one, children, conversion, count);
+                    int two = (r + 2 * dir) * 8 + c;
+                    if (r == start_row && piece_at(pos, two) < 0) count = add_child(pos, i, two, children, conversion, count);
+                }
+                for (int dc = -1; dc <= 1; dc += 2) {
+                    if (c + dc < 0 || c + dc > 7) continue;
+                    int target = piece_at(pos, (r + dir) * 8 + c + dc);
+                    if (target >= 0 && pos->color[target] != us) {
+                        count = add_child(pos, i, (r + dir) * 8 + c + dc, children, conversion, count);
+                    }
+                }
+                break;
+            }
+            case KNIGHT:
+            case KING: {
+                const int (*steps)[2] = (pos->type[i] == KING) ? king_steps : knight_jumps;
+                for (int d = 0; d < 8; ++d) {
+                    int tr = r + steps[d][0], tc = c + steps[d][1];
+                    if (tr < 0 || tr > 7 || tc < 0 || tc > 7) continue;
+                    int target = piece_at(pos, tr * 8 + tc);
+                    if (target >= 0 && pos->color[target] == us) continue;
+                    count = add_child(pos, i, tr * 8 + tc, children, conversion, count);
+                }
+                break;
+            }
+            default: { // Sliders
+                for (int d = 0; d < 8; ++d) {
+                    int dr = king_steps[d][0], dc = king_steps[d][1];
+                    bool diagonal = dr != 0 && dc != 0;
+                    if ((pos->type[i] == BISHOP && !diagonal) || (pos->type[i] == ROOK && diagonal)) continue;
+                    for (int tr = r + dr, tc = c + dc; tr >= 0 && tr <= 7 && tc >= 0 && tc <= 7; tr += dr, tc += dc) {
+                        int target = piece_at(pos, tr * 8 + tc);
+                        if (target >= 0 && pos->color[target] == us) break;
+                        count = add_child(pos, i, tr * 8 + tc, children, conversion, count);
+                        if (target >= 0) break;
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static int add_parent(const TBPosition* pos, int i, int sq, TBPosition parents[], int count) {
+    TBPosition* parent = &parents[count];
+    *parent = *pos;
+    parent->sq[i] = sq;
+    parent->side_to_move = pos->color[i];
+    // The side to move in pos is not to move in the parent, so it must not be in check there
+    if (tb_in_check(parent, pos->side_to_move)) return count;
+    return count + 1;
+}
+
+int tb_generate_unmoves(const TBPosition* pos, TBPosition parents[]) {
+    int count = 0;
+    PieceColor them = (pos->side_to_move == WHITE) ? BLACK : WHITE;
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->color[i] != them) continue;
+        int r = pos->sq[i] / 8, c = pos->sq[i] % 8;
+        switch (pos->type[i]) {
+            case PAWN: {
+                int back = (them == WHITE) ? 1 : -1; // Pawns only move forward, so they came from behind
+                int one_row = r + back;
+                if (one_row < 1 || one_row > 6 || piece_at(pos, one_row * 8 + c) >= 0) break;
+                count = add_parent(pos, i, one_row * 8 + c, parents, count);
+                int double_row = (them == WHITE) ? 4 : 3;
+                if (r == double_row && piece_at(pos, (r + 2 * back) * 8 + c) < 0) {
+                    count = add_parent(pos, i, (r + 2 * back) * 8 + c, parents, count);
+                }
+                break;
+            }
+            case KNIGHT:
+            case KING: {
+                const int (*steps)[2] = (pos->type[i] == KING) ? king_steps : knight_jumps;
+                for (int d = 0; d < 8; ++d) {
+                    int fr = r + steps[d][0], fc = c + steps[d][1];
+                    if (fr < 0 || fr > 7 || fc < 0 || fc > 7 || piece_at(pos, fr * 8 + fc) >= 0) continue;
+                    count = add_parent(pos, i, fr * 8 + fc, parents, count);
+                }
+                break;
+            }
+            default: {
+                for (int d = 0; d < 8; ++d) {
+                    int dr = king_steps[d][0], dc = king_steps[d][1];
+                    bool diagonal = dr != 0 && dc != 0;
+                    if ((pos->type[i] == BISHOP && !diagonal) || (pos->type[i] == ROOK && diagonal)) continue;
+                    for (int fr = r + dr, fc = c + dc; fr >= 0 && fr <= 7 && fc >= 0 && fc <= 7; fr += dr, fc += dc) {
+                        if (piece_at(pos, fr * 8 + fc) >= 0) break;
+                        count = add_parent(pos, i, fr * 8 + fc, parents, count);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// --- Table Files ---
+
+static void table_path(const char* name, char* out, size_t out_size) {
+    snprintf(out, out_size, "%s/%s%s", tb_directory, name, TB_FILE_EXTENSION);
+}
+
+static void map_table(TBTable* table) {
+    char path[TB_MAX_PATH + TB_MAX_NAME + 8];
+    table_path(table->name, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { table->missing = true; return; }
+
+    struct stat st;
+    unsigned char* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == TB_HEADER_SIZE + table->size) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED || memcmp(data, TB_MAGIC, 4) != 0 || data[4] != TB_VERSION || data[5] != table->num_pieces) {
+        fprintf(stderr, "Tablebase file %s is damaged or from another version\n", path);
+        if (data != MAP_FAILED) munmap(data, (size_t)st.st_size);
+        table->missing = true;
+        return;
+    }
+    table->data = data + TB_HEADER_SIZE;
+    table->map_size = (size_t)st.st_size;
+}
+
+static TBTable* find_table_locked(const char* name) {
+    for (int i = 0; i < num_tables; ++i) {
+        if (strcmp(tables[i].name, name) == 0) return tables[i].missing ? NULL : &tables[i];
+    }
+    if (num_tables == TB_MAX_TABLES) return NULL;
+    TBTable* table = &tables[num_tables];
+    if (!tb_parse_signature(name, table)) return NULL;
+    ++num_tables;
+    map_table(table);
+    return table->missing ? NULL : table;
+}
+
+static TBTable* find_table(const char* name) {
+    pthread_mutex_lock(&tables_lock);
+    TBTable* table = find_table_locked(name);
+    pthread_mutex_unlock(&tables_lock);
+    return table;
+}
+
+bool tb_write_table(const char* name, const unsigned char* data, size_t size) {
+    char path[TB_MAX_PATH + TB_MAX_NAME + 8];
+    table_path(name, path, sizeof(path));
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not write tablebase file %s\n", path);
+        return false;
+    }
+    TBTable table;
+    tb_parse_signature(name, &table);
+    unsigned char header[TB_HEADER_SIZE] = {TB_MAGIC[0], TB_MAGIC[1], TB_MAGIC[2], TB_MAGIC[3], TB_VERSION, (unsigned char)table.num_pieces, 0, 0};
+    bool ok = fwrite(header, 1, TB_HEADER_SIZE, file) == TB_HEADER_SIZE && fwrite(data, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "Could not write tablebase file %s\n", path);
+        return false;
+    }
+    // Forget an earlier failed lookup so the new table is picked up
+    pthread_mutex_lock(&tables_lock);
+    for (int i = 0; i < num_tables; ++i) {
+        if (strcmp(tables[i].name, name) == 0 && tables[i].missing) {
+            tables[i] = tables[--num_tables];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tables_lock);
+    return true;
+}
+
+// --- Probing ---
+
+int tb_probe_position(const TBPosition* pos) {
+    int others = 0, minors = 0;
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->type[i] == KING) continue;
+        ++others;
+        if (pos->type[i] == BISHOP || pos->type[i] == KNIGHT) ++minors;
+    }
+    if (others == 0 || (others == 1 && minors == 1)) return TB_DRAW;
+
+    char name[TB_MAX_NAME];
+    bool flipped;
+    tb_signature_of(pos, name, &flipped);
+    TBTable* table = find_table(name);
+    if (table == NULL) return -1;
+
+    TBPosition canonical = *pos;
+    if (flipped) tb_flip_position(&canonical);
+    int value = table->data[tb_index_of(table, &canonical)];
+    return (value == TB_INVALID) ? -1 : value;
+}
+
+bool tb_probe(const Position* position, TBResult* result) {
+    if (!tb_enabled || position->castling_rights != 0 || position->en_passant_r != -1) return false;
+
+    const Piece (*board)[8] = position->board;
+    TBPosition pos;
+    pos.num_pieces = 0;
+    pos.side_to_move = position->turn;
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            if (board[r][c].type == EMPTY) continue;
+            if (pos.num_pieces == TB_MAX_PIECES) return false;
+            pos.sq[pos.num_pieces] = r * 8 + c;
+            pos.type[pos.num_pieces] = board[r][c].type;
+            pos.color[pos.num_pieces] = board[r][c].color;
+            pos.num_pieces++;
+        }
+    }
+
+    int value = tb_probe_position(&pos);
+    if (value < 0) return false;
+    if (value == TB_DRAW) {
+        result->wdl = 0;
+        result->dtm = 0;
+    } else {
+        result->dtm = value - 1;
+        result->wdl = (result->dtm % 2 == 1) ? 1 : -1;
+    }
+    return true;
+}
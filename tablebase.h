@@ -0,0 +1,88 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "board.h"
+
+// --- Endgame Tablebases ---
+// Perfect-play tables for endings with up to TB_MAX_PIECES pieces (kings included), one
+// file per material signature ("KQvKR.tbl") in a local directory, built by the 'tbgen'
+// tool and memory-mapped on first use. Each position is one byte: 0 for a draw, or
+// distance to mate in plies + 1, where an odd distance means the side to move mates and an
+// even one that it gets mated. Tables assume no castling rights and no en passant square
+// and ignore the fifty-move rule.
+
+#define TB_MAX_PIECES 4
+#define TB_FILE_EXTENSION ".tbl"
+#define TB_MAX_NAME 16     // "KQRvKR" plus terminator, with room to spare
+#define TB_MAX_CHILDREN 128 // Legal moves from one tablebase position
+
+#define TB_DRAW 0
+#define TB_INVALID 255 // Illegal placement (overlapping pieces, side not to move in check...)
+#define TB_MAX_DISTANCE 252
+
+typedef struct {
+    int wdl; // 1 = side to move wins, 0 = draw, -1 = side to move loses
+    int dtm; // Plies to mate with best play (0 when drawn, or when already checkmated)
+} TBResult;
+
+// Uses the tables in directory (nothing is read until a probe needs a table). tb_probe
+// may be called from several threads at once; tb_init and tb_free may not overlap probes.
+void tb_init(const char* directory);
+void tb_free(void);
+bool tb_is_enabled(void);
+
+// Probes position for its side to move. Returns false if it has more than TB_MAX_PIECES
+// pieces, castling rights or an en passant square, or no table exists.
+bool tb_probe(const Position* position, TBResult* result);
+
+// --- Generator interface (used by tbgen.c) ---
+// Positions as piece lists; squares are r * 8 + c with row 0 = rank 8, as on game_board.
+typedef struct {
+    int num_pieces;
+    int sq[TB_MAX_PIECES];
+    PieceType type[TB_MAX_PIECES];
+    PieceColor color[TB_MAX_PIECES];
+    PieceColor side_to_move;
+} TBPosition;
+
+// A table is indexed with the stronger side as White. Slot order: white king, black king,
+// white pieces, then black pieces, each in signature order (Q, R, B, N, P).
+typedef struct {
+    char name[TB_MAX_NAME];
+    int num_pieces;
+    PieceType type[TB_MAX_PIECES];
+    PieceColor color[TB_MAX_PIECES];
+    bool has_pawns;
+    size_t size; // Number of positions (bytes of table data)
+    const unsigned char* data; // NULL until mapped
+    size_t map_size;
+    bool missing; // File was looked for and not found
+} TBTable;
+
+bool tb_parse_signature(const char* name, TBTable* table);
+// Canonical table name for the material of pos; *flipped is set when pos has to be
+// colour-flipped to match the table's orientation.
+void tb_signature_of(const TBPosition* pos, char* name, bool* flipped);
+// Mirrors the board vertically and swaps the colours (including the side to move).
+void tb_flip_position(TBPosition* pos);
+// Index of pos, which must have the table's material in the table's orientation.
+size_t tb_index_of(const TBTable* table, const TBPosition* pos);
+// Inverse of tb_index_of; false if the placement is illegal.
+bool tb_decode(const TBTable* table, size_t index, TBPosition* pos);
+bool tb_square_attacked(const TBPosition* pos, int sq, PieceColor attacker);
+bool tb_in_check(const TBPosition* pos, PieceColor color);
+// Legal moves for the side to move; conversion[i] is true for captures and promotions,
+// which change the material and lead into another table.
+int tb_generate_moves(const TBPosition* pos, TBPosition children[], bool conversion[]);
+// Legal positions reached by taking back a non-capturing, non-promoting move of the side
+// that just moved (the opponent of pos->side_to_move).
+int tb_generate_unmoves(const TBPosition* pos, TBPosition parents[]);
+// Encoded table value of pos from its side to move: TB_DRAW, distance + 1, or -1 if its
+// table is not available. Bare kings and king + minor vs king are draws without a table.
+int tb_probe_position(const TBPosition* pos);
+// Writes a generated table to the tablebase directory and makes it available for probing.
+bool tb_write_table(const char* name, const unsigned char* data, size_t size);
+
+#endif // TABLEBASE_H
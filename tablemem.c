@@ -0,0 +1,244 @@
+#define _DEFAULT_SOURCE // For MAP_ANONYMOUS, madvise() and MADV_HUGEPAGE
+#include "tablemem.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define MB (1024.0 * 1024.0)
+#define MAX_CLEAR_THREADS 64
+
+typedef struct TableRecord {
+    void* table;
+    size_t size; // Mapped bytes: the request rounded up to pages, or to huge pages for large tables
+    char name[TABLEMEM_MAX_NAME];
+    struct TableRecord* next;
+} TableRecord;
+
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+static TableRecord* tables; // Most recent first
+static size_t reserved_total;
+static size_t budget_bytes; // 0: no cap
+
+void tablemem_set_budget_mb(size_t budget_mb) {
+    pthread_mutex_lock(&tables_lock);
+    budget_bytes = budget_mb * 1024 * 1024;
+    pthread_mutex_unlock(&tables_lock);
+}
+
+size_t tablemem_budget_mb(void) {
+    pthread_mutex_lock(&tables_lock);
+    size_t budget_mb = budget_bytes / (1024 * 1024);
+    pthread_mutex_unlock(&tables_lock);
+    return budget_mb;
+}
+
+static size_t round_up(size_t n, size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+// Maps size bytes (a multiple of alignment) at an address aligned to alignment. mmap only
+// guarantees page alignment, so a larger alignment maps one extra alignment unit and
+// unmaps the unaligned head and the tail.
+static void* map_aligned(size_t size, size_t alignment) {
+    size_t slack = alignment > (size_t)sysconf(_SC_PAGESIZE) ? alignment : 0;
+    uint8_t* raw = mmap(NULL, size + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    if (slack == 0) return raw;
+    uint8_t* table = (uint8_t*)round_up((uintptr_t)raw, alignment);
+    size_t head = (size_t)(table - raw);
+    if (head > 0) munmap(raw, head);
+    if (slack > head) munmap(table + size, slack - head);
+    return table;
+}
+
+void* tablemem_alloc(const char* name, size_t bytes) {
+    bool huge = bytes >= TABLEMEM_HUGE_PAGE_SIZE;
+    size_t alignment = huge ? TABLEMEM_HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = round_up(bytes > 0 ? bytes : 1, alignment);
+    TableRecord* record = malloc(sizeof(TableRecord));
+    if (record == NULL) {
+        printf("Could not allocate the %s (%.1f MB)\n", name, size / MB);
+        return NULL;
+    }
+
+    // Counted before mapping, so concurrent allocations cannot both squeeze under the budget
+    pthread_mutex_lock(&tables_lock);
+    size_t budget = budget_bytes;
+    bool fits = budget == 0 || reserved_total + size <= budget;
+    if (fits) reserved_total += size;
+    pthread_mutex_unlock(&tables_lock);
+    if (!fits) {
+        printf("Could not allocate the %s (%.1f MB): over the %zu MB table memory budget\n",
+               name, size / MB, budget / (1024 * 1024));
+        free(record);
+        return NULL;
+    }
+
+    void* table = map_aligned(size, alignment);
+    if (table == NULL) {
+        printf("Could not allocate the %s (%.1f MB)\n", name, size / MB);
+        pthread_mutex_lock(&tables_lock);
+        reserved_total -= size;
+        pthread_mutex_unlock(&tables_lock);
+        free(record);
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(table, size, MADV_HUGEPAGE); // Advice only: without THP the table just uses small pages
+#endif
+
+    record->table = table;
+    record->size = size;
+    snprintf(record->name, sizeof(record->name), "%s", name);
+    pthread_mutex_lock(&tables_lock);
+    record->next = tables;
+    tables = record;
+    pthread_mutex_unlock(&tables_lock);
+    return table;
+}
+
+void tablemem_free(void* table) {
+    if (table == NULL) return;
+    pthread_mutex_lock(&tables_lock);
+    TableRecord* record = NULL;
+    for (TableRecord** link = &tables; *link != NULL; link = &(*link)->next) {
+        if ((*link)->table == table) {
+            record = *link;
+            *link = record->next;
+            reserved_total -= record->size;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tables_lock);
+    if (record == NULL) return;
+    munmap(record->table, record->size);
+    free(record);
+}
+
+// --- Clearing ---
+
+typedef struct {
+    uint8_t* start;
+    size_t bytes;
+} ClearSlice;
+
+static void* clear_slice(void* arg) {
+    ClearSlice* slice = arg;
+    memset(slice->start, 0, slice->bytes);
+    return NULL;
+}
+
+void tablemem_clear(void* table) {
+    size_t size = 0;
+    pthread_mutex_lock(&tables_lock);
+    for (TableRecord* record = tables; record != NULL; record = record->next) {
+        if (record->table == table) size = record->size;
+    }
+    pthread_mutex_unlock(&tables_lock);
+    if (size == 0) return;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = size / TABLEMEM_CLEAR_SLICE;
+    if (cpus > 0 && threads > (size_t)cpus) threads = (size_t)cpus;
+    if (threads > MAX_CLEAR_THREADS) threads = MAX_CLEAR_THREADS;
+    if (threads <= 1) {
+        memset(table, 0, size);
+        return;
+    }
+
+    // Whole huge pages per slice, so no page is written (and faulted in) by two threads
+    size_t per_thread = round_up((size + threads - 1) / threads, TABLEMEM_HUGE_PAGE_SIZE);
+    ClearSlice slices[MAX_CLEAR_THREADS];
+    pthread_t ids[MAX_CLEAR_THREADS];
+    bool started[MAX_CLEAR_THREADS] = {false};
+    size_t count = 0;
+    for (size_t offset = 0; offset < size; offset += per_thread) {
+        slices[count].start = (uint8_t*)table + offset;
+        slices[count].bytes = size - offset < per_thread ? size - offset : per_thread;
+        count++;
+    }
+    for (size_t i = 1; i < count; ++i) started[i] = pthread_create(&ids[i], NULL, clear_slice, &slices[i]) == 0;
+    clear_slice(&slices[0]);
+    for (size_t i = 1; i < count; ++i) {
+        if (started[i]) pthread_join(ids[i], NULL);
+        else clear_slice(&slices[i]); // No thread to spare: clear it here
+    }
+}
+
+// --- Usage ---
+
+// Adds the usage of record (and the tables after it when all is true). Called with tables_lock held.
+static void measure(const TableRecord* record, bool all, TableMemUsage* usage) {
+    const TableRecord* end = all ? NULL : record->next;
+    size_t reserved = 0;
+    for (const TableRecord* r = record; r != end; r = r->next) {
+        usage->tables++;
+        reserved += r->size;
+    }
+    usage->reserved_bytes += reserved;
+
+#ifdef __linux__
+    // Each mapping in smaps is a header line "start-end perms ..." followed by "Key: value kB"
+    // lines. A table usually is one mapping, but the kernel may merge neighbouring mappings,
+    // so a mapping's pages are credited in proportion to how much of it the tables cover.
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (smaps != NULL) {
+        char line[256];
+        double covered = 0.0; // Fraction of the current mapping inside the tables
+        while (fgets(line, sizeof(line), smaps)) {
+            unsigned long long start, stop;
+            size_t kb;
+            if (sscanf(line, "%llx-%llx ", &start, &stop) == 2) {
+                size_t overlap = 0;
+                for (const TableRecord* r = record; r != end; r = r->next) {
+                    uintptr_t lo = (uintptr_t)r->table, hi = lo + r->size;
+                    if (lo < start) lo = (uintptr_t)start;
+                    if (hi > stop) hi = (uintptr_t)stop;
+                    if (hi > lo) overlap += hi - lo;
+                }
+                covered = stop > start ? (double)overlap / (double)(stop - start) : 0.0;
+            } else if (covered > 0.0 && sscanf(line, "Rss: %zu kB", &kb) == 1) {
+                usage->resident_bytes += (size_t)(covered * (double)kb * 1024.0);
+            } else if (covered > 0.0 && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+                usage->huge_page_bytes += (size_t)(covered * (double)kb * 1024.0);
+            }
+        }
+        fclose(smaps);
+        return;
+    }
+#endif
+    usage->resident_bytes += reserved;
+}
+
+void tablemem_usage(TableMemUsage* usage) {
+    memset(usage, 0, sizeof(*usage));
+    pthread_mutex_lock(&tables_lock);
+    if (tables != NULL) measure(tables, true, usage);
+    pthread_mutex_unlock(&tables_lock);
+}
+
+void tablemem_report(FILE* out) {
+    TableMemUsage total = {0};
+    pthread_mutex_lock(&tables_lock);
+    for (const TableRecord* record = tables; record != NULL; record = record->next) {
+        TableMemUsage usage = {0};
+        measure(record, false, &usage);
+        fprintf(out, "%s: %.1f MB, %.1f MB resident, %.1f MB huge pages\n", record->name,
+                usage.reserved_bytes / MB, usage.resident_bytes / MB, usage.huge_page_bytes / MB);
+    }
+    if (tables != NULL) measure(tables, true, &total);
+    size_t budget = budget_bytes;
+    pthread_mutex_unlock(&tables_lock);
+    fprintf(out, "Table memory: %d table(s), %.1f MB, %.1f MB resident, %.1f MB huge pages",
+            total.tables, total.reserved_bytes / MB, total.resident_bytes / MB, total.huge_page_bytes / MB);
+    if (budget > 0) fprintf(out, " (budget %zu MB)\n", budget / (1024 * 1024));
+    else fprintf(out, "\n");
+}
@@ -0,0 +1,47 @@
+#ifndef TABLEMEM_H
+#define TABLEMEM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// --- Engine Table Memory ---
+// The large engine tables (today the transposition tables) are allocated here instead
+// of with malloc. That gives one place to enforce a total memory budget, to report usage,
+// and to clear tables quickly. Each table gets its own anonymous mapping, so it starts
+// page aligned (and therefore cache-line aligned). A table of a huge page or more is
+// aligned to 2 MB and advised with MADV_HUGEPAGE. Transparent huge pages then back it with
+// 2 MB pages instead of 4 KB ones: a probe of a multi-GB table would otherwise miss the
+// TLB nearly every time. All functions are thread-safe.
+
+#define TABLEMEM_CACHE_LINE 64
+#define TABLEMEM_HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define TABLEMEM_CLEAR_SLICE ((size_t)16 << 20) // Tables up to this size are cleared by the calling thread
+#define TABLEMEM_MAX_NAME 32
+
+// Caps the total size of the tables allocated afterwards; 0 (the default) means no cap.
+void tablemem_set_budget_mb(size_t budget_mb);
+size_t tablemem_budget_mb(void);
+
+// A zeroed table of at least `bytes` bytes. Returns NULL, with a message naming the
+// table, when it would exceed the budget or the memory is not available.
+void* tablemem_alloc(const char* name, size_t bytes);
+void tablemem_free(void* table); // NULL is ignored
+
+// Zeroes a table returned by tablemem_alloc. A large table is split into slices cleared by
+// one thread per CPU, so starting a new game does not wait on a single memset of gigabytes.
+void tablemem_clear(void* table);
+
+typedef struct {
+    int tables;
+    size_t reserved_bytes;  // Mapped for the tables
+    size_t resident_bytes;  // Of those, in RAM (pages touched so far)
+    size_t huge_page_bytes; // Of those, backed by huge pages
+} TableMemUsage;
+
+// Actual usage, read from /proc/self/smaps on Linux. Elsewhere every reserved byte is
+// counted as resident and none as huge pages.
+void tablemem_usage(TableMemUsage* usage);
+// One line per table and a total, e.g. "transposition table: 64.0 MB, 64.0 MB resident, 64.0 MB huge pages".
+void tablemem_report(FILE* out);
+
+#endif // TABLEMEM_H
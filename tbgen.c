@@ -0,0 +1,290 @@
+// Endgame tablebase generator.
+// Builds the distance-to-mate tables read by tablebase.c by retrograde analysis: every
+// position is first scored from its captures and promotions (looked up in the smaller
+// tables, which are generated first) and mates/stalemates; then, one distance at a time,
+// positions are resolved backwards through un-moves, a position being won as soon as one
+// move reaches a lost position and lost once every move reaches a won one.
+#define _POSIX_C_SOURCE 200809L // For mkdir()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tablebase.h"
+
+#define DEFAULT_TB_DIRECTORY "tablebases"
+#define DEFAULT_TB_PIECES 3
+
+#define GEN_UNKNOWN 254    // Value not resolved yet (becomes a draw if it never is)
+#define GEN_NEVER_LOST 255 // remaining[] marker: some move reaches a draw
+
+static const char* tb_dir = DEFAULT_TB_DIRECTORY;
+
+static bool table_file_exists(const char* name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s%s", tb_dir, name, TB_FILE_EXTENSION);
+    return access(path, R_OK) == 0;
+}
+
+// A position with the table's material in slot order; squares don't matter for naming.
+static TBPosition material_of(const TBTable* table) {
+    TBPosition pos = {0};
+    pos.num_pieces = table->num_pieces;
+    for (int i = 0; i < table->num_pieces; ++i) {
+        pos.type[i] = table->type[i];
+        pos.color[i] = table->color[i];
+        pos.sq[i] = i;
+    }
+    pos.side_to_move = WHITE;
+    return pos;
+}
+
+static bool needs_table(const TBPosition* pos) {
+    int others = 0, minors = 0;
+    for (int i = 0; i < pos->num_pieces; ++i) {
+        if (pos->type[i] == KING) continue;
+        ++others;
+        if (pos->type[i] == BISHOP || pos->type[i] == KNIGHT) ++minors;
+    }
+    return !(others == 0 || (others == 1 && minors == 1));
+}
+
+static bool generate_table(const char* name);
+
+// Tables reached by a capture (one piece fewer) or a promotion (pawn replaced).
+static bool generate_dependencies(const TBTable* table) {
+    static const PieceType promotions[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+    TBPosition base = material_of(table);
+    for (int i = 2; i < base.num_pieces; ++i) {
+        for (int variant = 0; variant < 5; ++variant) {
+            TBPosition sub = base;
+            if (variant == 0) {
+                sub.num_pieces--;
+                sub.type[i] = sub.type[sub.num_pieces];
+                sub.color[i] = sub.color[sub.num_pieces];
+            } else if (base.type[i] == PAWN) {
+                sub.type[i] = promotions[variant - 1];
+            } else {
+                break;
+            }
+            if (!needs_table(&sub)) continue;
+            char sub_name[TB_MAX_NAME];
+            bool flipped;
+            tb_signature_of(&sub, sub_name, &flipped);
+            if (!table_file_exists(sub_name) && !generate_table(sub_name)) return false;
+        }
+    }
+    return true;
+}
+
+static int add_distinct(size_t* list, int count, size_t index) {
+    for (int i = 0; i < count; ++i) if (list[i] == index) return count;
+    list[count] = index;
+    return count + 1;
+}
+
+static bool generate_table(const char* name) {
+    TBTable table;
+    if (!tb_parse_signature(name, &table)) {
+        printf("Invalid material signature %s\n", name);
+        return false;
+    }
+    if (!generate_dependencies(&table)) return false;
+
+    unsigned char* value = malloc(table.size);
+    unsigned char* remaining = malloc(table.size);
+    unsigned char* max_child = calloc(table.size, 1);
+    if (value == NULL || remaining == NULL || max_child == NULL) {
+        printf("Out of memory for %s (%zu positions)\n", name, table.size);
+        free(value); free(remaining); free(max_child);
+        return false;
+    }
+    printf("Generating %s (%zu positions)...\n", name, table.size);
+    fflush(stdout);
+
+    static TBPosition children[TB_MAX_CHILDREN];
+    static bool conversion[TB_MAX_CHILDREN];
+    size_t child_index[TB_MAX_CHILDREN];
+    int max_pending = 0;
+
+    // Pass 1: terminal positions and everything that depends only on other tables
+    for (size_t idx = 0; idx < table.size; ++idx) {
+        TBPosition pos;
+        if (!tb_decode(&table, idx, &pos)) { value[idx] = TB_INVALID; continue; }
+
+        int num_children = tb_generate_moves(&pos, children, conversion);
+        if (num_children == 0) {
+            value[idx] = tb_in_check(&pos, pos.side_to_move) ? 1 : TB_DRAW; // Mated in 0, or stalemate
+            continue;
+        }
+
+        int distinct = 0, best_win = -1, longest_loss = 0;
+        bool never_lost = false;
+        for (int i = 0; i < num_children; ++i) {
+            if (!conversion[i]) {
+                distinct = add_distinct(child_index, distinct, tb_index_of(&table, &children[i]));
+                continue;
+            }
+            int child_value = tb_probe_position(&children[i]);
+            if (child_value < 0) {
+                printf("Missing table for a conversion from %s\n", name);
+                free(value); free(remaining); free(max_child);
+                return false;
+            }
+            int d = child_value - 1;
+            if (child_value == TB_DRAW) never_lost = true;
+            else if (d % 2 == 0) { if (best_win < 0 || d + 1 < best_win) best_win = d + 1; } // Opponent gets mated
+            else if (d > longest_loss) longest_loss = d;
+        }
+
+        if (best_win >= 0) {
+            value[idx] = (unsigned char)(best_win + 1);
+            if (best_win > max_pending) max_pending = best_win;
+        } else if (!never_lost && distinct == 0) {
+            value[idx] = (unsigned char)(longest_loss + 2); // Every move converts into a lost ending
+            if (longest_loss + 1 > max_pending) max_pending = longest_loss + 1;
+        } else {
+            value[idx] = GEN_UNKNOWN;
+            remaining[idx] = never_lost ? GEN_NEVER_LOST : (unsigned char)distinct;
+            max_child[idx] = (unsigned char)longest_loss;
+        }
+    }
+
+    // Pass 2: resolve backwards one distance at a time. Positions holding distance d are
+    // final once all smaller distances have been processed.
+    static TBPosition parents[TB_MAX_CHILDREN];
+    size_t parent_index[TB_MAX_CHILDREN];
+    for (int d = 0; d <= max_pending; ++d) {
+        if (d > TB_MAX_DISTANCE - 1) {
+            printf("%s has mates longer than %d plies, which the table format cannot store\n", name, TB_MAX_DISTANCE);
+            free(value); free(remaining); free(max_child);
+            return false;
+        }
+        for (size_t idx = 0; idx < table.size; ++idx) {
+            if (value[idx] != d + 1) continue;
+            TBPosition pos;
+            tb_decode(&table, idx, &pos);
+            int num_parents = tb_generate_unmoves(&pos, parents);
+            int distinct = 0;
+            for (int i = 0; i < num_parents; ++i) {
+                distinct = add_distinct(parent_index, distinct, tb_index_of(&table, &parents[i]));
+            }
+
+            for (int i = 0; i < distinct; ++i) {
+                size_t p = parent_index[i];
+                int parent_value = value[p];
+                if (parent_value == TB_INVALID || parent_value == TB_DRAW) continue;
+                if (d % 2 == 0) {
+                    // A move into this lost position wins, unless the parent already wins faster
+                    bool pending_longer_win = parent_value != GEN_UNKNOWN && (parent_value - 1) % 2 == 1 && parent_value - 1 > d + 1;
+                    if (parent_value == GEN_UNKNOWN || pending_longer_win) {
+                        value[p] = (unsigned char)(d + 2);
+                        if (d + 1 > max_pending) max_pending = d + 1;
+                    }
+                } else if (parent_value == GEN_UNKNOWN && remaining[p] != GEN_NEVER_LOST) {
+                    if (d > max_child[p]) max_child[p] = (unsigned char)d;
+                    if (--remaining[p] == 0) {
+                        value[p] = (unsigned char)(max_child[p] + 2);
+                        if (max_child[p] + 1 > max_pending) max_pending = max_child[p] + 1;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t wins = 0, losses = 0, draws = 0;
+    int longest = 0;
+    for (size_t idx = 0; idx < table.size; ++idx) {
+        if (value[idx] == GEN_UNKNOWN) value[idx] = TB_DRAW;
+        if (value[idx] == TB_INVALID) continue;
+        if (value[idx] == TB_DRAW) { ++draws; continue; }
+        int d = value[idx] - 1;
+        if (d % 2 == 1) ++wins; else ++losses;
+        if (d > longest) longest = d;
+    }
+    printf("  %zu wins, %zu draws, %zu losses for the side to move; longest mate %d plies\n", wins, draws, losses, longest);
+
+    bool ok = tb_write_table(name, value, table.size);
+    free(value); free(remaining); free(max_child);
+    return ok;
+}
+
+static bool generate_if_missing(const char* name) {
+    return table_file_exists(name) || generate_table(name);
+}
+
+// All material combinations with exactly num_pieces pieces that need a table.
+static bool generate_all(int num_pieces) {
+    static const char letters[] = "QRBNP";
+    int extra = num_pieces - 2;
+    if (extra == 1) {
+        for (int a = 0; a < 5; ++a) {
+            char name[TB_MAX_NAME];
+            snprintf(name, sizeof(name), "K%cvK", letters[a]);
+            TBTable table;
+            tb_parse_signature(name, &table);
+            TBPosition pos = material_of(&table);
+            if (needs_table(&pos) && !generate_if_missing(name)) return false;
+        }
+    } else if (extra == 2) {
+        for (int a = 0; a < 5; ++a) {
+            for (int b = a; b < 5; ++b) {
+                char together[TB_MAX_NAME], apart[TB_MAX_NAME];
+                snprintf(together, sizeof(together), "K%c%cvK", letters[a], letters[b]);
+                snprintf(apart, sizeof(apart), "K%cvK%c", letters[a], letters[b]);
+                if (!generate_if_missing(together) || !generate_if_missing(apart)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [-d directory] [-n pieces] [signature ...]\n", program_name);
+    printf("  -d directory   Where the tables are written (default %s)\n", DEFAULT_TB_DIRECTORY);
+    printf("  -n pieces      Generate every table with up to this many pieces, 3 or %d (default %d)\n", TB_MAX_PIECES, DEFAULT_TB_PIECES);
+    printf("  signature      Tables to generate, e.g. KQvKR (missing smaller tables are built too)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int max_pieces = 0;
+    int first_signature = argc;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            tb_dir = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            max_pieces = atoi(argv[++i]);
+            if (max_pieces < 3 || max_pieces > TB_MAX_PIECES) { print_usage(argv[0]); return 1; }
+        } else if (argv[i][0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            first_signature = i;
+            break;
+        }
+    }
+    if (max_pieces == 0 && first_signature == argc) max_pieces = DEFAULT_TB_PIECES;
+
+    mkdir(tb_dir, 0755); // Already existing is fine; writing reports real errors
+    tb_init(tb_dir);
+
+    for (int n = 3; n <= max_pieces; ++n) {
+        if (!generate_all(n)) return 1;
+    }
+    for (int i = first_signature; i < argc; ++i) {
+        TBTable table;
+        if (!tb_parse_signature(argv[i], &table) || table.num_pieces > TB_MAX_PIECES) {
+            printf("Invalid material signature %s (at most %d pieces, e.g. KQvKR)\n", argv[i], TB_MAX_PIECES);
+            return 1;
+        }
+        // Accept either colour order ("KRvKQ") and store under the canonical name
+        TBPosition pos = material_of(&table);
+        char name[TB_MAX_NAME];
+        bool flipped;
+        tb_signature_of(&pos, name, &flipped);
+        if (!needs_table(&pos)) { printf("%s is a draw and needs no table\n", name); continue; }
+        if (!generate_table(name)) return 1;
+    }
+    tb_free();
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "timeman.h"
+
+#define TM_DEFAULT_MOVES_TO_GO 30  // Moves the clock is spread over in sudden death
+#define TM_MAX_MOVES_TO_GO 50
+#define TM_MAX_RATIO 5             // Maximum time is at most this many optimum times...
+#define TM_MAX_CLOCK_FRACTION 0.8  // ...and at most this share of the remaining clock
+#define TM_MIN_TIME_MS 10
+#define TM_SCORE_DROP 30           // Centipawns lost since the last iteration that count as a drop
+#define TM_SCORE_DROP_SCALE 1.5
+#define TM_DOMINANT_MARGIN 150     // Best move this far ahead of the rest...
+#define TM_DOMINANT_STABLE 2       // ...for this many iterations in a row...
+#define TM_DOMINANT_SCALE 0.25     // ...only uses this share of the optimum time
+#define TM_START_FRACTION 0.5       // No new iteration once this share of the target time is used
+#define TM_NEXT_ITERATION_FACTOR 3 // Next iteration takes at least this many times the last one
+#define TM_MAX_GROWTH 20           // Cap on the measured growth between iterations
+
+void tm_start(TimeManager* tm, const TimeControl* clock) {
+    int moves_to_go = clock->moves_to_go > 0 ? clock->moves_to_go : TM_DEFAULT_MOVES_TO_GO;
+    if (moves_to_go > TM_MAX_MOVES_TO_GO) moves_to_go = TM_MAX_MOVES_TO_GO;
+
+    int time_left = clock->time_left_ms - clock->move_overhead_ms;
+    if (time_left < TM_MIN_TIME_MS) time_left = TM_MIN_TIME_MS;
+
+    // Share the clock plus the increments still to come evenly over the remaining moves
+    long available = (long)time_left + (long)clock->increment_ms * (moves_to_go - 1) - (long)clock->move_overhead_ms * (moves_to_go - 1);
+    if (available < time_left / 2) available = time_left / 2;
+    int optimum = (int)(available / moves_to_go);
+
+    int maximum = optimum * TM_MAX_RATIO;
+    int clock_cap = (moves_to_go == 1) ? time_left : (int)(time_left * TM_MAX_CLOCK_FRACTION);
+    if (maximum > clock_cap) maximum = clock_cap;
+    if (optimum > maximum) optimum = maximum;
+    if (optimum < TM_MIN_TIME_MS) optimum = TM_MIN_TIME_MS;
+    if (maximum < optimum) maximum = optimum;
+
+    tm->optimum_ms = optimum;
+    tm->maximum_ms = maximum;
+    tm->instability = 0.0;
+    tm->stable_iterations = 0;
+    tm->previous_score = 0;
+    tm->has_previous_score = false;
+    tm->last_iteration_ms = 0;
+}
+
+bool tm_iteration_done(TimeManager* tm, unsigned int elapsed_ms, unsigned int iteration_ms,
+                       bool best_move_changed, int score, int best_margin) {
+    tm->instability = tm->instability * 0.5 + (best_move_changed ? 1.0 : 0.0);
+    tm->stable_iterations = best_move_changed ? 0 : tm->stable_iterations + 1;
+
+    double target = tm->optimum_ms * (1.0 + tm->instability); // instability tends to 2: up to 3x the optimum while unsettled
+    if (tm->has_previous_score && score < tm->previous_score - TM_SCORE_DROP) target *= TM_SCORE_DROP_SCALE;
+    if (best_margin >= TM_DOMINANT_MARGIN && tm->stable_iterations >= TM_DOMINANT_STABLE) target *= TM_DOMINANT_SCALE;
+    if (target > tm->maximum_ms) target = tm->maximum_ms;
+    tm->previous_score = score;
+    tm->has_previous_score = true;
+
+    // The next iteration usually takes longer than everything so far, so starting it late
+    // overshoots the target; one that cannot finish before the hard limit is thrown away
+    double growth = TM_NEXT_ITERATION_FACTOR;
+    if (tm->last_iteration_ms > 0 && (double)iteration_ms / tm->last_iteration_ms > growth) {
+        growth = (double)iteration_ms / tm->last_iteration_ms;
+        if (growth > TM_MAX_GROWTH) growth = TM_MAX_GROWTH;
+    }
+    tm->last_iteration_ms = iteration_ms;
+    if (elapsed_ms >= target * TM_START_FRACTION) return true;
+    return elapsed_ms + iteration_ms * growth > tm->maximum_ms;
+}
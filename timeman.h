@@ -0,0 +1,36 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdbool.h>
+
+// --- Time Management ---
+// Turns a game clock into a time budget for one move. The search aims for the optimum
+// time, which grows while the best root move keeps changing or the score is falling and
+// shrinks when one move clearly dominates; the maximum time is a hard limit enforced
+// inside the search.
+
+typedef struct {
+    int time_left_ms;     // Remaining clock of the side to move; 0 disables the time manager
+    int increment_ms;     // Added to the clock after every move
+    int moves_to_go;      // Moves until the next time control; 0 for sudden death
+    int move_overhead_ms; // Reserve for GUI / communication lag per move
+} TimeControl;
+
+typedef struct {
+    int optimum_ms;
+    int maximum_ms;
+    double instability;    // Decaying count of best-move changes between iterations
+    int stable_iterations; // Iterations in a row with the same best move
+    int previous_score;
+    bool has_previous_score;
+    unsigned int last_iteration_ms; // To estimate how long the next iteration takes
+} TimeManager;
+
+void tm_start(TimeManager* tm, const TimeControl* clock);
+
+// Called after each completed iteration; returns true if the search should not start
+// another one. best_margin is the gap between the best and second-best root move.
+bool tm_iteration_done(TimeManager* tm, unsigned int elapsed_ms, unsigned int iteration_ms,
+                       bool best_move_changed, int score, int best_margin);
+
+#endif // TIMEMAN_H
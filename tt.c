@@ -0,0 +1,92 @@
+#include "tt.h"
+#include <pthread.h>
+#include "tablemem.h"
+
+// Keys for [color][type][square], castling rights, en passant file and Black to move.
+// Generated once from a fixed seed, so hashes are the same in every run.
+static uint64_t piece_keys[2][KING + 1][64];
+static uint64_t castling_keys[16];
+static uint64_t en_passant_keys[8];
+static uint64_t black_to_move_key;
+static pthread_once_t keys_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void init_keys(void) {
+    uint64_t state = 0x5EED5EED5EED5EEDULL;
+    for (int color = 0; color < 2; ++color) {
+        for (int type = PAWN; type <= KING; ++type) {
+            for (int sq = 0; sq < 64; ++sq) piece_keys[color][type][sq] = splitmix64(&state);
+        }
+    }
+    for (int i = 0; i < 16; ++i) castling_keys[i] = splitmix64(&state);
+    for (int i = 0; i < 8; ++i) en_passant_keys[i] = splitmix64(&state);
+    black_to_move_key = splitmix64(&state);
+}
+
+bool tt_init(TranspositionTable* tt, size_t size_mb) {
+    pthread_once(&keys_once, init_keys);
+    tt->entries = NULL;
+    tt->mask = 0;
+    tt->generation = 0;
+    if (size_mb == 0) return false;
+    size_t count = 1;
+    while (count * 2 * sizeof(TTEntry) <= size_mb * 1024 * 1024) count *= 2;
+    tt->entries = tablemem_alloc("transposition table", count * sizeof(TTEntry));
+    if (tt->entries == NULL) return false;
+    tt->mask = count - 1;
+    tt_clear(tt); // Already zero; this faults the pages in now, in parallel, instead of during the first search
+    return true;
+}
+
+void tt_free(TranspositionTable* tt) {
+    tablemem_free(tt->entries);
+    tt->entries = NULL;
+    tt->mask = 0;
+}
+
+void tt_clear(TranspositionTable* tt) {
+    if (tt->entries) tablemem_clear(tt->entries);
+}
+
+void tt_new_search(TranspositionTable* tt) {
+    tt->generation++;
+}
+
+size_t tt_size_mb(const TranspositionTable* tt) {
+    return tt->entries ? (tt->mask + 1) * sizeof(TTEntry) / (1024 * 1024) : 0;
+}
+
+uint64_t tt_key(const Position* pos) {
+    uint64_t key = 0;
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            Piece p = pos->board[r][c];
+            if (p.type != EMPTY) key ^= piece_keys[p.color == WHITE ? 0 : 1][p.type][r * 8 + c];
+        }
+    }
+    key ^= castling_keys[pos->castling_rights & 15];
+    if (pos->en_passant_c >= 0) key ^= en_passant_keys[pos->en_passant_c];
+    if (pos->turn == BLACK) key ^= black_to_move_key;
+    return key;
+}
+
+const TTEntry* tt_probe(const TranspositionTable* tt, uint64_t key) {
+    if (tt->entries == NULL) return NULL;
+    const TTEntry* entry = &tt->entries[key & tt->mask];
+    return (entry->bound != TT_NONE && entry->key == key) ? entry : NULL;
+}
+
+void tt_store(TranspositionTable* tt, const TTEntry* entry) {
+    if (tt->entries == NULL) return;
+    TTEntry* slot = &tt->entries[entry->key & tt->mask];
+    if (slot->key == entry->key && slot->bound != TT_NONE && slot->generation == tt->generation &&
+        slot->depth > entry->depth && entry->bound != TT_EXACT) return;
+    *slot = *entry;
+    slot->generation = tt->generation;
+}
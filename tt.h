@@ -0,0 +1,55 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+
+// --- Transposition Table ---
+// Search results keyed by a Zobrist hash of the position (pieces, side to move, castling
+// rights and en passant file), so a position reached again through another move order, or
+// in the next iteration, is not searched from scratch. Each engine owns its table; one
+// entry per slot, replaced unless the stored result is deeper and from the current search.
+// Entries outlive a search, so the next one (e.g. after the opponent's reply) starts with
+// what was learned; tt_new_search ages them instead of clearing gigabytes.
+
+#define TT_DEFAULT_SIZE_MB 16
+
+typedef enum { TT_NONE, TT_EXACT, TT_LOWER, TT_UPPER } TTBound;
+
+// 16 bytes. The score is for the side to move; mate and tablebase scores are stored relative
+// to this node, not the root.
+typedef struct {
+    uint64_t key;
+    int16_t score;
+    int8_t depth;
+    uint8_t bound;      // TTBound
+    int8_t from, to;    // Best move as squares r * 8 + c; -1 when there is none
+    uint8_t promotion;  // PieceType
+    uint8_t generation; // Search that stored it; set by tt_store
+} TTEntry;
+
+typedef struct {
+    TTEntry* entries; // NULL: the table is disabled and every probe misses
+    size_t mask;      // Number of entries - 1 (a power of two)
+    uint8_t generation;
+} TranspositionTable;
+
+// Allocates the largest power-of-two number of entries fitting in size_mb megabytes, from
+// the table memory (see tablemem.h). Returns false (leaving the table disabled) when the
+// memory is not available or over the budget.
+bool tt_init(TranspositionTable* tt, size_t size_mb);
+void tt_free(TranspositionTable* tt);
+void tt_clear(TranspositionTable* tt); // Parallel for large tables
+// Starts a new search: entries stored so far stay usable but give way to new ones.
+void tt_new_search(TranspositionTable* tt);
+size_t tt_size_mb(const TranspositionTable* tt); // 0 when disabled
+
+uint64_t tt_key(const Position* pos);
+
+// The entry for key, or NULL.
+const TTEntry* tt_probe(const TranspositionTable* tt, uint64_t key);
+void tt_store(TranspositionTable* tt, const TTEntry* entry);
+
+#endif // TT_H
@@ -0,0 +1,374 @@
+// Texel-style evaluation tuner.
+// Fits the piece values and piece-square tables of pst_params.h to a dataset of labelled
+// positions: one position per line as a FEN (or EPD) followed anywhere on the line by the
+// game result ("1-0", "0-1", "1/2-1/2", or [1.0] / [0.5] / [0.0]), from White's side.
+// Quiet positions (no pending captures or checks) from many games work best. A .pgn file
+// works too: its games are replayed in parallel, and every position from ply PGN_FIRST_PLY
+// on that is not in check and was not reached by a capture is labelled with the game's
+// result; unfinished games and games that fail to parse are skipped. The loss is
+// the mean squared difference between each result and sigmoid(K * eval), with K fitted
+// first so the hand-set values start from their best scaling; then every parameter
+// follows the gradient (Adam steps) and the result is written as a new header:
+//   ./tune -j 8 -i 1000 -o pst_params.h quiet-labeled.epd && make clean && make
+// The evaluation is linear in the parameters, so the dataset is kept as the list of pieces
+// of each position, 2 bytes each, and one pass over it gives both loss and gradient.
+// Positions are split over a fixed pool of threads; a pass allocates nothing.
+#define _POSIX_C_SOURCE 200809L // For pthread barriers and sysconf()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "board.h"
+#include "pst.h"
+#include "pgn.h"
+#include "rules.h"
+
+#define MAX_LINE_LENGTH 512
+#define NUM_VALUES 5 // Pawn to queen; the king has no value
+#define NUM_PARAMS (NUM_VALUES + 6 * 64)
+#define PST_PARAM(type, sq) (NUM_VALUES + ((type) - PAWN) * 64 + (sq))
+#define DEFAULT_ITERATIONS 500
+#define DEFAULT_LEARNING_RATE 1.0 // Centipawns per Adam step
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+#define REPORT_INTERVAL 25
+#define PGN_FIRST_PLY 8 // Opening positions say little about the evaluation
+
+// One term per piece: bit 15 set for Black, PieceType in bits 6-8, the square (from the
+// piece's own side, row 0 = rank 8) in bits 0-5.
+#define TERM_BLACK 0x8000
+#define TERM_TYPE(term) (((term) >> 6) & 7)
+#define TERM_SQUARE(term) ((term) & 63)
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    uint32_t* first_term; // [count + 1]: terms of position i are first_term[i] .. first_term[i + 1] - 1
+    uint16_t* terms;
+    size_t num_terms, terms_capacity;
+    uint8_t* results;     // Half points for White: 0, 1 or 2
+} Dataset;
+
+typedef enum { JOB_LOSS, JOB_GRADIENT, JOB_EXIT } JobType;
+
+typedef struct {
+    pthread_t thread;
+    size_t begin, end;       // Positions of this worker
+    double loss;             // Sum of squared errors over its positions
+    double gradient[NUM_PARAMS];
+} Worker;
+
+static Dataset dataset;
+static double params[NUM_PARAMS];
+static double sigmoid_k;
+static JobType job;
+static pthread_barrier_t job_start, job_done;
+
+// Half points for White from the result found on the line, or -1 if there is none.
+static int parse_result(const char* line) {
+    if (strstr(line, "1/2-1/2") || strstr(line, "[0.5]")) return 1;
+    if (strstr(line, "1-0") || strstr(line, "[1.0]") || strstr(line, "[1]")) return 2;
+    if (strstr(line, "0-1") || strstr(line, "[0.0]") || strstr(line, "[0]")) return 0;
+    return -1;
+}
+
+static bool add_position(const Position* pos, int result) {
+    if (dataset.num_terms + 32 > dataset.terms_capacity) {
+        size_t capacity = dataset.terms_capacity ? dataset.terms_capacity * 2 : 1 << 16;
+        uint16_t* terms = realloc(dataset.terms, capacity * sizeof(uint16_t));
+        if (terms == NULL) return false;
+        dataset.terms = terms;
+        dataset.terms_capacity = capacity;
+    }
+    if (dataset.count + 2 > dataset.capacity) {
+        size_t capacity = dataset.capacity ? dataset.capacity * 2 : 1 << 12;
+        uint32_t* first_term = realloc(dataset.first_term, capacity * sizeof(uint32_t));
+        if (first_term == NULL) return false;
+        dataset.first_term = first_term;
+        uint8_t* results = realloc(dataset.results, capacity);
+        if (results == NULL) return false;
+        dataset.results = results;
+        dataset.capacity = capacity;
+    }
+
+    dataset.first_term[dataset.count] = (uint32_t)dataset.num_terms;
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            Piece p = pos->board[r][c];
+            if (p.type == EMPTY) continue;
+            int square = (p.color == WHITE ? r : 7 - r) * 8 + c;
+            dataset.terms[dataset.num_terms++] = (uint16_t)((p.color == BLACK ? TERM_BLACK : 0) | (p.type << 6) | square);
+        }
+    }
+    dataset.results[dataset.count++] = (uint8_t)result;
+    dataset.first_term[dataset.count] = (uint32_t)dataset.num_terms;
+    return true;
+}
+
+static bool load_dataset(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Could not open dataset %s\n", path);
+        return false;
+    }
+    static Game game;
+    char line[MAX_LINE_LENGTH];
+    long skipped = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int result = parse_result(line);
+        if (result < 0 || !load_fen(&game, line)) { // load_fen ignores whatever follows the FEN
+            if (line[0] != '\n' && line[0] != '#') skipped++;
+            continue;
+        }
+        if (!add_position(&game.pos, result)) {
+            printf("Out of memory after %zu positions\n", dataset.count);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    if (skipped > 0) printf("Skipped %ld lines without a FEN and a result\n", skipped);
+    return true;
+}
+
+typedef struct {
+    pthread_mutex_t lock; // Over the dataset
+    long skipped;
+    bool out_of_memory;
+} PGNLoad;
+
+static void add_pgn_game(const PGNGame* game, void* user_data) {
+    PGNLoad* load = user_data;
+    int result = game->error[0] ? -1 : parse_result(game->result);
+    if (result < 0) {
+        pthread_mutex_lock(&load->lock);
+        load->skipped++;
+        pthread_mutex_unlock(&load->lock);
+        return;
+    }
+    Position pos = game->game.start;
+    for (int ply = 0; ply < game->game.move_count; ++ply) {
+        GameMove m;
+        if (!game_get_move(&game->game, ply, &m)) break; // Later positions would not follow from pos
+        Piece moved = pos.board[m.from_r][m.from_c];
+        bool capture = pos.board[m.to_r][m.to_c].type != EMPTY ||
+                       (moved.type == PAWN && m.from_c != m.to_c); // En passant lands on an empty square
+        position_execute_move(&pos, m.from_r, m.from_c, m.to_r, m.to_c, m.promotion);
+        switch_player_turn(&pos);
+        if (ply + 1 < PGN_FIRST_PLY || capture || is_king_in_check(pos.board, pos.turn)) continue;
+        pthread_mutex_lock(&load->lock);
+        if (!load->out_of_memory && !add_position(&pos, result)) load->out_of_memory = true;
+        pthread_mutex_unlock(&load->lock);
+    }
+}
+
+static bool load_pgn_dataset(const char* path, int threads) {
+    PGNLoad load = {PTHREAD_MUTEX_INITIALIZER, 0, false};
+    PGNReplayStats stats;
+    bool ok = pgn_replay_file(path, threads, add_pgn_game, &load, &stats);
+    pthread_mutex_destroy(&load.lock);
+    if (!ok) return false;
+    if (load.out_of_memory) {
+        printf("Out of memory after %zu positions\n", dataset.count);
+        return false;
+    }
+    printf("Read %ld games (%ld skipped: unfinished or unreadable)\n", stats.games, load.skipped);
+    return true;
+}
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), k = strlen(suffix);
+    return n >= k && strcmp(s + n - k, suffix) == 0;
+}
+
+static void init_params(void) {
+    static const int values[NUM_VALUES] = {PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE};
+    static const int tables[6][8][8] = {PAWN_PST, KNIGHT_PST, BISHOP_PST, ROOK_PST, QUEEN_PST, KING_PST};
+    for (int i = 0; i < NUM_VALUES; ++i) params[i] = values[i];
+    for (int t = 0; t < 6; ++t)
+        for (int sq = 0; sq < 64; ++sq) params[NUM_VALUES + t * 64 + sq] = tables[t][sq / 8][sq % 8];
+}
+
+static double evaluate(size_t i) {
+    double score = 0.0;
+    for (uint32_t t = dataset.first_term[i]; t < dataset.first_term[i + 1]; ++t) {
+        uint16_t term = dataset.terms[t];
+        int type = TERM_TYPE(term);
+        double v = params[PST_PARAM(type, TERM_SQUARE(term))] + (type != KING ? params[type - PAWN] : 0.0);
+        score += (term & TERM_BLACK) ? -v : v;
+    }
+    return score;
+}
+
+static double sigmoid(double eval) {
+    return 1.0 / (1.0 + pow(10.0, -sigmoid_k * eval / 400.0));
+}
+
+static void run_job(Worker* w) {
+    w->loss = 0.0;
+    if (job == JOB_GRADIENT) memset(w->gradient, 0, sizeof(w->gradient));
+    // d sigmoid / d eval = ln(10) * K / 400 * s * (1 - s)
+    const double slope = log(10.0) * sigmoid_k / 400.0;
+    for (size_t i = w->begin; i < w->end; ++i) {
+        double s = sigmoid(evaluate(i));
+        double error = dataset.results[i] * 0.5 - s;
+        w->loss += error * error;
+        if (job != JOB_GRADIENT) continue;
+        double g = -2.0 * error * slope * s * (1.0 - s); // d loss / d eval
+        for (uint32_t t = dataset.first_term[i]; t < dataset.first_term[i + 1]; ++t) {
+            uint16_t term = dataset.terms[t];
+            int type = TERM_TYPE(term);
+            double signed_g = (term & TERM_BLACK) ? -g : g;
+            w->gradient[PST_PARAM(type, TERM_SQUARE(term))] += signed_g;
+            if (type != KING) w->gradient[type - PAWN] += signed_g;
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    for (;;) {
+        pthread_barrier_wait(&job_start);
+        if (job == JOB_EXIT) return NULL;
+        run_job(w);
+        pthread_barrier_wait(&job_done);
+    }
+}
+
+// Runs one pass on every worker and returns the mean loss; with JOB_GRADIENT, gradient
+// receives the mean gradient. Workers are summed in order, so results are reproducible.
+static double run_pass(Worker* workers, int num_workers, JobType type, double* gradient) {
+    job = type;
+    pthread_barrier_wait(&job_start);
+    pthread_barrier_wait(&job_done);
+    double loss = 0.0;
+    if (gradient) memset(gradient, 0, NUM_PARAMS * sizeof(double));
+    for (int i = 0; i < num_workers; ++i) {
+        loss += workers[i].loss;
+        if (gradient) for (int p = 0; p < NUM_PARAMS; ++p) gradient[p] += workers[i].gradient[p];
+    }
+    if (gradient) for (int p = 0; p < NUM_PARAMS; ++p) gradient[p] /= (double)dataset.count;
+    return loss / (double)dataset.count;
+}
+
+// Golden-section search for the K that minimises the loss of the current parameters.
+static void fit_sigmoid_k(Worker* workers, int num_workers) {
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double lo = 0.1, hi = 5.0;
+    for (int i = 0; i < 40; ++i) {
+        double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+        sigmoid_k = a;
+        double loss_a = run_pass(workers, num_workers, JOB_LOSS, NULL);
+        sigmoid_k = b;
+        double loss_b = run_pass(workers, num_workers, JOB_LOSS, NULL);
+        if (loss_a < loss_b) hi = b; else lo = a;
+    }
+    sigmoid_k = (lo + hi) / 2.0;
+}
+
+static void write_table(FILE* out, const char* name, int type) {
+    fprintf(out, "#define %s { \\\n", name);
+    for (int r = 0; r < 8; ++r) {
+        fprintf(out, "    {");
+        for (int c = 0; c < 8; ++c) fprintf(out, "%s%4ld", c ? ", " : "", lround(params[PST_PARAM(type, r * 8 + c)]));
+        fprintf(out, "}%s \\\n", r < 7 ? "," : "");
+    }
+    fprintf(out, "}\n\n");
+}
+
+static bool write_header(const char* path, const char* dataset_path, double loss) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Could not write %s\n", path);
+        return false;
+    }
+    fprintf(out, "#ifndef PST_PARAMS_H\n#define PST_PARAMS_H\n\n");
+    fprintf(out, "// --- Evaluation Parameters ---\n");
+    fprintf(out, "// Piece values and piece-square tables (from White's side, row 0 = rank 8; mirrored for\n");
+    fprintf(out, "// Black). Generated by ./tune from %s (%zu positions, K %.4f, loss %.6f);\n", dataset_path, dataset.count, sigmoid_k, loss);
+    fprintf(out, "// rerun it rather than editing by hand.\n\n");
+    static const char* value_names[NUM_VALUES] = {"PAWN_VALUE  ", "KNIGHT_VALUE", "BISHOP_VALUE", "ROOK_VALUE  ", "QUEEN_VALUE "};
+    for (int i = 0; i < NUM_VALUES; ++i) fprintf(out, "#define %s %ld\n", value_names[i], lround(params[i]));
+    fprintf(out, "\n");
+    static const char* table_names[6] = {"PAWN_PST", "KNIGHT_PST", "BISHOP_PST", "ROOK_PST", "QUEEN_PST", "KING_PST"};
+    for (int t = 0; t < 6; ++t) write_table(out, table_names[t], PAWN + t);
+    fprintf(out, "#endif // PST_PARAMS_H\n");
+    return fclose(out) == 0;
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [-j threads] [-i iterations] [-r rate] [-k K] [-o header] dataset.epd|games.pgn\n", program_name);
+    printf("  -j threads  Worker threads (default: number of CPUs)\n");
+    printf("  -i n        Gradient steps (default %d)\n", DEFAULT_ITERATIONS);
+    printf("  -r rate     Adam learning rate in centipawns (default %.1f)\n", DEFAULT_LEARNING_RATE);
+    printf("  -k K        Sigmoid scaling instead of fitting it to the dataset\n");
+    printf("  -o header   Where to write the tuned parameters (default pst_params.tuned.h)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int iterations = DEFAULT_ITERATIONS;
+    double rate = DEFAULT_LEARNING_RATE;
+    const char* output_path = "pst_params.tuned.h";
+    const char* dataset_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) num_workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) sigmoid_k = atof(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output_path = argv[++i];
+        else if (argv[i][0] != '-' && dataset_path == NULL) dataset_path = argv[i];
+        else { print_usage(argv[0]); return 1; }
+    }
+    if (dataset_path == NULL || iterations < 0 || rate <= 0.0) { print_usage(argv[0]); return 1; }
+    if (num_workers < 1) num_workers = 1;
+
+    bool loaded = has_suffix(dataset_path, ".pgn") ? load_pgn_dataset(dataset_path, num_workers) : load_dataset(dataset_path);
+    if (!loaded) return 1;
+    if (dataset.count == 0) { printf("No labelled positions in %s\n", dataset_path); return 1; }
+    printf("Loaded %zu positions (%.1f MB)\n", dataset.count,
+           (dataset.num_terms * sizeof(uint16_t) + dataset.count * (sizeof(uint32_t) + 1)) / (1024.0 * 1024.0));
+    if ((size_t)num_workers > dataset.count) num_workers = (int)dataset.count;
+    init_params();
+
+    Worker* workers = calloc((size_t)num_workers, sizeof(Worker));
+    if (workers == NULL) return 1;
+    pthread_barrier_init(&job_start, NULL, (unsigned)num_workers + 1);
+    pthread_barrier_init(&job_done, NULL, (unsigned)num_workers + 1);
+    for (int i = 0; i < num_workers; ++i) {
+        workers[i].begin = dataset.count * (size_t)i / (size_t)num_workers;
+        workers[i].end = dataset.count * (size_t)(i + 1) / (size_t)num_workers;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    if (sigmoid_k <= 0.0) fit_sigmoid_k(workers, num_workers);
+    double loss = run_pass(workers, num_workers, JOB_LOSS, NULL);
+    printf("K %.4f, initial loss %.6f\n", sigmoid_k, loss);
+
+    static double gradient[NUM_PARAMS], moment1[NUM_PARAMS], moment2[NUM_PARAMS];
+    for (int step = 1; step <= iterations; ++step) {
+        loss = run_pass(workers, num_workers, JOB_GRADIENT, gradient); // Loss before this step
+        for (int p = 0; p < NUM_PARAMS; ++p) {
+            moment1[p] = ADAM_BETA1 * moment1[p] + (1.0 - ADAM_BETA1) * gradient[p];
+            moment2[p] = ADAM_BETA2 * moment2[p] + (1.0 - ADAM_BETA2) * gradient[p] * gradient[p];
+            double m = moment1[p] / (1.0 - pow(ADAM_BETA1, step)), v = moment2[p] / (1.0 - pow(ADAM_BETA2, step));
+            params[p] -= rate * m / (sqrt(v) + ADAM_EPSILON);
+        }
+        if (step % REPORT_INTERVAL == 0 || step == iterations) printf("Step %5d: loss %.6f\n", step, loss);
+    }
+    loss = run_pass(workers, num_workers, JOB_LOSS, NULL);
+    printf("Final loss %.6f\n", loss);
+
+    job = JOB_EXIT;
+    pthread_barrier_wait(&job_start);
+    for (int i = 0; i < num_workers; ++i) pthread_join(workers[i].thread, NULL);
+    free(workers);
+
+    if (!write_header(output_path, dataset_path, loss)) return 1;
+    printf("Wrote %s\n", output_path);
+    return 0;
+}